@@ -0,0 +1,111 @@
+#include "dep_graph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+// Writes a synthetic local database of BENCH_PACKAGES packages with
+// BENCH_DEPENDS dependencies each to a temporary directory and times
+// dep_graph_build on it: reading every desc, the provides index, forward
+// and reverse edges, and conflicts. The files are in the page cache, as
+// they are for the GUI after the first start.
+
+#define BENCH_PACKAGES 2500
+#define BENCH_DEPENDS 10
+#define BENCH_VIRTUALS 200
+#define BENCH_RUNS 20
+
+static void write_desc(const char *local_dir, int i, GRand *rand, GPtrArray *entries) {
+    char *entry = g_strdup_printf("pkg%d-1.%d-1", i, i);
+    char *dir = g_build_filename(local_dir, entry, NULL);
+    g_mkdir(dir, 0755);
+
+    GString *desc = g_string_new(NULL);
+    g_string_append_printf(desc, "%%NAME%%\npkg%d\n\n%%VERSION%%\n1.%d-1\n\n%%DESC%%\nSynthetic package\n\n", i, i);
+
+    // Two dependencies in ten go through a virtual name
+    g_string_append(desc, "%DEPENDS%\n");
+    for (int k = 0; k < BENCH_DEPENDS; k++) {
+        if (k >= BENCH_DEPENDS - 2) {
+            g_string_append_printf(desc, "virt%d\n", g_rand_int_range(rand, 0, BENCH_VIRTUALS));
+        } else {
+            g_string_append_printf(desc, "pkg%d>=1.0\n", g_rand_int_range(rand, 0, BENCH_PACKAGES));
+        }
+    }
+
+    // Every virtual name has a few providers; some packages conflict with one
+    g_string_append_printf(desc, "\n%%PROVIDES%%\nvirt%d=1.0\n", i % BENCH_VIRTUALS);
+    if (i % 10 == 0) {
+        g_string_append_printf(desc, "\n%%CONFLICTS%%\nvirt%d\n", g_rand_int_range(rand, 0, BENCH_VIRTUALS));
+    }
+
+    char *path = g_build_filename(dir, "desc", NULL);
+    if (!g_file_set_contents(path, desc->str, desc->len, NULL)) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        exit(1);
+    }
+
+    g_ptr_array_add(entries, dir);
+    g_free(path);
+    g_string_free(desc, TRUE);
+    g_free(entry);
+}
+
+static void remove_database(const char *root, const char *local_dir, GPtrArray *entries) {
+    for (guint i = 0; i < entries->len; i++) {
+        char *path = g_build_filename(entries->pdata[i], "desc", NULL);
+        g_unlink(path);
+        g_rmdir(entries->pdata[i]);
+        g_free(path);
+    }
+    g_rmdir(local_dir);
+    g_rmdir(root);
+}
+
+static int compare_times(const void *a, const void *b) {
+    gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    char *root = g_dir_make_tmp("bench_dep_graph-XXXXXX", NULL);
+    if (!root) {
+        fprintf(stderr, "Cannot create a temporary directory\n");
+        return 1;
+    }
+    char *local_dir = g_build_filename(root, "local", NULL);
+    g_mkdir(local_dir, 0755);
+
+    GRand *rand = g_rand_new_with_seed(1);
+    GPtrArray *entries = g_ptr_array_new_with_free_func(g_free);
+    for (int i = 0; i < BENCH_PACKAGES; i++) write_desc(local_dir, i, rand, entries);
+    g_rand_free(rand);
+
+    gint64 times[BENCH_RUNS];
+    int nodes = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        gint64 start = g_get_monotonic_time();
+        DepGraph *graph = dep_graph_build(local_dir);
+        times[run] = g_get_monotonic_time() - start;
+
+        if (!graph) {
+            fprintf(stderr, "dep_graph_build failed\n");
+            remove_database(root, local_dir, entries);
+            return 1;
+        }
+        nodes = dep_graph_node_count(graph);
+        dep_graph_unref(graph);
+    }
+    qsort(times, BENCH_RUNS, sizeof(gint64), compare_times);
+
+    printf("%d packages, %d dependencies each, %d nodes\n", BENCH_PACKAGES, BENCH_DEPENDS, nodes);
+    printf("dep_graph_build over %d runs: min %.1f ms, median %.1f ms\n",
+           BENCH_RUNS, times[0] / 1000.0, times[BENCH_RUNS / 2] / 1000.0);
+
+    remove_database(root, local_dir, entries);
+    g_ptr_array_free(entries, TRUE);
+    g_free(local_dir);
+    g_free(root);
+    return 0;
+}
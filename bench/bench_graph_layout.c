@@ -0,0 +1,91 @@
+#include "ui/graph_layout.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Times graph_layout_new, which the dependency viewer runs on a worker
+// thread, on a synthetic tree of BENCH_NODES nodes in five breadth-first
+// layers with BENCH_DEPENDS dependencies each, about 5000 edges. The tree
+// has no graph behind it, so no node is flagged missing or conflicting.
+
+#define BENCH_NODES 1000
+#define BENCH_DEPENDS 5
+#define BENCH_RUNS 20
+
+// Nodes per layer; the root is alone in layer 0
+static const int layer_sizes[] = { 1, 10, 90, 300, 599 };
+
+static DependencyTree* synthetic_tree(char **names, GRand *rand) {
+    DependencyTree *tree = malloc(sizeof(DependencyTree));
+    tree->count = BENCH_NODES;
+    tree->capacity = BENCH_NODES;
+    tree->nodes = calloc(BENCH_NODES, sizeof(DependencyNode));
+    tree->graph = NULL;
+
+    // End of each layer, so dependencies can be drawn from the next one back
+    int layer_end[G_N_ELEMENTS(layer_sizes)];
+    int end = 0;
+    for (guint layer = 0; layer < G_N_ELEMENTS(layer_sizes); layer++) {
+        end += layer_sizes[layer];
+        layer_end[layer] = end;
+    }
+
+    int i = 0;
+    for (guint layer = 0; layer < G_N_ELEMENTS(layer_sizes); layer++) {
+        int reachable = layer_end[MIN(layer + 1, G_N_ELEMENTS(layer_sizes) - 1)];
+        for (; i < layer_end[layer]; i++) {
+            DependencyNode *node = &tree->nodes[i];
+            node->name = names[i];
+            node->depth = layer;
+
+            DependencyList *depends = malloc(sizeof(DependencyList));
+            depends->dependencies = malloc(sizeof(char*) * BENCH_DEPENDS);
+            depends->count = 0;
+            depends->graph = NULL;
+            for (int k = 0; k < BENCH_DEPENDS; k++) {
+                int target = g_rand_int_range(rand, 0, reachable);
+                if (target != i) depends->dependencies[depends->count++] = names[target];
+            }
+            node->depends = depends;
+        }
+    }
+    return tree;
+}
+
+static int compare_times(const void *a, const void *b) {
+    gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    // Names are borrowed by the tree, as they are from a dependency graph
+    char *names[BENCH_NODES];
+    for (int i = 0; i < BENCH_NODES; i++) names[i] = g_strdup_printf("package-%04d", i);
+
+    // The viewer's metrics
+    GraphLayoutMetrics metrics = { 120.0, 30.0, 180.0, 50.0, 50.0 };
+    GRand *rand = g_rand_new_with_seed(1);
+    gint64 times[BENCH_RUNS];
+    int edges = 0, crossings = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        g_rand_set_seed(rand, 1);
+        DependencyTree *tree = synthetic_tree(names, rand);
+
+        gint64 start = g_get_monotonic_time();
+        GraphLayout *layout = graph_layout_new(tree, &metrics);
+        times[run] = g_get_monotonic_time() - start;
+
+        edges = layout->n_edges;
+        crossings = layout->crossings;
+        graph_layout_free(layout);
+    }
+    qsort(times, BENCH_RUNS, sizeof(gint64), compare_times);
+
+    printf("%d nodes, %d edges, %d crossings left\n", BENCH_NODES, edges, crossings);
+    printf("graph_layout_new over %d runs: min %.1f ms, median %.1f ms\n",
+           BENCH_RUNS, times[0] / 1000.0, times[BENCH_RUNS / 2] / 1000.0);
+
+    g_rand_free(rand);
+    for (int i = 0; i < BENCH_NODES; i++) g_free(names[i]);
+    return 0;
+}
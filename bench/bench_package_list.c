@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+#include "pacman_wrapper.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Builds a package list of BENCH_PACKAGES synthetic `pacman -Ss` entries
+// twice, each in a child process of its own: through package_list_append
+// and the list's arena, and with one strdup per field as package lists
+// were filled before the arena. Prints the allocator calls each made and
+// the child's peak RSS, next to that of a child that builds nothing.
+
+#define BENCH_PACKAGES 50000
+
+static const char *repositories[] = { "core", "extra", "multilib" };
+
+// Counted while a path runs. glibc's own entry points stay reachable under
+// their __libc_ names, so these forward to them.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gboolean counting = FALSE;
+static unsigned long allocations = 0;
+
+void *malloc(size_t size) {
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (counting) allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (counting) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+// Fields of entry i; about one in eight packages shares a stock description
+static void entry_fields(int i, char *name, char *version, char *description, gsize size) {
+    snprintf(name, size, "package-%05d", i);
+    snprintf(version, size, "%d.%d.%d-%d", i % 7, i % 13, i % 29, 1 + i % 3);
+    if (i % 8 == 0) {
+        snprintf(description, size, "Library for %s", repositories[i % 3]);
+    } else {
+        snprintf(description, size, "Synthetic package number %d used to measure package list memory", i);
+    }
+}
+
+static void fill_arena(void) {
+    PackageList *list = package_list_new(64);
+    char name[128], version[128], description[128];
+
+    for (int i = 0; i < BENCH_PACKAGES; i++) {
+        entry_fields(i, name, version, description, sizeof(name));
+        Package *pkg = package_list_append(list);
+        pkg->repository = arena_intern(list->arena, repositories[i % 3]);
+        pkg->name = arena_strdup(list->arena, name);
+        pkg->version = arena_strdup(list->arena, version);
+        pkg->description = arena_strdup(list->arena, description);
+    }
+
+    package_list_free(list);
+}
+
+static void fill_strdup(void) {
+    int capacity = 64;
+    int count = 0;
+    Package *packages = malloc(sizeof(Package) * capacity);
+    char name[128], version[128], description[128];
+
+    for (int i = 0; i < BENCH_PACKAGES; i++) {
+        entry_fields(i, name, version, description, sizeof(name));
+        if (count == capacity) {
+            capacity *= 2;
+            packages = realloc(packages, sizeof(Package) * capacity);
+        }
+
+        Package *pkg = &packages[count++];
+        memset(pkg, 0, sizeof(Package));
+        pkg->repository = strdup(repositories[i % 3]);
+        pkg->name = strdup(name);
+        pkg->version = strdup(version);
+        pkg->description = strdup(description);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(packages[i].repository);
+        free(packages[i].name);
+        free(packages[i].version);
+        free(packages[i].description);
+    }
+    free(packages);
+}
+
+// Peak RSS of a child that builds nothing, to subtract from the others
+static void fill_nothing(void) {
+}
+
+static void run(const char *label, void (*fill)(void)) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        counting = TRUE;
+        gint64 start = g_get_monotonic_time();
+        fill();
+        gint64 elapsed = g_get_monotonic_time() - start;
+        counting = FALSE;
+
+        printf("%-8s %10lu allocations %8.1f ms", label, allocations, elapsed / 1000.0);
+        fflush(stdout);
+        _exit(0);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: benchmark child failed\n", label);
+        exit(1);
+    }
+    printf(" %8ld KiB peak RSS\n", usage.ru_maxrss);
+}
+
+int main(void) {
+    printf("%d packages\n", BENCH_PACKAGES);
+    run("baseline", fill_nothing);
+    run("arena", fill_arena);
+    run("strdup", fill_strdup);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Large enough that a full sync database needs only a few hundred blocks
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 8
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    gsize used;
+    gsize size;
+    char data[];
+} ArenaBlock;
+
+struct Arena {
+    ArenaBlock *blocks;     // Current block first
+    GHashTable *interned;   // Created on first arena_intern
+};
+
+static ArenaBlock* block_new(gsize size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    block->next = NULL;
+    block->used = 0;
+    block->size = size;
+    return block;
+}
+
+Arena* arena_new(void) {
+    Arena *arena = malloc(sizeof(Arena));
+    arena->blocks = NULL;
+    arena->interned = NULL;
+    return arena;
+}
+
+void arena_free(Arena *arena) {
+    if (!arena) return;
+
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    if (arena->interned) g_hash_table_destroy(arena->interned);
+    free(arena);
+}
+
+gpointer arena_alloc(Arena *arena, gsize size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(gsize)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        // Oversized requests get a dedicated block behind the current one,
+        // so the free space left in it is not wasted
+        if (size > ARENA_BLOCK_SIZE / 4 && block) {
+            ArenaBlock *large = block_new(size);
+            large->used = size;
+            large->next = block->next;
+            block->next = large;
+            return large->data;
+        }
+
+        block = block_new(MAX(size, ARENA_BLOCK_SIZE));
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    gpointer result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+char* arena_strndup(Arena *arena, const char *str, gsize length) {
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char* arena_strdup(Arena *arena, const char *str) {
+    if (!str) return NULL;
+    return arena_strndup(arena, str, strlen(str));
+}
+
+char* arena_intern(Arena *arena, const char *str) {
+    if (!str) return NULL;
+
+    if (!arena->interned) {
+        arena->interned = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    char *copy = g_hash_table_lookup(arena->interned, str);
+    if (!copy) {
+        copy = arena_strdup(arena, str);
+        g_hash_table_insert(arena->interned, copy, copy);
+    }
+    return copy;
+}
+
+void arena_adopt(Arena *dst, Arena *src) {
+    if (!src) return;
+
+    // Append behind dst's current block so dst keeps filling it
+    ArenaBlock *tail = src->blocks;
+    while (tail && tail->next) tail = tail->next;
+
+    if (tail) {
+        if (dst->blocks) {
+            tail->next = dst->blocks->next;
+            dst->blocks->next = src->blocks;
+        } else {
+            dst->blocks = src->blocks;
+        }
+    }
+
+    src->blocks = NULL;
+    arena_free(src);
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <glib.h>
+
+// Bump allocator for data that lives and dies together, such as the strings
+// of one PackageList. Allocations are never freed individually; arena_free
+// releases everything at once. An arena is not thread-safe; parallel
+// producers fill their own arenas and hand them over with arena_adopt.
+typedef struct Arena Arena;
+
+Arena* arena_new(void);
+void arena_free(Arena *arena);
+
+gpointer arena_alloc(Arena *arena, gsize size);
+char* arena_strdup(Arena *arena, const char *str);
+char* arena_strndup(Arena *arena, const char *str, gsize length);
+
+// Returns the arena's single copy of str, storing it on first use. Meant for
+// values that repeat across many packages (repository names, stock
+// descriptions); interned strings must not be modified.
+char* arena_intern(Arena *arena, const char *str);
+
+// Moves every block of src into dst and frees src. Strings previously
+// returned by src stay valid and are now released with dst.
+void arena_adopt(Arena *dst, Arena *src);
+
+#endif
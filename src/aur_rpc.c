@@ -0,0 +1,371 @@
+#define _GNU_SOURCE
+#include "aur_rpc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+#include <json-glib/json-glib.h>
+
+#define AUR_RPC_DEFAULT_URL "https://aur.archlinux.org/rpc/v5"
+
+// How long a cached response is used without asking the server at all
+#define AUR_SEARCH_TTL_SECONDS (5 * 60)
+#define AUR_INFO_TTL_SECONDS (10 * 60)
+
+// Names per info request. The AUR takes far more, but smaller batches keep
+// single responses (and cache entries) reasonably sized.
+#define AUR_INFO_BATCH_SIZE 250
+
+// Idle easy handles kept around; each holds its open connections, so a
+// reused handle skips the TCP and TLS handshakes
+#define AUR_HANDLE_POOL_SIZE 4
+
+static GMutex rpc_lock;
+static char *base_url = NULL;
+static GPtrArray *idle_handles = NULL;
+
+typedef struct {
+    gint64 fetched;         // Unix time of the last exchange with the server
+    char *etag;             // NULL if the server sent none
+    char *body;
+} CachedResponse;
+
+typedef struct {
+    GString *body;
+    char *etag;
+} RpcResponse;
+
+void aur_rpc_set_base_url(const char *url) {
+    g_mutex_lock(&rpc_lock);
+    g_free(base_url);
+    base_url = g_strdup(url);
+    g_mutex_unlock(&rpc_lock);
+}
+
+static char* get_base_url(void) {
+    g_mutex_lock(&rpc_lock);
+    if (!base_url) {
+        const char *env_url = g_getenv("PACMAN_GUI_AUR_URL");
+        base_url = g_strdup(env_url && *env_url ? env_url : AUR_RPC_DEFAULT_URL);
+    }
+    char *url = g_strdup(base_url);
+    g_mutex_unlock(&rpc_lock);
+    return url;
+}
+
+static CURL* take_handle(void) {
+    static gsize curl_initialized = 0;
+    if (g_once_init_enter(&curl_initialized)) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        g_once_init_leave(&curl_initialized, 1);
+    }
+
+    CURL *handle = NULL;
+    g_mutex_lock(&rpc_lock);
+    if (idle_handles && idle_handles->len > 0) {
+        handle = g_ptr_array_remove_index(idle_handles, idle_handles->len - 1);
+    }
+    g_mutex_unlock(&rpc_lock);
+
+    if (!handle) return curl_easy_init();
+
+    // Clears the options but keeps the connection cache
+    curl_easy_reset(handle);
+    return handle;
+}
+
+static void release_handle(CURL *handle) {
+    g_mutex_lock(&rpc_lock);
+    if (!idle_handles) idle_handles = g_ptr_array_new();
+    if (idle_handles->len < AUR_HANDLE_POOL_SIZE) {
+        g_ptr_array_add(idle_handles, handle);
+        handle = NULL;
+    }
+    g_mutex_unlock(&rpc_lock);
+
+    if (handle) curl_easy_cleanup(handle);
+}
+
+static char* cache_path(const char *url, const char *post_body) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, (const guchar*)url, -1);
+    if (post_body) {
+        g_checksum_update(checksum, (const guchar*)"\n", 1);
+        g_checksum_update(checksum, (const guchar*)post_body, -1);
+    }
+
+    char *path = g_build_filename(g_get_user_cache_dir(), "pacman-gui", "aur",
+                                  g_checksum_get_string(checksum), NULL);
+    g_checksum_free(checksum);
+    return path;
+}
+
+// Entries are "<fetched>\n<etag>\n<body>"
+static gboolean cache_read(const char *path, CachedResponse *entry) {
+    char *contents;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) return FALSE;
+
+    char *etag = strchr(contents, '\n');
+    char *body = etag ? strchr(etag + 1, '\n') : NULL;
+    if (!body) {
+        g_free(contents);
+        return FALSE;
+    }
+    *etag++ = '\0';
+    *body++ = '\0';
+
+    entry->fetched = g_ascii_strtoll(contents, NULL, 10);
+    entry->etag = *etag ? g_strdup(etag) : NULL;
+    entry->body = g_strdup(body);
+
+    g_free(contents);
+    return TRUE;
+}
+
+static void cache_write(const char *path, gint64 fetched, const char *etag, const char *body) {
+    char *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    // Replaced atomically, so a concurrent reader never sees half an entry
+    char *contents = g_strdup_printf("%" G_GINT64_FORMAT "\n%s\n%s", fetched, etag ? etag : "", body);
+    g_file_set_contents(path, contents, -1, NULL);
+    g_free(contents);
+}
+
+static size_t on_body_data(char *data, size_t size, size_t nmemb, void *user_data) {
+    RpcResponse *response = (RpcResponse*)user_data;
+    g_string_append_len(response->body, data, size * nmemb);
+    return size * nmemb;
+}
+
+static size_t on_header_line(char *data, size_t size, size_t nmemb, void *user_data) {
+    RpcResponse *response = (RpcResponse*)user_data;
+    size_t length = size * nmemb;
+
+    if (length >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        // Status line of a new response, e.g. after a redirect
+        g_clear_pointer(&response->etag, g_free);
+    } else if (length > 5 && g_ascii_strncasecmp(data, "ETag:", 5) == 0) {
+        g_free(response->etag);
+        response->etag = g_strstrip(g_strndup(data + 5, length - 5));
+    }
+    return length;
+}
+
+static int on_transfer_progress(void *user_data, curl_off_t dltotal, curl_off_t dlnow,
+                                curl_off_t ultotal, curl_off_t ulnow) {
+    // Non-zero aborts the transfer
+    return g_cancellable_is_cancelled((GCancellable*)user_data) ? 1 : 0;
+}
+
+// Returns the response body, from the cache while it is fresh or when the
+// server confirms it unchanged. A stale entry also stands in when the
+// server cannot be reached. NULL on failure or cancellation.
+static char* rpc_fetch(const char *url, const char *post_body, gint64 ttl, GCancellable *cancellable) {
+    char *path = cache_path(url, post_body);
+    CachedResponse cached = {0};
+    gboolean have_cached = cache_read(path, &cached);
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    if (have_cached && now >= cached.fetched && now - cached.fetched < ttl) {
+        g_free(cached.etag);
+        g_free(path);
+        return cached.body;
+    }
+
+    CURL *handle = take_handle();
+    RpcResponse response = { g_string_new(NULL), NULL };
+    struct curl_slist *headers = NULL;
+    CURLcode code = CURLE_FAILED_INIT;
+    long status = 0;
+
+    if (handle) {
+        if (cached.etag) {
+            char *header = g_strdup_printf("If-None-Match: %s", cached.etag);
+            headers = curl_slist_append(headers, header);
+            g_free(header);
+        }
+
+        curl_easy_setopt(handle, CURLOPT_URL, url);
+        curl_easy_setopt(handle, CURLOPT_USERAGENT, "pacman-gui");
+        curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT, 30L);
+        // Called from worker threads, where timeouts must not use signals
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, on_body_data);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, on_header_line);
+        curl_easy_setopt(handle, CURLOPT_HEADERDATA, &response);
+        if (post_body) curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_body);
+        if (cancellable) {
+            curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, on_transfer_progress);
+            curl_easy_setopt(handle, CURLOPT_XFERINFODATA, cancellable);
+        }
+
+        code = curl_easy_perform(handle);
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+        release_handle(handle);
+        curl_slist_free_all(headers);
+    }
+
+    char *body = NULL;
+    if (g_cancellable_is_cancelled(cancellable)) {
+        // Dropped, even if the transfer happened to complete
+    } else if (code == CURLE_OK && status == 200) {
+        body = g_string_free(response.body, FALSE);
+        response.body = NULL;
+        cache_write(path, now, response.etag, body);
+    } else if (code == CURLE_OK && status == 304 && have_cached) {
+        cache_write(path, now, response.etag ? response.etag : cached.etag, cached.body);
+        body = g_steal_pointer(&cached.body);
+    } else if (have_cached) {
+        // Offline or server trouble: stale results beat none
+        body = g_steal_pointer(&cached.body);
+    }
+
+    if (response.body) g_string_free(response.body, TRUE);
+    g_free(response.etag);
+    g_free(cached.etag);
+    g_free(cached.body);
+    g_free(path);
+    return body;
+}
+
+// NULL unless the member exists and holds a string
+static const char* member_string(JsonObject *object, const char *name) {
+    JsonNode *node = json_object_get_member(object, name);
+    if (!node || !JSON_NODE_HOLDS_VALUE(node)) return NULL;
+    return json_node_get_string(node);
+}
+
+// Appends the packages of an RPC response to list; FALSE if the response is
+// malformed or reports an error
+static gboolean parse_results(const char *body, PackageList *list) {
+    JsonParser *parser = json_parser_new();
+    gboolean ok = FALSE;
+
+    if (json_parser_load_from_data(parser, body, -1, NULL)) {
+        JsonNode *root = json_parser_get_root(parser);
+        JsonObject *object = root && JSON_NODE_HOLDS_OBJECT(root) ? json_node_get_object(root) : NULL;
+        const char *type = object ? member_string(object, "type") : NULL;
+        JsonNode *results = object ? json_object_get_member(object, "results") : NULL;
+
+        if (type && strcmp(type, "error") != 0 && results && JSON_NODE_HOLDS_ARRAY(results)) {
+            JsonArray *array = json_node_get_array(results);
+            guint length = json_array_get_length(array);
+
+            for (guint i = 0; i < length; i++) {
+                JsonNode *element = json_array_get_element(array, i);
+                if (!JSON_NODE_HOLDS_OBJECT(element)) continue;
+
+                JsonObject *result = json_node_get_object(element);
+                const char *name = member_string(result, "Name");
+                const char *version = member_string(result, "Version");
+                const char *description = member_string(result, "Description");
+                if (!name || !version) continue;
+
+                Package *pkg = package_list_append(list);
+                pkg->name = arena_strdup(list->arena, name);
+                pkg->version = arena_strdup(list->arena, version);
+                pkg->description = description ? arena_strdup(list->arena, description)
+                                               : arena_intern(list->arena, "");
+                pkg->repository = arena_intern(list->arena, "aur");
+            }
+            ok = TRUE;
+        }
+    }
+
+    g_object_unref(parser);
+    return ok;
+}
+
+// The RPC matches a single term; keep only packages that also contain every
+// other term, like `yay -Ss a b` does
+static void filter_other_terms(PackageList *list, char **terms, const char *searched) {
+    int kept = 0;
+    for (int i = 0; i < list->count; i++) {
+        Package *pkg = &list->packages[i];
+        gboolean matches = TRUE;
+
+        for (int t = 0; terms[t] && matches; t++) {
+            if (!*terms[t] || terms[t] == searched) continue;
+            matches = strcasestr(pkg->name, terms[t]) || strcasestr(pkg->description, terms[t]);
+        }
+
+        if (matches) list->packages[kept++] = *pkg;
+    }
+    list->count = kept;
+}
+
+PackageList* aur_rpc_search(const char *query, GCancellable *cancellable) {
+    char **terms = g_strsplit_set(query, " \t", -1);
+
+    // The most selective term keeps the response small
+    const char *longest = "";
+    for (int i = 0; terms[i]; i++) {
+        if (strlen(terms[i]) > strlen(longest)) longest = terms[i];
+    }
+
+    // The AUR rejects terms shorter than two characters
+    if (strlen(longest) < 2) {
+        g_strfreev(terms);
+        return package_list_new(0);
+    }
+
+    char *base = get_base_url();
+    char *escaped = g_uri_escape_string(longest, NULL, FALSE);
+    char *url = g_strdup_printf("%s/search/%s?by=name-desc", base, escaped);
+    char *body = rpc_fetch(url, NULL, AUR_SEARCH_TTL_SECONDS, cancellable);
+
+    PackageList *list = NULL;
+    if (body) {
+        list = package_list_new(64);
+        if (parse_results(body, list)) {
+            filter_other_terms(list, terms, longest);
+        } else {
+            package_list_free(list);
+            list = NULL;
+        }
+    }
+
+    g_free(body);
+    g_free(url);
+    g_free(escaped);
+    g_free(base);
+    g_strfreev(terms);
+    return list;
+}
+
+PackageList* aur_rpc_info(const char *const *names, int count, GCancellable *cancellable) {
+    char *base = get_base_url();
+    char *url = g_strdup_printf("%s/info", base);
+    PackageList *list = package_list_new(count);
+
+    for (int start = 0; start < count && list; start += AUR_INFO_BATCH_SIZE) {
+        int end = MIN(count, start + AUR_INFO_BATCH_SIZE);
+
+        GString *form = g_string_new(NULL);
+        for (int i = start; i < end; i++) {
+            char *escaped = g_uri_escape_string(names[i], NULL, FALSE);
+            g_string_append_printf(form, "%sarg[]=%s", i > start ? "&" : "", escaped);
+            g_free(escaped);
+        }
+
+        char *body = rpc_fetch(url, form->str, AUR_INFO_TTL_SECONDS, cancellable);
+        if (!body || !parse_results(body, list)) {
+            package_list_free(list);
+            list = NULL;
+        }
+
+        g_free(body);
+        g_string_free(form, TRUE);
+    }
+
+    g_free(url);
+    g_free(base);
+    return list;
+}
@@ -0,0 +1,22 @@
+#ifndef AUR_RPC_H
+#define AUR_RPC_H
+
+#include "pacman_wrapper.h"
+
+// In-process client for the AUR RPC interface (v5). Requests reuse pooled
+// connections and responses are cached under $XDG_CACHE_HOME/pacman-gui/aur;
+// a fresh entry is served without a request, a stale one is revalidated
+// with its ETag. Safe to call from worker threads.
+
+// Endpoint root, e.g. "http://127.0.0.1:8080/rpc/v5" for a local stand-in.
+// Defaults to $PACMAN_GUI_AUR_URL, then the official AUR. NULL restores it.
+void aur_rpc_set_base_url(const char *url);
+
+// Both return NULL on failure or once cancellable (may be NULL) is
+// cancelled. Packages get repository "aur".
+PackageList* aur_rpc_search(const char *query, GCancellable *cancellable);
+// Looks up any number of packages by name, batching them into as few
+// requests as the AUR accepts. Names the AUR does not know are left out.
+PackageList* aur_rpc_info(const char *const *names, int count, GCancellable *cancellable);
+
+#endif
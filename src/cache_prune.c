@@ -0,0 +1,117 @@
+#include "cache_prune.h"
+#include "vercmp.h"
+#include <string.h>
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+GHashTable* cache_prune_installed_versions(const char *local_dir) {
+    GDir *dir = g_dir_open(local_dir, 0, NULL);
+    if (!dir) return NULL;
+
+    GHashTable *installed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    const char *entry;
+    while ((entry = g_dir_read_name(dir)) != NULL) {
+        // "<name>-<pkgver>-<pkgrel>"; names may contain dashes, versions cannot
+        const char *release = strrchr(entry, '-');
+        if (!release || release == entry) continue;
+        const char *version = release - 1;
+        while (version > entry && *version != '-') version--;
+        if (version == entry) continue;
+
+        g_hash_table_insert(installed, g_strndup(entry, version - entry), g_strdup(version + 1));
+    }
+    g_dir_close(dir);
+    return installed;
+}
+
+// By name and arch, then newest version first, so each package's versions
+// are ranked in one walk
+static gint compare_newest_first(gconstpointer a, gconstpointer b) {
+    const CachePackage *pa = *(const CachePackage *const *)a;
+    const CachePackage *pb = *(const CachePackage *const *)b;
+
+    int result = strcmp(pa->name, pb->name);
+    if (result == 0) result = strcmp(pa->arch, pb->arch);
+    if (result == 0) result = vercmp(pb->version, pa->version);
+    return result;
+}
+
+static gint64 newest_mtime(const CachePackage *package) {
+    gint64 mtime = 0;
+    for (guint i = 0; i < package->files->len; i++) {
+        const CacheFile *file = g_ptr_array_index(package->files, i);
+        mtime = MAX(mtime, file->mtime);
+    }
+    return mtime;
+}
+
+static gint compare_entries(gconstpointer a, gconstpointer b) {
+    const CachePruneEntry *ea = (const CachePruneEntry*)a;
+    const CachePruneEntry *eb = (const CachePruneEntry*)b;
+
+    int result = strcmp(ea->name, eb->name);
+    if (result == 0) result = vercmp(ea->version, eb->version);
+    if (result == 0) result = strcmp(ea->arch, eb->arch);
+    return result;
+}
+
+CachePrunePlan* cache_prune_plan(CacheScanner *scanner, const CachePrunePolicy *policy,
+                                 GHashTable *installed, gint64 now) {
+    CachePrunePlan *plan = g_malloc0(sizeof(CachePrunePlan));
+    plan->entries = g_array_new(FALSE, FALSE, sizeof(CachePruneEntry));
+    plan->files = g_ptr_array_new_with_free_func(g_free);
+
+    GPtrArray *packages = cache_scanner_list_packages(scanner);
+    g_ptr_array_sort(packages, compare_newest_first);
+
+    gint64 cutoff = now - (gint64)policy->older_than_days * SECONDS_PER_DAY;
+    const CachePackage *previous = NULL;
+    int rank = 0;
+
+    for (guint i = 0; i < packages->len; i++) {
+        const CachePackage *package = g_ptr_array_index(packages, i);
+
+        if (previous && strcmp(previous->name, package->name) == 0 && strcmp(previous->arch, package->arch) == 0) {
+            rank++;
+        } else {
+            rank = 0;
+        }
+        previous = package;
+
+        if (rank < policy->keep_versions) continue;
+        // Without the installed versions nothing can safely go
+        if (policy->keep_installed && (!installed ||
+            g_strcmp0(g_hash_table_lookup(installed, package->name), package->version) == 0)) {
+            continue;
+        }
+        if (policy->older_than_days > 0 && newest_mtime(package) > cutoff) continue;
+
+        CachePruneEntry entry = {
+            g_strdup(package->name), g_strdup(package->version), g_strdup(package->arch), package->bytes
+        };
+        g_array_append_val(plan->entries, entry);
+        for (guint j = 0; j < package->files->len; j++) {
+            const CacheFile *file = g_ptr_array_index(package->files, j);
+            g_ptr_array_add(plan->files, g_strdup(file->name));
+        }
+        plan->bytes += package->bytes;
+    }
+
+    g_ptr_array_unref(packages);
+    g_array_sort(plan->entries, compare_entries);
+    return plan;
+}
+
+void cache_prune_plan_free(CachePrunePlan *plan) {
+    if (!plan) return;
+
+    for (guint i = 0; i < plan->entries->len; i++) {
+        CachePruneEntry *entry = &g_array_index(plan->entries, CachePruneEntry, i);
+        g_free(entry->name);
+        g_free(entry->version);
+        g_free(entry->arch);
+    }
+    g_array_free(plan->entries, TRUE);
+    g_ptr_array_free(plan->files, TRUE);
+    g_free(plan);
+}
@@ -0,0 +1,40 @@
+#ifndef CACHE_PRUNE_H
+#define CACHE_PRUNE_H
+
+#include "cache_scan.h"
+
+// paccache-style pruning, planned in one pass over a CacheScanner's index.
+// Every policy field protects files; a package version is removed only if
+// none of them keeps it.
+typedef struct {
+    int keep_versions;          // Newest versions of each package and arch to keep; 0 keeps none
+    gboolean keep_installed;    // Keep the version that is installed
+    int older_than_days;        // Keep versions newer than this many days; 0 keeps none
+} CachePrunePolicy;
+
+// One package version the plan removes
+typedef struct {
+    char *name;
+    char *version;
+    char *arch;
+    guint64 bytes;
+} CachePruneEntry;
+
+typedef struct {
+    GArray *entries;            // CachePruneEntry, by name then version
+    GPtrArray *files;           // char*, names inside the cache directory
+    guint64 bytes;              // Exact total of files
+} CachePrunePlan;
+
+// Installed package name -> version, read from the directory names of
+// pacman's local database. NULL if it cannot be read.
+GHashTable* cache_prune_installed_versions(const char *local_dir);
+
+// installed comes from cache_prune_installed_versions; if it is NULL,
+// keep_installed keeps everything. now is in seconds since the epoch. The
+// plan copies what it needs from the index.
+CachePrunePlan* cache_prune_plan(CacheScanner *scanner, const CachePrunePolicy *policy,
+                                 GHashTable *installed, gint64 now);
+void cache_prune_plan_free(CachePrunePlan *plan);
+
+#endif
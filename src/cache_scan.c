@@ -0,0 +1,393 @@
+#define _GNU_SOURCE
+#include "cache_scan.h"
+#include "vercmp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+
+// Entries handed to a stat worker at a time
+#define SCAN_CHUNK_SIZE 256
+// Stats are metadata I/O; more threads than this stop paying off
+#define SCAN_MAX_WORKERS 8
+// Monitor events are collected this long before the index is updated, so a
+// whole `pacman -Sc` becomes one update
+#define UPDATE_DELAY_MS 200
+
+typedef struct {
+    char *name;
+    gboolean found;             // A regular file when it was stat'ed
+    guint64 size;
+    gint64 mtime;
+} FileStat;
+
+typedef struct {
+    CacheScanner *scanner;      // NULL once the scanner has been freed
+    char *dir;
+    GArray *stats;              // FileStat, one per directory entry
+} ScanJob;
+
+typedef struct {
+    int dirfd;
+    FileStat *stats;
+    guint count;
+} ScanChunk;
+
+struct CacheScanner {
+    char *dir;
+    CacheScanCallback callback;
+    gpointer user_data;
+
+    ScanJob *job;               // Initial scan, while it runs
+    gboolean ready;
+
+    GHashTable *files;          // File name -> CacheFile*
+    GHashTable *packages;       // "<name>-<version>-<arch>" -> CachePackage*
+    guint64 total_bytes;
+
+    GFileMonitor *monitor;
+    GHashTable *pending;        // Names changed since the last update
+    guint update_source;
+};
+
+static void stat_file(int dirfd, FileStat *stat) {
+    struct statx info;
+    stat->found = statx(dirfd, stat->name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                        STATX_TYPE | STATX_SIZE | STATX_MTIME, &info) == 0 && S_ISREG(info.stx_mode);
+    stat->size = stat->found ? info.stx_size : 0;
+    stat->mtime = stat->found ? info.stx_mtime.tv_sec : 0;
+}
+
+static void stat_chunk(gpointer data, gpointer user_data) {
+    ScanChunk *chunk = (ScanChunk*)data;
+
+    for (guint i = 0; i < chunk->count; i++) {
+        stat_file(chunk->dirfd, &chunk->stats[i]);
+    }
+    g_free(chunk);
+}
+
+static void free_job(ScanJob *job) {
+    for (guint i = 0; i < job->stats->len; i++) {
+        g_free(g_array_index(job->stats, FileStat, i).name);
+    }
+    g_array_free(job->stats, TRUE);
+    g_free(job->dir);
+    g_free(job);
+}
+
+// "<name>-<pkgver>-<pkgrel>-<arch>.pkg.tar[.<ext>][.sig]". The stem is
+// everything before ".pkg.tar" and identifies the package.
+static gboolean split_package_file(const char *filename, char **stem, char **name, char **version,
+                                   char **arch, gboolean *signature) {
+    const char *suffix = strstr(filename, ".pkg.tar");
+    // Downloads in progress end in .part
+    if (!suffix || suffix == filename || g_str_has_suffix(filename, ".part")) return FALSE;
+
+    const char *dashes[3];
+    const char *p = suffix;
+    for (int i = 0; i < 3; i++) {
+        while (p > filename && *(p - 1) != '-') p--;
+        if (p == filename) return FALSE;
+        dashes[i] = --p;
+    }
+    // dashes[0] precedes arch, dashes[1] pkgrel, dashes[2] pkgver
+    if (dashes[2] == filename || dashes[0] + 1 == suffix || dashes[1] + 1 == dashes[0]
+            || dashes[2] + 1 == dashes[1]) {
+        return FALSE;
+    }
+
+    *stem = g_strndup(filename, suffix - filename);
+    *name = g_strndup(filename, dashes[2] - filename);
+    *version = g_strndup(dashes[2] + 1, dashes[0] - dashes[2] - 1);
+    *arch = g_strndup(dashes[0] + 1, suffix - dashes[0] - 1);
+    *signature = g_str_has_suffix(filename, ".sig");
+    return TRUE;
+}
+
+static void free_package(CachePackage *package) {
+    g_free(package->name);
+    g_free(package->version);
+    g_free(package->arch);
+    g_ptr_array_free(package->files, TRUE);
+    g_free(package);
+}
+
+static void free_file(CacheFile *file) {
+    g_free(file->name);
+    g_free(file);
+}
+
+static void remove_file(CacheScanner *scanner, const char *filename) {
+    CacheFile *file = g_hash_table_lookup(scanner->files, filename);
+    if (!file) return;
+
+    scanner->total_bytes -= file->size;
+    CachePackage *package = file->package;
+    if (package) {
+        package->bytes -= file->size;
+        g_ptr_array_remove_fast(package->files, file);
+        if (package->files->len == 0) {
+            char *stem = g_strdup_printf("%s-%s-%s", package->name, package->version, package->arch);
+            g_hash_table_remove(scanner->packages, stem);
+            g_free(stem);
+        }
+    }
+    g_hash_table_remove(scanner->files, filename);
+}
+
+static void add_file(CacheScanner *scanner, const FileStat *stat) {
+    remove_file(scanner, stat->name);
+
+    CacheFile *file = g_malloc0(sizeof(CacheFile));
+    file->name = g_strdup(stat->name);
+    file->size = stat->size;
+    file->mtime = stat->mtime;
+
+    char *stem, *name, *version, *arch;
+    if (split_package_file(stat->name, &stem, &name, &version, &arch, &file->signature)) {
+        CachePackage *package = g_hash_table_lookup(scanner->packages, stem);
+        if (package) {
+            g_free(stem);
+            g_free(name);
+            g_free(version);
+            g_free(arch);
+        } else {
+            package = g_malloc0(sizeof(CachePackage));
+            package->name = name;
+            package->version = version;
+            package->arch = arch;
+            package->files = g_ptr_array_new();
+            g_hash_table_insert(scanner->packages, stem, package);
+        }
+        package->bytes += file->size;
+        g_ptr_array_add(package->files, file);
+        file->package = package;
+    }
+
+    scanner->total_bytes += file->size;
+    g_hash_table_insert(scanner->files, file->name, file);
+}
+
+static void notify(CacheScanner *scanner) {
+    if (scanner->callback) scanner->callback(scanner, scanner->user_data);
+}
+
+static gboolean apply_pending(gpointer user_data) {
+    CacheScanner *scanner = (CacheScanner*)user_data;
+    scanner->update_source = 0;
+
+    int dirfd = open(scanner->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, scanner->pending);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        FileStat stat = { (char*)key, FALSE, 0, 0 };
+        if (dirfd >= 0) stat_file(dirfd, &stat);
+
+        if (stat.found) {
+            add_file(scanner, &stat);
+        } else {
+            remove_file(scanner, stat.name);
+        }
+    }
+    g_hash_table_remove_all(scanner->pending);
+
+    if (dirfd >= 0) close(dirfd);
+    notify(scanner);
+    return FALSE;
+}
+
+static void schedule_update(CacheScanner *scanner) {
+    // Changes seen during the initial scan are applied when it finishes
+    if (scanner->job || scanner->update_source) return;
+    scanner->update_source = g_timeout_add(UPDATE_DELAY_MS, apply_pending, scanner);
+}
+
+static void on_cache_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                 GFileMonitorEvent event, gpointer user_data) {
+    CacheScanner *scanner = (CacheScanner*)user_data;
+    GFile *targets[2] = { file, NULL };
+
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+        break;
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        // Downloads are renamed from .part into place
+        targets[1] = other_file;
+        break;
+    default:
+        return;
+    }
+
+    for (int i = 0; i < 2 && targets[i]; i++) {
+        char *basename = g_file_get_basename(targets[i]);
+        if (basename) g_hash_table_add(scanner->pending, basename);
+    }
+    schedule_update(scanner);
+}
+
+static gboolean finish_scan(gpointer data) {
+    ScanJob *job = (ScanJob*)data;
+    CacheScanner *scanner = job->scanner;
+
+    if (scanner) {
+        scanner->job = NULL;
+        scanner->ready = TRUE;
+        for (guint i = 0; i < job->stats->len; i++) {
+            FileStat *stat = &g_array_index(job->stats, FileStat, i);
+            if (stat->found) add_file(scanner, stat);
+        }
+
+        if (g_hash_table_size(scanner->pending) > 0) {
+            apply_pending(scanner);
+        } else {
+            notify(scanner);
+        }
+    }
+
+    free_job(job);
+    return FALSE;
+}
+
+static gpointer scan_thread(gpointer data) {
+    ScanJob *job = (ScanJob*)data;
+
+    int dirfd = open(job->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    // readdir gets its own descriptor; the workers stat relative to dirfd
+    int listfd = dirfd >= 0 ? fcntl(dirfd, F_DUPFD_CLOEXEC, 0) : -1;
+    DIR *dir = listfd >= 0 ? fdopendir(listfd) : NULL;
+
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            // Subdirectories hold downloads in progress
+            if (entry->d_type == DT_DIR || entry->d_type == DT_LNK) continue;
+            FileStat stat = { g_strdup(entry->d_name), FALSE, 0, 0 };
+            g_array_append_val(job->stats, stat);
+        }
+        closedir(dir);
+
+        guint chunks = (job->stats->len + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+        int workers = (int)MIN(MIN(g_get_num_processors(), SCAN_MAX_WORKERS), MAX(chunks, 1));
+        GThreadPool *pool = g_thread_pool_new(stat_chunk, NULL, workers, FALSE, NULL);
+        for (guint start = 0; start < job->stats->len; start += SCAN_CHUNK_SIZE) {
+            ScanChunk *chunk = g_malloc(sizeof(ScanChunk));
+            chunk->dirfd = dirfd;
+            chunk->stats = &g_array_index(job->stats, FileStat, start);
+            chunk->count = MIN(SCAN_CHUNK_SIZE, job->stats->len - start);
+            g_thread_pool_push(pool, chunk, NULL);
+        }
+        g_thread_pool_free(pool, FALSE, TRUE);
+    } else if (listfd >= 0) {
+        close(listfd);
+    }
+
+    if (dirfd >= 0) close(dirfd);
+    g_idle_add(finish_scan, job);
+    return NULL;
+}
+
+static void watch_cache_dir(CacheScanner *scanner) {
+    GFile *dir = g_file_new_for_path(scanner->dir);
+    scanner->monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    g_object_unref(dir);
+
+    if (scanner->monitor) {
+        g_signal_connect(scanner->monitor, "changed", G_CALLBACK(on_cache_dir_changed), scanner);
+    }
+}
+
+CacheScanner* cache_scanner_new(const char *dir, CacheScanCallback callback, gpointer user_data) {
+    CacheScanner *scanner = g_malloc0(sizeof(CacheScanner));
+    scanner->dir = g_strdup(dir);
+    scanner->callback = callback;
+    scanner->user_data = user_data;
+    scanner->files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)free_file);
+    scanner->packages = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)free_package);
+    scanner->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    // Watch first so nothing that changes during the scan is missed
+    watch_cache_dir(scanner);
+
+    ScanJob *job = g_malloc(sizeof(ScanJob));
+    job->scanner = scanner;
+    job->dir = g_strdup(dir);
+    job->stats = g_array_new(FALSE, FALSE, sizeof(FileStat));
+    scanner->job = job;
+
+    GThread *thread = g_thread_new("cache_scan", scan_thread, job);
+    g_thread_unref(thread);
+    return scanner;
+}
+
+void cache_scanner_free(CacheScanner *scanner) {
+    if (!scanner) return;
+
+    // The scan finishes on its own and then drops its results
+    if (scanner->job) scanner->job->scanner = NULL;
+    if (scanner->update_source) g_source_remove(scanner->update_source);
+    if (scanner->monitor) {
+        g_signal_handlers_disconnect_by_data(scanner->monitor, scanner);
+        g_file_monitor_cancel(scanner->monitor);
+        g_object_unref(scanner->monitor);
+    }
+
+    // Packages only reference their files
+    g_hash_table_destroy(scanner->packages);
+    g_hash_table_destroy(scanner->files);
+    g_hash_table_destroy(scanner->pending);
+    g_free(scanner->dir);
+    g_free(scanner);
+}
+
+const char* cache_scanner_get_dir(const CacheScanner *scanner) {
+    return scanner->dir;
+}
+
+gboolean cache_scanner_is_ready(const CacheScanner *scanner) {
+    return scanner->ready;
+}
+
+guint64 cache_scanner_get_total_bytes(const CacheScanner *scanner) {
+    return scanner->total_bytes;
+}
+
+guint cache_scanner_get_file_count(const CacheScanner *scanner) {
+    return g_hash_table_size(scanner->files);
+}
+
+guint cache_scanner_get_package_count(const CacheScanner *scanner) {
+    return g_hash_table_size(scanner->packages);
+}
+
+static gint compare_packages(gconstpointer a, gconstpointer b) {
+    const CachePackage *pa = *(const CachePackage *const *)a;
+    const CachePackage *pb = *(const CachePackage *const *)b;
+
+    int result = strcmp(pa->name, pb->name);
+    if (result == 0) result = vercmp(pa->version, pb->version);
+    if (result == 0) result = strcmp(pa->arch, pb->arch);
+    return result;
+}
+
+GPtrArray* cache_scanner_list_packages(CacheScanner *scanner) {
+    GPtrArray *packages = g_ptr_array_sized_new(g_hash_table_size(scanner->packages));
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, scanner->packages);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(packages, value);
+    }
+    g_ptr_array_sort(packages, compare_packages);
+    return packages;
+}
@@ -0,0 +1,52 @@
+#ifndef CACHE_SCAN_H
+#define CACHE_SCAN_H
+
+#include <glib.h>
+
+// In-memory index of pacman's package cache. The first scan lists the
+// directory once and stats its entries on a pool of worker threads; after
+// that a directory monitor keeps the index current by re-stating only the
+// files that changed. Everything below is used from the main loop.
+
+typedef struct CachePackage CachePackage;
+
+typedef struct {
+    char *name;                 // File name inside the cache directory
+    guint64 size;               // Exact size in bytes
+    gint64 mtime;               // Seconds since the epoch
+    gboolean signature;         // Detached .sig of a package archive
+    CachePackage *package;      // NULL for files that are not package archives
+} CacheFile;
+
+// One built package, "<name>-<version>-<arch>.pkg.tar.*", together with its
+// signature and any copies compressed differently
+struct CachePackage {
+    char *name;
+    char *version;              // [epoch:]pkgver-pkgrel
+    char *arch;
+    guint64 bytes;              // All of its files
+    GPtrArray *files;           // CacheFile*
+};
+
+typedef struct CacheScanner CacheScanner;
+
+// Runs after the initial scan and after every batch of changes
+typedef void (*CacheScanCallback)(CacheScanner *scanner, gpointer user_data);
+
+// Starts scanning dir right away
+CacheScanner* cache_scanner_new(const char *dir, CacheScanCallback callback, gpointer user_data);
+void cache_scanner_free(CacheScanner *scanner);
+
+const char* cache_scanner_get_dir(const CacheScanner *scanner);
+// FALSE until the initial scan has finished
+gboolean cache_scanner_is_ready(const CacheScanner *scanner);
+// Every regular file in the directory, packages or not
+guint64 cache_scanner_get_total_bytes(const CacheScanner *scanner);
+guint cache_scanner_get_file_count(const CacheScanner *scanner);
+guint cache_scanner_get_package_count(const CacheScanner *scanner);
+// Packages sorted by name, then version from oldest to newest. Free the
+// array with g_ptr_array_unref; its packages belong to the scanner and stay
+// valid until control returns to the main loop.
+GPtrArray* cache_scanner_list_packages(CacheScanner *scanner);
+
+#endif
@@ -0,0 +1,331 @@
+#include "catalog_cache.h"
+#include "sync_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CATALOG_CACHE_MAGIC "PGCATLG"
+#define CATALOG_CACHE_VERSION 1
+
+// On-disk layout: header, lists, records, string pool. Every section is
+// 8-byte aligned so the mapping can be read in place.
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 n_lists;
+    guint32 n_records;
+    guint32 reserved;
+    guint64 lists_offset;
+    guint64 records_offset;
+    guint64 strings_offset;
+    guint64 strings_size;
+} CatalogCacheHeader;
+
+// One per source database file; stamp is what staleness is checked against
+typedef struct {
+    guint32 name;
+    guint32 path;
+    guint32 first_record;
+    guint32 count;
+    gint64 stamp;
+} CatalogCacheList;
+
+typedef struct {
+    guint32 name;
+    guint32 version;
+    guint32 description;
+    guint32 repository;
+    guint64 installed_size;
+    gint64 install_date;
+    guint32 reason;
+    guint32 installed;
+} CatalogCacheRecord;
+
+typedef struct {
+    GByteArray *strings;
+    GHashTable *offsets;    // Interned string -> pool offset
+    GArray *lists;
+    GArray *records;
+} CatalogCacheWriter;
+
+gint64 catalog_cache_file_stamp(const char *path) {
+    struct stat st;
+    if (stat(path, &st) < 0) return -1;
+    return (gint64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+static char* cache_file_path(const char *filename) {
+    return g_build_filename(g_get_user_cache_dir(), "pacman-gui", filename, NULL);
+}
+
+static void writer_init(CatalogCacheWriter *writer) {
+    writer->strings = g_byte_array_new();
+    writer->offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    writer->lists = g_array_new(FALSE, FALSE, sizeof(CatalogCacheList));
+    writer->records = g_array_new(FALSE, FALSE, sizeof(CatalogCacheRecord));
+}
+
+static void writer_clear(CatalogCacheWriter *writer) {
+    g_byte_array_free(writer->strings, TRUE);
+    g_hash_table_destroy(writer->offsets);
+    g_array_free(writer->lists, TRUE);
+    g_array_free(writer->records, TRUE);
+}
+
+// Repeated strings (repository names, common descriptions) are stored once
+static guint32 writer_intern(CatalogCacheWriter *writer, const char *str) {
+    if (!str) str = "";
+
+    gpointer offset;
+    if (g_hash_table_lookup_extended(writer->offsets, str, NULL, &offset)) {
+        return GPOINTER_TO_UINT(offset);
+    }
+
+    guint32 new_offset = writer->strings->len;
+    g_byte_array_append(writer->strings, (const guint8*)str, strlen(str) + 1);
+    g_hash_table_insert(writer->offsets, (gpointer)str, GUINT_TO_POINTER(new_offset));
+    return new_offset;
+}
+
+static void writer_add_list(CatalogCacheWriter *writer, const char *name, const char *path,
+                            gint64 stamp, const PackageList *packages) {
+    CatalogCacheList list;
+    list.name = writer_intern(writer, name);
+    list.path = writer_intern(writer, path);
+    list.first_record = writer->records->len;
+    list.count = packages->count;
+    list.stamp = stamp;
+    g_array_append_val(writer->lists, list);
+
+    for (int i = 0; i < packages->count; i++) {
+        const Package *pkg = &packages->packages[i];
+
+        CatalogCacheRecord record;
+        record.name = writer_intern(writer, pkg->name);
+        record.version = writer_intern(writer, pkg->version);
+        record.description = writer_intern(writer, pkg->description);
+        record.repository = writer_intern(writer, pkg->repository);
+        record.installed_size = pkg->installed_size;
+        record.install_date = pkg->install_date;
+        record.reason = pkg->reason;
+        record.installed = pkg->installed;
+        g_array_append_val(writer->records, record);
+    }
+}
+
+static gboolean writer_commit(CatalogCacheWriter *writer, const char *filename) {
+    CatalogCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_CACHE_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_CACHE_VERSION;
+    header.n_lists = writer->lists->len;
+    header.n_records = writer->records->len;
+    header.lists_offset = sizeof(CatalogCacheHeader);
+    header.records_offset = header.lists_offset + sizeof(CatalogCacheList) * header.n_lists;
+    header.strings_offset = header.records_offset + sizeof(CatalogCacheRecord) * header.n_records;
+    header.strings_size = writer->strings->len;
+
+    GByteArray *contents = g_byte_array_sized_new(header.strings_offset + header.strings_size);
+    g_byte_array_append(contents, (const guint8*)&header, sizeof(header));
+    g_byte_array_append(contents, (const guint8*)writer->lists->data,
+                        sizeof(CatalogCacheList) * header.n_lists);
+    g_byte_array_append(contents, (const guint8*)writer->records->data,
+                        sizeof(CatalogCacheRecord) * header.n_records);
+    g_byte_array_append(contents, writer->strings->data, writer->strings->len);
+
+    char *dir = g_build_filename(g_get_user_cache_dir(), "pacman-gui", NULL);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    // g_file_set_contents() renames a temporary file into place, so a
+    // process still mapping the previous snapshot keeps a valid view
+    char *path = cache_file_path(filename);
+    gboolean success = g_file_set_contents(path, (const char*)contents->data, contents->len, NULL);
+    g_free(path);
+
+    g_byte_array_free(contents, TRUE);
+    return success;
+}
+
+static GMappedFile* map_snapshot(const char *filename) {
+    char *path = cache_file_path(filename);
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (!mapped) return NULL;
+
+    const char *data = g_mapped_file_get_contents(mapped);
+    gsize length = g_mapped_file_get_length(mapped);
+    const CatalogCacheHeader *header = (const CatalogCacheHeader*)data;
+
+    gboolean valid = length >= sizeof(CatalogCacheHeader) &&
+                     memcmp(header->magic, CATALOG_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+                     header->version == CATALOG_CACHE_VERSION &&
+                     header->lists_offset + sizeof(CatalogCacheList) * (guint64)header->n_lists <= length &&
+                     header->records_offset + sizeof(CatalogCacheRecord) * (guint64)header->n_records <= length &&
+                     header->strings_size > 0 &&
+                     header->strings_offset + header->strings_size <= length &&
+                     data[header->strings_offset + header->strings_size - 1] == '\0';
+
+    const CatalogCacheList *lists = (const CatalogCacheList*)(data + header->lists_offset);
+    for (guint32 i = 0; valid && i < header->n_lists; i++) {
+        valid = (guint64)lists[i].first_record + lists[i].count <= header->n_records &&
+                lists[i].name < header->strings_size &&
+                lists[i].path < header->strings_size;
+    }
+
+    if (!valid) {
+        g_mapped_file_unref(mapped);
+        return NULL;
+    }
+
+    return mapped;
+}
+
+static const CatalogCacheHeader* snapshot_header(GMappedFile *mapped) {
+    return (const CatalogCacheHeader*)g_mapped_file_get_contents(mapped);
+}
+
+static const CatalogCacheList* snapshot_lists(GMappedFile *mapped) {
+    return (const CatalogCacheList*)(g_mapped_file_get_contents(mapped) + snapshot_header(mapped)->lists_offset);
+}
+
+static const char* snapshot_string(GMappedFile *mapped, guint32 offset) {
+    return g_mapped_file_get_contents(mapped) + snapshot_header(mapped)->strings_offset + offset;
+}
+
+// Builds a PackageList whose strings point into the mapping; only the
+// pointer table is allocated
+static PackageList* map_package_list(GMappedFile *mapped, const CatalogCacheList *entry) {
+    const CatalogCacheHeader *header = snapshot_header(mapped);
+    const char *data = g_mapped_file_get_contents(mapped);
+    const CatalogCacheRecord *records = (const CatalogCacheRecord*)(data + header->records_offset) + entry->first_record;
+    char *strings = (char*)data + header->strings_offset;
+
+    PackageList *list = package_list_new(entry->count);
+    list->backing = g_mapped_file_ref(mapped);
+    list->backing_free = (GDestroyNotify)g_mapped_file_unref;
+
+    for (guint32 i = 0; i < entry->count; i++) {
+        const CatalogCacheRecord *record = &records[i];
+        if (record->name >= header->strings_size || record->version >= header->strings_size ||
+            record->description >= header->strings_size || record->repository >= header->strings_size) {
+            package_list_free(list);
+            return NULL;
+        }
+
+        Package *pkg = &list->packages[list->count++];
+        pkg->name = strings + record->name;
+        pkg->version = strings + record->version;
+        pkg->description = strings + record->description;
+        pkg->repository = strings + record->repository;
+        pkg->installed_size = record->installed_size;
+        pkg->install_date = record->install_date;
+        pkg->reason = record->reason;
+        pkg->installed = record->installed;
+    }
+
+    return list;
+}
+
+PackageList* catalog_cache_load_local(const char *local_dir) {
+    GMappedFile *mapped = map_snapshot("local.catalog");
+    if (!mapped) return NULL;
+
+    PackageList *list = NULL;
+    const CatalogCacheList *entry = snapshot_lists(mapped);
+
+    // Adding, removing or upgrading a package replaces an entry directory,
+    // which bumps the mtime of local/ itself
+    if (snapshot_header(mapped)->n_lists == 1 &&
+        strcmp(snapshot_string(mapped, entry->path), local_dir) == 0 &&
+        entry->stamp == catalog_cache_file_stamp(local_dir)) {
+        list = map_package_list(mapped, entry);
+    }
+
+    g_mapped_file_unref(mapped);
+    return list;
+}
+
+static guint count_sync_db_files(const char *sync_dir) {
+    GDir *dir = g_dir_open(sync_dir, 0, NULL);
+    if (!dir) return 0;
+
+    guint count = 0;
+    const char *filename;
+    while ((filename = g_dir_read_name(dir))) {
+        if (g_str_has_suffix(filename, ".db")) count++;
+    }
+
+    g_dir_close(dir);
+    return count;
+}
+
+GPtrArray* catalog_cache_load_sync(const char *sync_dir) {
+    GMappedFile *mapped = map_snapshot("sync.catalog");
+    if (!mapped) return NULL;
+
+    const CatalogCacheHeader *header = snapshot_header(mapped);
+    const CatalogCacheList *lists = snapshot_lists(mapped);
+
+    // A repository added or removed since the snapshot also makes it stale
+    gboolean fresh = header->n_lists > 0 && header->n_lists == count_sync_db_files(sync_dir);
+    for (guint32 i = 0; fresh && i < header->n_lists; i++) {
+        const char *path = snapshot_string(mapped, lists[i].path);
+        char *dir = g_path_get_dirname(path);
+        fresh = strcmp(dir, sync_dir) == 0 && lists[i].stamp == catalog_cache_file_stamp(path);
+        g_free(dir);
+    }
+
+    GPtrArray *dbs = NULL;
+    if (fresh) {
+        dbs = g_ptr_array_new_with_free_func((GDestroyNotify)sync_db_free);
+
+        for (guint32 i = 0; i < header->n_lists; i++) {
+            PackageList *packages = map_package_list(mapped, &lists[i]);
+            if (!packages) {
+                g_ptr_array_free(dbs, TRUE);
+                dbs = NULL;
+                break;
+            }
+
+            SyncDb *db = g_malloc(sizeof(SyncDb));
+            db->name = strdup(snapshot_string(mapped, lists[i].name));
+            db->path = strdup(snapshot_string(mapped, lists[i].path));
+            db->mtime = lists[i].stamp;
+            db->packages = packages;
+            db->index = NULL;
+            g_ptr_array_add(dbs, db);
+        }
+    }
+
+    g_mapped_file_unref(mapped);
+    return dbs;
+}
+
+gboolean catalog_cache_save_local(const char *local_dir, gint64 stamp, const PackageList *installed) {
+    if (!installed || stamp < 0) return FALSE;
+
+    CatalogCacheWriter writer;
+    writer_init(&writer);
+    writer_add_list(&writer, "local", local_dir, stamp, installed);
+    gboolean success = writer_commit(&writer, "local.catalog");
+    writer_clear(&writer);
+
+    return success;
+}
+
+gboolean catalog_cache_save_sync(const char *sync_dir, GPtrArray *dbs) {
+    if (!dbs || dbs->len == 0) return FALSE;
+
+    CatalogCacheWriter writer;
+    writer_init(&writer);
+    for (guint i = 0; i < dbs->len; i++) {
+        SyncDb *db = g_ptr_array_index(dbs, i);
+        writer_add_list(&writer, db->name, db->path, db->mtime, db->packages);
+    }
+    gboolean success = writer_commit(&writer, "sync.catalog");
+    writer_clear(&writer);
+
+    return success;
+}
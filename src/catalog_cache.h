@@ -0,0 +1,25 @@
+#ifndef CATALOG_CACHE_H
+#define CATALOG_CACHE_H
+
+#include "pacman_wrapper.h"
+
+// Binary snapshots of the parsed local and sync catalogs, stored under
+// $XDG_CACHE_HOME/pacman-gui. A snapshot is a string pool plus fixed-width
+// records; loading maps the file and points the returned packages straight
+// into it, so nothing is parsed at startup. Mapped package strings are
+// read-only.
+
+// Modification time of path in nanoseconds, or -1 if it cannot be stat'ed
+gint64 catalog_cache_file_stamp(const char *path);
+
+// Both return NULL when the snapshot is missing, corrupt or older than the
+// database files it was built from. The sync variant returns SyncDb* entries
+// without a search index.
+PackageList* catalog_cache_load_local(const char *local_dir);
+GPtrArray* catalog_cache_load_sync(const char *sync_dir);
+
+// stamp is catalog_cache_file_stamp(local_dir), taken before reading it
+gboolean catalog_cache_save_local(const char *local_dir, gint64 stamp, const PackageList *installed);
+gboolean catalog_cache_save_sync(const char *sync_dir, GPtrArray *dbs);
+
+#endif
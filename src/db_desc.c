@@ -0,0 +1,65 @@
+#include "db_desc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Copies the collected values into arena as a plain array
+static char** finish_relation_list(GPtrArray *values, int *count, Arena *arena) {
+    *count = values->len;
+    if (values->len == 0) return NULL;
+
+    char **array = arena_alloc(arena, sizeof(char*) * values->len);
+    memcpy(array, values->pdata, sizeof(char*) * values->len);
+    return array;
+}
+
+// Sections look like "%NAME%" followed by one value per line and are
+// terminated by an empty line.
+void db_desc_parse(char *buffer, Package *pkg, DbDescRelations *relations, Arena *arena) {
+    const char *section = NULL;
+    char *line = buffer;
+    GPtrArray *depends = relations ? g_ptr_array_new() : NULL;
+    GPtrArray *provides = relations ? g_ptr_array_new() : NULL;
+    GPtrArray *conflicts = relations ? g_ptr_array_new() : NULL;
+
+    while (line) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        if (line[0] == '%') {
+            section = line;
+        } else if (line[0] == '\0') {
+            section = NULL;
+        } else if (section) {
+            if (strcmp(section, "%NAME%") == 0 && !pkg->name) {
+                pkg->name = arena_strdup(arena, line);
+            } else if (strcmp(section, "%VERSION%") == 0 && !pkg->version) {
+                pkg->version = arena_strdup(arena, line);
+            } else if (strcmp(section, "%DESC%") == 0 && !pkg->description) {
+                pkg->description = arena_strdup(arena, line);
+            } else if (strcmp(section, "%SIZE%") == 0 || strcmp(section, "%ISIZE%") == 0) {
+                pkg->installed_size = g_ascii_strtoull(line, NULL, 10);
+            } else if (strcmp(section, "%INSTALLDATE%") == 0) {
+                pkg->install_date = g_ascii_strtoll(line, NULL, 10);
+            } else if (strcmp(section, "%REASON%") == 0) {
+                pkg->reason = atoi(line) == 1 ? INSTALL_REASON_DEPEND : INSTALL_REASON_EXPLICIT;
+            } else if (depends && strcmp(section, "%DEPENDS%") == 0) {
+                g_ptr_array_add(depends, arena_strdup(arena, line));
+            } else if (provides && strcmp(section, "%PROVIDES%") == 0) {
+                g_ptr_array_add(provides, arena_strdup(arena, line));
+            } else if (conflicts && strcmp(section, "%CONFLICTS%") == 0) {
+                g_ptr_array_add(conflicts, arena_strdup(arena, line));
+            }
+        }
+
+        line = next;
+    }
+
+    if (relations) {
+        relations->depends = finish_relation_list(depends, &relations->n_depends, arena);
+        relations->provides = finish_relation_list(provides, &relations->n_provides, arena);
+        relations->conflicts = finish_relation_list(conflicts, &relations->n_conflicts, arena);
+        g_ptr_array_free(depends, TRUE);
+        g_ptr_array_free(provides, TRUE);
+        g_ptr_array_free(conflicts, TRUE);
+    }
+}
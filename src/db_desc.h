@@ -0,0 +1,24 @@
+#ifndef DB_DESC_H
+#define DB_DESC_H
+
+#include "pacman_wrapper.h"
+
+// Relationship lists of a package; arrays and strings live in the arena
+// passed to db_desc_parse. Entries keep any version constraint, e.g.
+// "glibc>=2.38".
+typedef struct {
+    char **depends;
+    int n_depends;
+    char **provides;        // "name" or "name=version"
+    int n_provides;
+    char **conflicts;
+    int n_conflicts;
+} DbDescRelations;
+
+// Parses a pacman database "desc" file in place into pkg. Strings are
+// copied into arena, so buffer can be reused afterwards. Understands
+// both local (%SIZE%) and sync (%ISIZE%) database layouts. relations may be
+// NULL when only the package fields are needed.
+void db_desc_parse(char *buffer, Package *pkg, DbDescRelations *relations, Arena *arena);
+
+#endif
@@ -0,0 +1,428 @@
+#include "dep_graph.h"
+#include "local_db.h"
+#include "catalog_cache.h"
+#include "vercmp.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    DEP_MOD_ANY,
+    DEP_MOD_EQ,
+    DEP_MOD_GE,
+    DEP_MOD_LE,
+    DEP_MOD_GT,
+    DEP_MOD_LT
+} DepMod;
+
+// A parsed "name[op version]" as found in %DEPENDS% and %CONFLICTS%
+typedef struct {
+    char *name;             // g_malloc'd
+    DepMod mod;
+    const char *version;    // Points into the spec, NULL for DEP_MOD_ANY
+} DepSpec;
+
+// One way a name is satisfied: by a package's own name or by its provides
+typedef struct {
+    int node;
+    const char *version;    // NULL for an unversioned provision
+} Provider;
+
+struct DepGraph {
+    gint ref_count;
+    gint64 stamp;           // catalog_cache_file_stamp of the local dir
+    PackageList *packages;  // Installed packages, nodes 0..count-1
+    Arena *arena;           // Names of unsatisfied dependency nodes
+    int n_nodes;
+    char **names;           // Node id -> name
+    GHashTable *index;      // Name -> node id + 1
+    GHashTable *providers;  // Provided name -> GArray of Provider
+    int *dep_offsets;       // n_nodes + 1 entries into dep_targets
+    int *dep_targets;       // Distinct per source node
+    const char **dep_specs; // Per edge, as written by the package
+    guint8 *dep_status;     // Per edge, a DepEdgeStatus
+    int *rdep_offsets;      // Same layout for reverse edges
+    int *rdep_sources;
+    int *conflict_offsets;  // Same layout for installed conflicts
+    int *conflict_targets;
+};
+
+static GMutex local_graph_lock;
+static DepGraph *local_graph = NULL;
+
+static void parse_dep_spec(const char *spec, DepSpec *dep) {
+    size_t name_length = strcspn(spec, "<>=");
+    const char *op = spec + name_length;
+
+    dep->name = g_strndup(spec, name_length);
+    dep->mod = DEP_MOD_ANY;
+    dep->version = NULL;
+
+    if (strncmp(op, ">=", 2) == 0) {
+        dep->mod = DEP_MOD_GE;
+        dep->version = op + 2;
+    } else if (strncmp(op, "<=", 2) == 0) {
+        dep->mod = DEP_MOD_LE;
+        dep->version = op + 2;
+    } else if (*op == '=') {
+        dep->mod = DEP_MOD_EQ;
+        dep->version = op + 1;
+    } else if (*op == '>') {
+        dep->mod = DEP_MOD_GT;
+        dep->version = op + 1;
+    } else if (*op == '<') {
+        dep->mod = DEP_MOD_LT;
+        dep->version = op + 1;
+    }
+}
+
+// Same rules as libalpm: an unversioned provision only satisfies an
+// unversioned dependency
+static gboolean version_satisfies(const char *version, const DepSpec *dep) {
+    if (dep->mod == DEP_MOD_ANY) return TRUE;
+    if (!version) return FALSE;
+
+    int cmp = vercmp(version, dep->version);
+    switch (dep->mod) {
+        case DEP_MOD_EQ: return cmp == 0;
+        case DEP_MOD_GE: return cmp >= 0;
+        case DEP_MOD_LE: return cmp <= 0;
+        case DEP_MOD_GT: return cmp > 0;
+        case DEP_MOD_LT: return cmp < 0;
+        default: return TRUE;
+    }
+}
+
+static void add_provider(DepGraph *graph, const char *name, int node, const char *version) {
+    GArray *list = g_hash_table_lookup(graph->providers, name);
+    if (!list) {
+        list = g_array_new(FALSE, FALSE, sizeof(Provider));
+        g_hash_table_insert(graph->providers, (gpointer)name, list);
+    }
+
+    Provider provider = { node, version };
+    g_array_append_val(list, provider);
+}
+
+static void build_provider_index(DepGraph *graph, DbDescRelations *relations) {
+    graph->providers = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                             (GDestroyNotify)g_array_unref);
+
+    for (int i = 0; i < graph->packages->count; i++) {
+        Package *pkg = &graph->packages->packages[i];
+        add_provider(graph, pkg->name, i, pkg->version);
+
+        for (int k = 0; k < relations[i].n_provides; k++) {
+            const char *provide = relations[i].provides[k];
+            const char *equals = strchr(provide, '=');
+            if (!equals) {
+                add_provider(graph, provide, i, NULL);
+            } else {
+                char *name = arena_strndup(graph->arena, provide, equals - provide);
+                add_provider(graph, name, i, equals + 1);
+            }
+        }
+    }
+}
+
+// Picks the installed package that satisfies dep, preferring one with the
+// literal name, the way pacman does. Returns -1 if there is none; *fallback
+// then receives a provider of the name with the wrong version, or -1.
+static int find_satisfier(const DepGraph *graph, const DepSpec *dep, int exclude, int *fallback) {
+    *fallback = -1;
+
+    GArray *list = g_hash_table_lookup(graph->providers, dep->name);
+    if (!list) return -1;
+
+    int satisfier = -1;
+    for (guint i = 0; i < list->len; i++) {
+        Provider *provider = &g_array_index(list, Provider, i);
+        if (provider->node == exclude) continue;
+
+        gboolean literal = strcmp(graph->packages->packages[provider->node].name, dep->name) == 0;
+        if (!version_satisfies(provider->version, dep)) {
+            if (*fallback < 0 || literal) *fallback = provider->node;
+            continue;
+        }
+
+        if (satisfier < 0 || literal) satisfier = provider->node;
+        if (literal) break;
+    }
+    return satisfier;
+}
+
+// Node a dependency resolves to, adding a placeholder node if nothing
+// installed provides its name
+static int resolve_dependency(DepGraph *graph, GPtrArray *names, const char *spec, DepEdgeStatus *status) {
+    DepSpec dep;
+    parse_dep_spec(spec, &dep);
+
+    int fallback;
+    int node = find_satisfier(graph, &dep, -1, &fallback);
+    *status = DEP_EDGE_SATISFIED;
+
+    if (node < 0 && fallback >= 0) {
+        node = fallback;
+        *status = DEP_EDGE_VERSION_MISMATCH;
+    } else if (node < 0) {
+        *status = DEP_EDGE_MISSING;
+        node = dep_graph_lookup(graph, dep.name);
+        if (node < 0) {
+            node = names->len;
+            char *stored = arena_strdup(graph->arena, dep.name);
+            g_ptr_array_add(names, stored);
+            g_hash_table_insert(graph->index, stored, GINT_TO_POINTER(node + 1));
+        }
+    }
+
+    g_free(dep.name);
+    return node;
+}
+
+// Inverts the forward edges: counts each node's in-degree, turns the counts
+// into offsets and scatters the sources. Sources come out in id order.
+static void build_reverse_edges(DepGraph *graph) {
+    int n_edges = graph->dep_offsets[graph->n_nodes];
+    graph->rdep_offsets = g_new0(int, graph->n_nodes + 1);
+    graph->rdep_sources = g_new(int, MAX(n_edges, 1));
+
+    for (int edge = 0; edge < n_edges; edge++) {
+        graph->rdep_offsets[graph->dep_targets[edge] + 1]++;
+    }
+    for (int node = 0; node < graph->n_nodes; node++) {
+        graph->rdep_offsets[node + 1] += graph->rdep_offsets[node];
+    }
+
+    int *fill = g_memdup2(graph->rdep_offsets, sizeof(int) * graph->n_nodes);
+    for (int node = 0; node < graph->n_nodes; node++) {
+        for (int edge = graph->dep_offsets[node]; edge < graph->dep_offsets[node + 1]; edge++) {
+            graph->rdep_sources[fill[graph->dep_targets[edge]]++] = node;
+        }
+    }
+    g_free(fill);
+}
+
+// Installed packages matched by another package's %CONFLICTS% entries. A
+// package never conflicts with itself, even if it names what it provides.
+static void build_conflicts(DepGraph *graph, DbDescRelations *relations) {
+    GArray *targets = g_array_new(FALSE, FALSE, sizeof(int));
+    graph->conflict_offsets = g_new(int, graph->n_nodes + 1);
+
+    for (int i = 0; i < graph->n_nodes; i++) {
+        graph->conflict_offsets[i] = targets->len;
+        if (i >= graph->packages->count) continue;
+
+        for (int k = 0; k < relations[i].n_conflicts; k++) {
+            DepSpec dep;
+            parse_dep_spec(relations[i].conflicts[k], &dep);
+
+            int fallback;
+            int node = find_satisfier(graph, &dep, i, &fallback);
+            if (node >= 0) g_array_append_val(targets, node);
+
+            g_free(dep.name);
+        }
+    }
+
+    graph->conflict_offsets[graph->n_nodes] = targets->len;
+    graph->conflict_targets = (int*)g_array_free(targets, FALSE);
+}
+
+DepGraph* dep_graph_build(const char *local_dir) {
+    // Stamp first, so a change made while reading forces another rebuild
+    gint64 stamp = catalog_cache_file_stamp(local_dir);
+
+    DbDescRelations *relations;
+    PackageList *packages = local_db_read_with_relations(local_dir, &relations);
+    if (!packages) return NULL;
+
+    DepGraph *graph = g_malloc0(sizeof(DepGraph));
+    graph->ref_count = 1;
+    graph->stamp = stamp;
+    graph->packages = packages;
+    graph->arena = arena_new();
+    graph->index = g_hash_table_new(g_str_hash, g_str_equal);
+
+    GPtrArray *names = g_ptr_array_sized_new(packages->count);
+    for (int i = 0; i < packages->count; i++) {
+        g_ptr_array_add(names, packages->packages[i].name);
+        g_hash_table_insert(graph->index, packages->packages[i].name, GINT_TO_POINTER(i + 1));
+    }
+
+    // Every provision must be known before the first edge is resolved
+    build_provider_index(graph, relations);
+
+    int n_edges = 0;
+    for (int i = 0; i < packages->count; i++) {
+        n_edges += relations[i].n_depends;
+    }
+
+    graph->dep_offsets = g_new(int, packages->count + 1);
+    graph->dep_targets = g_new(int, MAX(n_edges, 1));
+    graph->dep_specs = g_new(const char*, MAX(n_edges, 1));
+    graph->dep_status = g_new(guint8, MAX(n_edges, 1));
+
+    // Last edge into each target, so two specs of one package resolving to
+    // the same provider (e.g. "sh" and "bash") make a single edge. Targets
+    // are installed packages or placeholders, one per spec at most.
+    int *last_edge = g_new(int, packages->count + n_edges);
+    for (int i = 0; i < packages->count + n_edges; i++) last_edge[i] = -1;
+
+    int edge = 0;
+    for (int i = 0; i < packages->count; i++) {
+        graph->dep_offsets[i] = edge;
+        for (int k = 0; k < relations[i].n_depends; k++) {
+            DepEdgeStatus status;
+            int target = resolve_dependency(graph, names, relations[i].depends[k], &status);
+
+            int seen = last_edge[target];
+            if (seen >= graph->dep_offsets[i]) {
+                // The edge reports the spec that did not resolve cleanly
+                if (status != DEP_EDGE_SATISFIED && graph->dep_status[seen] == DEP_EDGE_SATISFIED) {
+                    graph->dep_specs[seen] = relations[i].depends[k];
+                    graph->dep_status[seen] = status;
+                }
+                continue;
+            }
+
+            last_edge[target] = edge;
+            graph->dep_specs[edge] = relations[i].depends[k];
+            graph->dep_targets[edge] = target;
+            graph->dep_status[edge] = status;
+            edge++;
+        }
+    }
+    g_free(last_edge);
+
+    // Unsatisfied dependencies were appended while resolving; they have no
+    // edges of their own
+    graph->n_nodes = names->len;
+    graph->dep_offsets = g_renew(int, graph->dep_offsets, graph->n_nodes + 1);
+    for (int i = packages->count; i <= graph->n_nodes; i++) {
+        graph->dep_offsets[i] = edge;
+    }
+    graph->names = (char**)g_ptr_array_free(names, FALSE);
+
+    build_reverse_edges(graph);
+    build_conflicts(graph, relations);
+
+    g_free(relations);
+    return graph;
+}
+
+DepGraph* dep_graph_get_local(void) {
+    char *local_dir = g_build_filename(pacman_get_db_path(), "local", NULL);
+    gint64 stamp = catalog_cache_file_stamp(local_dir);
+
+    g_mutex_lock(&local_graph_lock);
+    if (!local_graph || stamp < 0 || local_graph->stamp != stamp) {
+        DepGraph *graph = dep_graph_build(local_dir);
+        if (graph) {
+            if (local_graph) dep_graph_unref(local_graph);
+            local_graph = graph;
+        }
+    }
+    DepGraph *graph = local_graph ? dep_graph_ref(local_graph) : NULL;
+    g_mutex_unlock(&local_graph_lock);
+
+    g_free(local_dir);
+    return graph;
+}
+
+DepGraph* dep_graph_ref(DepGraph *graph) {
+    g_atomic_int_inc(&graph->ref_count);
+    return graph;
+}
+
+void dep_graph_unref(DepGraph *graph) {
+    if (!graph || !g_atomic_int_dec_and_test(&graph->ref_count)) return;
+
+    g_hash_table_destroy(graph->index);
+    g_hash_table_destroy(graph->providers);
+    g_free(graph->names);
+    g_free(graph->dep_offsets);
+    g_free(graph->dep_targets);
+    g_free(graph->dep_specs);
+    g_free(graph->dep_status);
+    g_free(graph->rdep_offsets);
+    g_free(graph->rdep_sources);
+    g_free(graph->conflict_offsets);
+    g_free(graph->conflict_targets);
+    arena_free(graph->arena);
+    package_list_free(graph->packages);
+    g_free(graph);
+}
+
+int dep_graph_node_count(const DepGraph *graph) {
+    return graph->n_nodes;
+}
+
+int dep_graph_lookup(const DepGraph *graph, const char *name) {
+    return GPOINTER_TO_INT(g_hash_table_lookup(graph->index, name)) - 1;
+}
+
+const char* dep_graph_name(const DepGraph *graph, int node) {
+    return graph->names[node];
+}
+
+const Package* dep_graph_package(const DepGraph *graph, int node) {
+    return node < graph->packages->count ? &graph->packages->packages[node] : NULL;
+}
+
+const int* dep_graph_depends(const DepGraph *graph, int node, int *count) {
+    *count = graph->dep_offsets[node + 1] - graph->dep_offsets[node];
+    return &graph->dep_targets[graph->dep_offsets[node]];
+}
+
+const char* dep_graph_depend_spec(const DepGraph *graph, int node, int index) {
+    return graph->dep_specs[graph->dep_offsets[node] + index];
+}
+
+DepEdgeStatus dep_graph_depend_status(const DepGraph *graph, int node, int index) {
+    return graph->dep_status[graph->dep_offsets[node] + index];
+}
+
+const int* dep_graph_required_by(const DepGraph *graph, int node, int *count) {
+    *count = graph->rdep_offsets[node + 1] - graph->rdep_offsets[node];
+    return &graph->rdep_sources[graph->rdep_offsets[node]];
+}
+
+const int* dep_graph_conflicts(const DepGraph *graph, int node, int *count) {
+    *count = graph->conflict_offsets[node + 1] - graph->conflict_offsets[node];
+    return &graph->conflict_targets[graph->conflict_offsets[node]];
+}
+
+GArray* dep_graph_subtree(const DepGraph *graph, int root, int max_depth, GArray **depths) {
+    GArray *order = g_array_new(FALSE, FALSE, sizeof(int));
+    GArray *order_depths = g_array_new(FALSE, FALSE, sizeof(int));
+    gboolean *visited = g_new0(gboolean, graph->n_nodes);
+
+    // order doubles as the BFS queue
+    g_array_append_val(order, root);
+    int root_depth = 0;
+    g_array_append_val(order_depths, root_depth);
+    visited[root] = TRUE;
+
+    for (guint head = 0; head < order->len; head++) {
+        int node = g_array_index(order, int, head);
+        int depth = g_array_index(order_depths, int, head);
+        if (depth >= max_depth) continue;
+
+        int count;
+        const int *targets = dep_graph_depends(graph, node, &count);
+        int child_depth = depth + 1;
+        for (int i = 0; i < count; i++) {
+            if (visited[targets[i]]) continue;
+            visited[targets[i]] = TRUE;
+            g_array_append_val(order, targets[i]);
+            g_array_append_val(order_depths, child_depth);
+        }
+    }
+
+    g_free(visited);
+    if (depths) {
+        *depths = order_depths;
+    } else {
+        g_array_free(order_depths, TRUE);
+    }
+    return order;
+}
@@ -0,0 +1,56 @@
+#ifndef DEP_GRAPH_H
+#define DEP_GRAPH_H
+
+#include "pacman_wrapper.h"
+
+// Dependency graph of every installed package, built from the local
+// database in a single pass. Nodes have dense integer ids: installed
+// packages first, in name order, followed by dependencies no installed
+// package satisfies. Dependencies resolve through a hashed provides index
+// using libalpm's version rules. Edges are stored in CSR form (an offsets
+// array into one targets array), so the dependencies of a node are a
+// contiguous slice. Reverse edges use the same layout and are derived by
+// inverting the forward ones. A built graph is immutable and may be shared
+// between threads.
+typedef struct DepGraph DepGraph;
+
+// How a dependency edge was resolved. Edges point at the concrete package
+// that satisfies the dependency, which for a virtual name such as "sh" is
+// whatever provides it.
+typedef enum {
+    DEP_EDGE_SATISFIED,
+    DEP_EDGE_MISSING,           // Nothing installed provides the name
+    DEP_EDGE_VERSION_MISMATCH   // Points at a provider with the wrong version
+} DepEdgeStatus;
+
+// Graph of the current local database, rebuilt only when the database has
+// changed since the last call. Returns a new reference, or NULL if the
+// database cannot be read.
+DepGraph* dep_graph_get_local(void);
+DepGraph* dep_graph_build(const char *local_dir);
+DepGraph* dep_graph_ref(DepGraph *graph);
+void dep_graph_unref(DepGraph *graph);
+
+int dep_graph_node_count(const DepGraph *graph);
+// Node id of name, or -1
+int dep_graph_lookup(const DepGraph *graph, const char *name);
+const char* dep_graph_name(const DepGraph *graph, int node);
+// Installed package behind node, or NULL for an unsatisfied dependency
+const Package* dep_graph_package(const DepGraph *graph, int node);
+// Ids of the direct dependencies of node; *count receives their number
+const int* dep_graph_depends(const DepGraph *graph, int node, int *count);
+// Dependency index of node as written by the package, e.g. "glibc>=2.38",
+// and how it resolved
+const char* dep_graph_depend_spec(const DepGraph *graph, int node, int index);
+DepEdgeStatus dep_graph_depend_status(const DepGraph *graph, int node, int index);
+// Ids of the installed packages that depend on node directly
+const int* dep_graph_required_by(const DepGraph *graph, int node, int *count);
+// Installed packages that node's %CONFLICTS% entries match
+const int* dep_graph_conflicts(const DepGraph *graph, int node, int *count);
+
+// Breadth-first walk along dependency edges from root, at most max_depth
+// edges deep. Returns the node ids in visiting order (root first) and, if
+// depths is not NULL, a parallel array with each node's distance from root.
+GArray* dep_graph_subtree(const DepGraph *graph, int root, int max_depth, GArray **depths);
+
+#endif
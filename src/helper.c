@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include "helper_protocol.h"
+#include "line_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// pacman-gui-helper: runs pacman transactions for pacman-gui. Started once
+// per session through pkexec, so the user authenticates once, it then reads
+// requests from stdin and streams their output to stdout until the GUI
+// closes its end. See helper_protocol.h.
+//
+// For development without root, --simulate replaces pacman with canned
+// output and --pacman runs another program in its place. --cache-dir points
+// cache pruning at another directory. None of them is accepted as root.
+
+typedef struct {
+    guint64 id;
+    HelperOperation op;
+    char **packages;            // Cache file names for PRUNE_CACHE
+} Request;
+
+static GMainLoop *main_loop;
+static GQueue pending = G_QUEUE_INIT;
+static LineReader *request_reader;
+static gboolean input_closed;
+static gboolean output_closed;
+
+// The request being run
+static Request *current;
+static pid_t current_pid;
+static int current_fd = -1;
+static LineReader *current_reader;
+
+static const char *pacman_path = "/usr/bin/pacman";
+static const char *cache_dir = "/var/cache/pacman/pkg";
+static gboolean simulate;
+
+static void free_request(Request *request) {
+    g_strfreev(request->packages);
+    g_free(request);
+}
+
+static void send_events(const char *data, gsize length) {
+    // With nobody left to report to, output is still drained so pacman
+    // never dies of a broken pipe halfway through a transaction
+    if (output_closed) return;
+    if (!helper_write_all(STDOUT_FILENO, data, length)) output_closed = TRUE;
+}
+
+static void send_line(guint64 id, const char *text, gboolean provisional) {
+    char *event = g_strdup_printf("%" G_GUINT64_FORMAT "\tLINE\t%c\t%s\n", id, provisional ? 'p' : 'f', text);
+    send_events(event, strlen(event));
+    g_free(event);
+}
+
+static void send_done(guint64 id, int status) {
+    char event[64];
+    int length = snprintf(event, sizeof(event), "%" G_GUINT64_FORMAT "\tDONE\t%d\n", id, status);
+    send_events(event, length);
+}
+
+static void on_output_lines(const OutputLine *lines, int count, gpointer user_data) {
+    // One write per batch of output
+    GString *events = g_string_sized_new(count * 80);
+    for (int i = 0; i < count; i++) {
+        g_string_append_printf(events, "%" G_GUINT64_FORMAT "\tLINE\t%c\t", current->id,
+                               lines[i].provisional ? 'p' : 'f');
+        g_string_append_len(events, lines[i].text, lines[i].length);
+        g_string_append_c(events, '\n');
+    }
+    send_events(events->str, events->len);
+    g_string_free(events, TRUE);
+}
+
+static void start_next(void);
+
+static void on_output_done(gpointer user_data) {
+    int status = 0;
+    pid_t reaped;
+    do {
+        reaped = waitpid(current_pid, &status, 0);
+    } while (reaped < 0 && errno == EINTR);
+
+    // Without a status to go by, e.g. ECHILD, the request failed
+    int exit_status = 1;
+    if (reaped == current_pid) {
+        exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+
+    send_done(current->id, exit_status);
+
+    line_reader_free(current_reader);
+    close(current_fd);
+    free_request(current);
+    current = NULL;
+    current_reader = NULL;
+    current_fd = -1;
+
+    start_next();
+}
+
+static char** operation_argv(const Request *request) {
+    GPtrArray *argv = g_ptr_array_new();
+    g_ptr_array_add(argv, g_strdup(pacman_path));
+
+    switch (request->op) {
+    case HELPER_OP_INSTALL:
+        g_ptr_array_add(argv, g_strdup("-S"));
+        break;
+    case HELPER_OP_REMOVE:
+        g_ptr_array_add(argv, g_strdup("-R"));
+        break;
+    case HELPER_OP_UPGRADE:
+        g_ptr_array_add(argv, g_strdup("-Syu"));
+        break;
+    case HELPER_OP_CLEAN_CACHE:
+        g_ptr_array_add(argv, g_strdup("-Sc"));
+        break;
+    case HELPER_OP_CLEAN_ALL_CACHE:
+        g_ptr_array_add(argv, g_strdup("-Scc"));
+        break;
+    default:
+        break;
+    }
+    g_ptr_array_add(argv, g_strdup("--noconfirm"));
+
+    if (helper_operation_takes_arguments(request->op)) {
+        g_ptr_array_add(argv, g_strdup("--"));
+        for (char **package = request->packages; *package; package++) {
+            g_ptr_array_add(argv, g_strdup(*package));
+        }
+    }
+
+    g_ptr_array_add(argv, NULL);
+    return (char**)g_ptr_array_free(argv, FALSE);
+}
+
+// Runs in the child for PRUNE_CACHE. Names were validated to have no path
+// separator, so every unlink stays inside the cache directory. Returns the
+// exit status.
+static int prune_cache_files(const Request *request) {
+    int dirfd = open(cache_dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dirfd < 0) {
+        printf("error: cannot open %s: %s\n", cache_dir, strerror(errno));
+        return 1;
+    }
+
+    int removed = 0;
+    int failed = 0;
+    guint64 freed = 0;
+    for (char **name = request->packages; *name; name++) {
+        struct stat info;
+        if (fstatat(dirfd, *name, &info, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISREG(info.st_mode)) {
+            printf("warning: %s is not in the cache, skipping\n", *name);
+            continue;
+        }
+        if (!simulate && unlinkat(dirfd, *name, 0) == -1) {
+            printf("error: cannot remove %s: %s\n", *name, strerror(errno));
+            failed++;
+            continue;
+        }
+        printf("removed %s\n", *name);
+        removed++;
+        freed += info.st_size;
+    }
+    close(dirfd);
+
+    char *size = g_format_size(freed);
+    printf("%d files removed from %s, %s freed\n", removed, cache_dir, size);
+    g_free(size);
+    return failed > 0 ? 1 : 0;
+}
+
+// Stand-in for pacman in --simulate mode: output shaped like a real
+// transaction, paced so progress can be watched
+static void simulate_operation(const Request *request) {
+    int count = g_strv_length(request->packages);
+
+    if (request->op == HELPER_OP_CLEAN_CACHE || request->op == HELPER_OP_CLEAN_ALL_CACHE) {
+        printf("\nCache directory: /var/cache/pacman/pkg/\n:: Do you want to remove %s packages from cache? [Y/n] \n"
+               "removing old packages from cache...\n",
+               request->op == HELPER_OP_CLEAN_CACHE ? "all other" : "ALL files");
+        return;
+    }
+    if (request->op == HELPER_OP_UPGRADE) {
+        printf(":: Synchronizing package databases...\n core downloading...\n extra downloading...\n"
+               ":: Starting full system upgrade...\n there is nothing to do\n");
+        return;
+    }
+
+    gboolean removing = request->op == HELPER_OP_REMOVE;
+    printf(removing ? "checking dependencies...\n" : "resolving dependencies...\nlooking for conflicting packages...\n");
+    printf("\nPackages (%d)", count);
+    for (int i = 0; i < count; i++) printf(" %s-1.0-1", request->packages[i]);
+    printf("\n\n");
+    fflush(stdout);
+
+    if (!removing) {
+        printf(":: Proceed with installation? [Y/n] \n:: Retrieving packages...\n");
+        for (int i = 0; i < count; i++) {
+            printf(" %s-1.0-1-x86_64 downloading...\n", request->packages[i]);
+            fflush(stdout);
+            g_usleep(200000);
+        }
+        printf("checking keyring...\nchecking package integrity...\nloading package files...\n"
+               "checking for file conflicts...\nchecking available disk space...\n");
+    } else {
+        printf(":: Do you want to remove these packages? [Y/n] \n");
+    }
+
+    printf(":: Processing package changes...\n");
+    for (int i = 0; i < count; i++) {
+        printf("%s %s...\n", removing ? "removing" : "installing", request->packages[i]);
+        fflush(stdout);
+        g_usleep(200000);
+    }
+    printf(":: Running post-transaction hooks...\n(1/1) Arming ConditionNeedsUpdate...\n");
+}
+
+static void start_next(void) {
+    if (current) return;
+
+    current = g_queue_pop_head(&pending);
+    if (!current) {
+        if (input_closed) g_main_loop_quit(main_loop);
+        return;
+    }
+
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        send_line(current->id, "pacman-gui-helper: cannot create a pipe", FALSE);
+        send_done(current->id, 1);
+        free_request(current);
+        current = NULL;
+        start_next();
+        return;
+    }
+
+    char **argv = operation_argv(current);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child process: pacman must never wait for an answer on stdin
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) dup2(null_fd, STDIN_FILENO);
+        signal(SIGPIPE, SIG_DFL);
+        close(pipefd[0]);
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[1]);
+
+        if (current->op == HELPER_OP_PRUNE_CACHE) {
+            // In --simulate mode files are listed but kept
+            int status = prune_cache_files(current);
+            fflush(stdout);
+            _exit(status);
+        }
+        if (simulate) {
+            simulate_operation(current);
+            fflush(stdout);
+            _exit(0);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "pacman-gui-helper: cannot run %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    g_strfreev(argv);
+    close(pipefd[1]);
+
+    if (pid == -1) {
+        close(pipefd[0]);
+        send_line(current->id, "pacman-gui-helper: cannot start pacman", FALSE);
+        send_done(current->id, 1);
+        free_request(current);
+        current = NULL;
+        start_next();
+        return;
+    }
+
+    current_pid = pid;
+    current_fd = pipefd[0];
+    current_reader = line_reader_new(current_fd, on_output_lines, on_output_done, NULL);
+}
+
+// Parses one request line; NULL and a reason if it is not acceptable
+static Request* parse_request(const char *line, guint64 *id, const char **reason) {
+    char **fields = g_strsplit(line, "\t", -1);
+    int field_count = g_strv_length(fields);
+    Request *request = NULL;
+    HelperOperation op;
+    char *end = NULL;
+
+    *id = 0;
+    if (field_count >= 1) *id = g_ascii_strtoull(fields[0], &end, 10);
+
+    if (field_count < 2 || !end || *end != '\0' || *id == 0) {
+        *reason = "malformed request";
+    } else if (!helper_operation_parse(fields[1], &op)) {
+        *reason = "unknown operation";
+    } else if (helper_operation_takes_arguments(op) != (field_count > 2)) {
+        *reason = helper_operation_takes_arguments(op) ? "no arguments given" : "unexpected arguments";
+    } else {
+        *reason = NULL;
+        for (int i = 2; i < field_count && !*reason; i++) {
+            if (!helper_argument_valid(op, fields[i])) {
+                *reason = op == HELPER_OP_PRUNE_CACHE ? "invalid cache file name" : "invalid package name";
+            }
+        }
+    }
+
+    if (!*reason) {
+        request = g_malloc(sizeof(Request));
+        request->id = *id;
+        request->op = op;
+        request->packages = g_new0(char*, field_count - 1);
+        for (int i = 2; i < field_count; i++) request->packages[i - 2] = g_strdup(fields[i]);
+    }
+
+    g_strfreev(fields);
+    return request;
+}
+
+static void on_request_lines(const OutputLine *lines, int count, gpointer user_data) {
+    for (int i = 0; i < count; i++) {
+        if (lines[i].provisional || lines[i].length == 0) continue;
+
+        guint64 id;
+        const char *reason;
+        Request *request = parse_request(lines[i].text, &id, &reason);
+        if (!request) {
+            fprintf(stderr, "pacman-gui-helper: rejected request: %s\n", reason);
+            if (id != 0) {
+                char *message = g_strdup_printf("pacman-gui-helper: rejected request: %s", reason);
+                send_line(id, message, FALSE);
+                send_done(id, 2);
+                g_free(message);
+            }
+            continue;
+        }
+        g_queue_push_tail(&pending, request);
+    }
+    start_next();
+}
+
+static void on_request_input_done(gpointer user_data) {
+    // The GUI is gone: finish the running transaction, drop the rest.
+    // Interrupting pacman midway could leave the system half upgraded.
+    input_closed = TRUE;
+    g_queue_clear_full(&pending, (GDestroyNotify)free_request);
+    if (!current) g_main_loop_quit(main_loop);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simulate") == 0) {
+            simulate = TRUE;
+        } else if (strcmp(argv[i], "--pacman") == 0 && i + 1 < argc) {
+            pacman_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--simulate] [--pacman PATH] [--cache-dir PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Whoever can start us through pkexec with a cached authorization could
+    // otherwise run any program as root, or delete files anywhere
+    if (argc > 1 && (getuid() == 0 || getenv("PKEXEC_UID"))) {
+        fprintf(stderr, "%s: development options are not accepted as root\n", argv[0]);
+        return 2;
+    }
+
+    // pkexec runs us with a minimal environment; pacman output is parsed
+    // by the GUI, so keep it untranslated
+    setenv("LC_ALL", "C", 1);
+    signal(SIGPIPE, SIG_IGN);
+
+    main_loop = g_main_loop_new(NULL, FALSE);
+    request_reader = line_reader_new(STDIN_FILENO, on_request_lines, on_request_input_done, NULL);
+
+    char ready[64];
+    int length = snprintf(ready, sizeof(ready), "0\tREADY\t%d\n", HELPER_PROTOCOL_VERSION);
+    send_events(ready, length);
+
+    g_main_loop_run(main_loop);
+
+    line_reader_free(request_reader);
+    g_main_loop_unref(main_loop);
+    return 0;
+}
@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include "helper_client.h"
+#include "line_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// pkexec exit statuses when authorization failed or was dismissed
+#define PKEXEC_NOT_AUTHORIZED 127
+#define PKEXEC_DISMISSED 126
+
+typedef struct {
+    LogCallback callback;
+    OperationDoneCallback done;
+    gpointer user_data;
+} HelperRequest;
+
+struct HelperClient {
+    char **argv;
+    pid_t pid;              // 0 while no helper is running
+    int fd;
+    LineReader *reader;
+    gboolean ready;         // READY seen: the helper was authorized
+    gboolean incompatible;  // The helper speaks another protocol version
+    guint64 next_id;
+    GHashTable *requests;   // id -> HelperRequest
+
+    // LINE events of one request, delivered together
+    GArray *batch;
+    guint64 batch_id;
+};
+
+static GHashTable* new_request_table(void) {
+    return g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_free);
+}
+
+static void flush_batch(HelperClient *client) {
+    if (client->batch->len == 0) return;
+
+    HelperRequest *request = g_hash_table_lookup(client->requests, &client->batch_id);
+    if (request && request->callback) {
+        request->callback((const OutputLine*)client->batch->data, client->batch->len, request->user_data);
+    }
+    g_array_set_size(client->batch, 0);
+}
+
+static void finish_request(HelperClient *client, guint64 id, gboolean success) {
+    gpointer key, value;
+    if (!g_hash_table_steal_extended(client->requests, &id, &key, &value)) return;
+
+    HelperRequest *request = (HelperRequest*)value;
+    if (request->done) request->done(success, request->user_data);
+    g_free(key);
+    g_free(request);
+}
+
+static void fail_request(gpointer key, gpointer value, gpointer user_data) {
+    HelperRequest *request = (HelperRequest*)value;
+    const char *message = (const char*)user_data;
+
+    if (request->callback) {
+        OutputLine line = { message, strlen(message), FALSE };
+        request->callback(&line, 1, request->user_data);
+    }
+    if (request->done) request->done(FALSE, request->user_data);
+}
+
+static void fail_all_requests(HelperClient *client, const char *message) {
+    g_array_set_size(client->batch, 0);
+
+    // Callbacks may already submit new requests
+    GHashTable *orphans = client->requests;
+    client->requests = new_request_table();
+    g_hash_table_foreach(orphans, fail_request, (gpointer)message);
+    g_hash_table_destroy(orphans);
+}
+
+// An installed helper from another release would fail requests it does not
+// know as generic errors, or misread them
+static void on_version_mismatch(HelperClient *client, int version) {
+    char *message = g_strdup_printf("Privileged helper version mismatch: it speaks protocol %d, "
+                                    "pacman-gui needs %d", version, HELPER_PROTOCOL_VERSION);
+    client->incompatible = TRUE;
+    fail_all_requests(client, message);
+    g_free(message);
+
+    // The helper exits once its input ends; on_closed then cleans up
+    shutdown(client->fd, SHUT_WR);
+}
+
+static void on_events(const OutputLine *lines, int count, gpointer user_data) {
+    HelperClient *client = (HelperClient*)user_data;
+
+    for (int i = 0; i < count; i++) {
+        // <id> TAB <kind> TAB ...
+        char *end;
+        guint64 id = g_ascii_strtoull(lines[i].text, &end, 10);
+        if (*end != '\t') continue;
+        const char *kind = end + 1;
+
+        if (strncmp(kind, "LINE\t", 5) == 0 && kind[5] != '\0' && kind[6] == '\t') {
+            if (id != client->batch_id) flush_batch(client);
+            client->batch_id = id;
+
+            // The text runs to the end of the event, so it stays terminated
+            const char *text = kind + 7;
+            OutputLine line = { text, lines[i].length - (text - lines[i].text), kind[5] == 'p' };
+            g_array_append_val(client->batch, line);
+        } else if (strncmp(kind, "DONE\t", 5) == 0) {
+            flush_batch(client);
+            finish_request(client, id, atoi(kind + 5) == 0);
+        } else if (strncmp(kind, "READY\t", 6) == 0) {
+            client->ready = TRUE;
+            int version = atoi(kind + 6);
+            if (version != HELPER_PROTOCOL_VERSION) {
+                on_version_mismatch(client, version);
+                return;
+            }
+        }
+    }
+    flush_batch(client);
+}
+
+static void on_closed(gpointer user_data) {
+    HelperClient *client = (HelperClient*)user_data;
+
+    int status = 0;
+    while (waitpid(client->pid, &status, 0) < 0 && errno == EINTR);
+    int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    const char *message;
+    if (!client->ready && (exit_status == PKEXEC_NOT_AUTHORIZED || exit_status == PKEXEC_DISMISSED)) {
+        message = "Authorization failed or was dismissed";
+    } else if (!client->ready) {
+        message = "Could not start the privileged helper";
+    } else {
+        message = "The privileged helper exited unexpectedly";
+    }
+
+    line_reader_free(client->reader);
+    close(client->fd);
+    client->reader = NULL;
+    client->fd = -1;
+    client->pid = 0;
+    client->ready = FALSE;
+    fail_all_requests(client, message);
+}
+
+static gboolean start_helper(HelperClient *client) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) return FALSE;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(sv[0]);
+        close(sv[1]);
+        return FALSE;
+    }
+
+    if (pid == 0) {
+        // Child process: requests on stdin, events on stdout. pkexec keeps
+        // only the standard descriptors.
+        dup2(sv[1], STDIN_FILENO);
+        dup2(sv[1], STDOUT_FILENO);
+        execvp(client->argv[0], client->argv);
+        _exit(127);
+    }
+
+    close(sv[1]);
+    client->pid = pid;
+    client->fd = sv[0];
+    client->reader = line_reader_new(client->fd, on_events, on_closed, client);
+    return TRUE;
+}
+
+HelperClient* helper_client_new(char **argv) {
+    HelperClient *client = g_malloc0(sizeof(HelperClient));
+    client->argv = g_strdupv(argv);
+    client->fd = -1;
+    client->next_id = 1;
+    client->requests = new_request_table();
+    client->batch = g_array_new(FALSE, FALSE, sizeof(OutputLine));
+    return client;
+}
+
+gboolean helper_client_submit(HelperClient *client, HelperOperation op, const char *const *packages, int count,
+                              LogCallback callback, OperationDoneCallback done, gpointer user_data) {
+    if (client->incompatible) return FALSE;
+    if (helper_operation_takes_arguments(op) != (count > 0)) return FALSE;
+    for (int i = 0; i < count; i++) {
+        if (!helper_argument_valid(op, packages[i])) return FALSE;
+    }
+
+    if (!client->pid && !start_helper(client)) return FALSE;
+
+    guint64 id = client->next_id++;
+    GString *message = g_string_new(NULL);
+    g_string_append_printf(message, "%" G_GUINT64_FORMAT "\t%s", id, helper_operation_name(op));
+    for (int i = 0; i < count; i++) {
+        g_string_append_c(message, '\t');
+        g_string_append(message, packages[i]);
+    }
+    g_string_append_c(message, '\n');
+
+    // Queued in the socket until the helper has been authorized
+    gboolean sent = helper_write_all(client->fd, message->str, message->len);
+    g_string_free(message, TRUE);
+    if (!sent) return FALSE;
+
+    HelperRequest *request = g_malloc(sizeof(HelperRequest));
+    request->callback = callback;
+    request->done = done;
+    request->user_data = user_data;
+    guint64 *key = g_new(guint64, 1);
+    *key = id;
+    g_hash_table_insert(client->requests, key, request);
+    return TRUE;
+}
+
+gboolean helper_client_is_incompatible(HelperClient *client) {
+    return client->incompatible;
+}
+
+void helper_client_free(HelperClient *client) {
+    if (!client) return;
+
+    if (client->reader) line_reader_free(client->reader);
+    if (client->fd >= 0) close(client->fd);
+    g_hash_table_destroy(client->requests);
+    g_array_free(client->batch, TRUE);
+    g_strfreev(client->argv);
+    g_free(client);
+}
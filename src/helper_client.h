@@ -0,0 +1,29 @@
+#ifndef HELPER_CLIENT_H
+#define HELPER_CLIENT_H
+
+#include "pacman_wrapper.h"
+#include "helper_protocol.h"
+
+// Connection to pacman-gui-helper, the privileged process that runs pacman
+// transactions. The helper is started on the first request, over one end of
+// a socketpair, and kept for the rest of the session, so authorization and
+// pacman's startup happen once rather than per operation. If it exits, every
+// outstanding request fails and the next request starts a new one.
+typedef struct HelperClient HelperClient;
+
+// argv starts the helper, e.g. { "pkexec", "/usr/lib/pacman-gui/pacman-gui-helper" };
+// it is copied
+HelperClient* helper_client_new(char **argv);
+// Output lines arrive batched as with any other operation, then done is
+// called once with the outcome. FALSE if the request could not be sent,
+// for instance because a package name is not acceptable.
+gboolean helper_client_submit(HelperClient *client, HelperOperation op, const char *const *packages, int count,
+                              LogCallback callback, OperationDoneCallback done, gpointer user_data);
+// Whether the helper turned out to speak another protocol version. Its
+// requests have then failed and no more are accepted.
+gboolean helper_client_is_incompatible(HelperClient *client);
+// Closes the connection without calling back; the helper finishes the
+// transaction it is running and exits
+void helper_client_free(HelperClient *client);
+
+#endif
@@ -0,0 +1,87 @@
+#include "helper_protocol.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// Maximum length of a package name accepted by the helper
+#define HELPER_PACKAGE_NAME_MAX 256
+// NAME_MAX of Linux file systems
+#define HELPER_FILE_NAME_MAX 255
+
+static const char *const operation_names[HELPER_OP_COUNT] = {
+    "INSTALL",
+    "REMOVE",
+    "UPGRADE",
+    "CLEAN_CACHE",
+    "CLEAN_ALL_CACHE",
+    "PRUNE_CACHE"
+};
+
+const char* helper_operation_name(HelperOperation op) {
+    return op < HELPER_OP_COUNT ? operation_names[op] : NULL;
+}
+
+gboolean helper_operation_parse(const char *name, HelperOperation *op) {
+    for (int i = 0; i < HELPER_OP_COUNT; i++) {
+        if (strcmp(name, operation_names[i]) == 0) {
+            *op = (HelperOperation)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+gboolean helper_operation_takes_arguments(HelperOperation op) {
+    return op == HELPER_OP_INSTALL || op == HELPER_OP_REMOVE || op == HELPER_OP_PRUNE_CACHE;
+}
+
+gboolean helper_package_name_valid(const char *name) {
+    if (!name || name[0] == '\0' || name[0] == '-' || name[0] == '.') return FALSE;
+
+    gsize length = 0;
+    for (const char *p = name; *p; p++, length++) {
+        if (length >= HELPER_PACKAGE_NAME_MAX) return FALSE;
+        if (!g_ascii_isalnum(*p) && !strchr("@._+-", *p)) return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean helper_cache_file_name_valid(const char *name) {
+    if (!name || name[0] == '\0' || name[0] == '-' || name[0] == '.') return FALSE;
+    if (!strstr(name, ".pkg.tar")) return FALSE;
+
+    gsize length = 0;
+    for (const char *p = name; *p; p++, length++) {
+        if (length >= HELPER_FILE_NAME_MAX) return FALSE;
+        // Epochs put a ':' in the version
+        if (!g_ascii_isalnum(*p) && !strchr("@._+-:", *p)) return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean helper_argument_valid(HelperOperation op, const char *argument) {
+    if (op == HELPER_OP_PRUNE_CACHE) return helper_cache_file_name_valid(argument);
+    return helper_package_name_valid(argument);
+}
+
+gboolean helper_write_all(int fd, const char *data, gsize length) {
+    while (length > 0) {
+        // A socket whose reader is gone fails with EPIPE instead of
+        // raising SIGPIPE
+        ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+        if (written < 0 && errno == ENOTSOCK) written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return FALSE;
+
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return FALSE;
+            continue;
+        }
+        data += written;
+        length -= written;
+    }
+    return TRUE;
+}
@@ -0,0 +1,50 @@
+#ifndef HELPER_PROTOCOL_H
+#define HELPER_PROTOCOL_H
+
+#include <glib.h>
+
+// Line protocol between pacman-gui and pacman-gui-helper, spoken over the
+// helper's stdin and stdout, which are one end of a socketpair owned by the
+// GUI. Fields are separated by tabs, messages by '\n'.
+//
+// Requests, run one at a time in the order received:
+//     <id> TAB <operation> [TAB <argument>]...
+// Events:
+//     0 TAB READY TAB <version>                  Once, after authorization
+//     <id> TAB LINE TAB <p|f> TAB <text>         Output; p marks a provisional
+//                                                line, such as a progress bar
+//                                                frame, that the next replaces
+//     <id> TAB DONE TAB <exit status>            Last event of a request
+//
+// The helper runs as root, so it accepts nothing but the operations below,
+// package names that pacman itself would accept and names of package files
+// directly inside its cache directory, and never involves a shell.
+
+#define HELPER_PROTOCOL_VERSION 2
+
+typedef enum {
+    HELPER_OP_INSTALL,          // pacman -S
+    HELPER_OP_REMOVE,           // pacman -R
+    HELPER_OP_UPGRADE,          // pacman -Syu
+    HELPER_OP_CLEAN_CACHE,      // pacman -Sc
+    HELPER_OP_CLEAN_ALL_CACHE,  // pacman -Scc
+    HELPER_OP_PRUNE_CACHE,      // Delete the named files from the package cache
+    HELPER_OP_COUNT
+} HelperOperation;
+
+const char* helper_operation_name(HelperOperation op);
+gboolean helper_operation_parse(const char *name, HelperOperation *op);
+// Install and remove name their packages, prune its cache files; the
+// others take no arguments
+gboolean helper_operation_takes_arguments(HelperOperation op);
+// Letters, digits and @._+- not starting with '-' or '.'
+gboolean helper_package_name_valid(const char *name);
+// A package archive or signature name, "<name>-<version>-<arch>.pkg.tar*":
+// letters, digits and @._+-: with no path separator
+gboolean helper_cache_file_name_valid(const char *name);
+// Whether argument is acceptable for op
+gboolean helper_argument_valid(HelperOperation op, const char *argument);
+// Writes everything, waiting out EAGAIN on non-blocking descriptors
+gboolean helper_write_all(int fd, const char *data, gsize length);
+
+#endif
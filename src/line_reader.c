@@ -0,0 +1,162 @@
+#include "line_reader.h"
+#include <glib-unix.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// Four times the default pipe capacity, so a full pipe drains in one read
+#define LINE_READER_BUFFER_SIZE (256 * 1024)
+// Bytes taken per wakeup before yielding back to the main loop
+#define LINE_READER_MAX_PER_WAKEUP (1024 * 1024)
+
+struct LineReader {
+    int fd;
+    guint source_id;
+    OutputLinesCallback on_lines;
+    LineReaderDoneCallback on_done;
+    gpointer user_data;
+
+    char *buffer;
+    gsize size;
+    gsize length;           // Bytes held
+    gsize line_start;       // Start of the line being assembled
+    gsize scan;             // Where splitting resumes
+    GArray *lines;          // Batch of OutputLine pointing into buffer
+};
+
+static void add_line(LineReader *reader, gsize start, gsize end, gboolean provisional) {
+    // A redraw with nothing on it carries no information
+    if (provisional && end == start) return;
+
+    reader->buffer[end] = '\0';
+    OutputLine line = { reader->buffer + start, end - start, provisional };
+
+    // Whatever follows a provisional line replaces it
+    if (reader->lines->len > 0 &&
+        g_array_index(reader->lines, OutputLine, reader->lines->len - 1).provisional) {
+        g_array_index(reader->lines, OutputLine, reader->lines->len - 1) = line;
+    } else {
+        g_array_append_val(reader->lines, line);
+    }
+}
+
+// Terminators are overwritten with NULs so each line is a C string in place
+static void split_lines(LineReader *reader, gboolean at_eof) {
+    char *buffer = reader->buffer;
+    gsize end = reader->length;
+    gsize i = reader->scan;
+
+    for (; i < end; i++) {
+        if (buffer[i] == '\n') {
+            add_line(reader, reader->line_start, i, FALSE);
+            reader->line_start = i + 1;
+        } else if (buffer[i] == '\r') {
+            // "\r\n" is a plain line end; wait to see which one this is
+            if (i + 1 == end && !at_eof) break;
+            if (i + 1 < end && buffer[i + 1] == '\n') {
+                add_line(reader, reader->line_start, i, FALSE);
+                i++;
+            } else {
+                add_line(reader, reader->line_start, i, TRUE);
+            }
+            reader->line_start = i + 1;
+        }
+    }
+    reader->scan = i;
+}
+
+static void deliver_lines(LineReader *reader) {
+    if (reader->lines->len == 0) return;
+
+    if (reader->on_lines) {
+        reader->on_lines((const OutputLine*)reader->lines->data, reader->lines->len, reader->user_data);
+    }
+    g_array_set_size(reader->lines, 0);
+}
+
+// Only called with no lines pending, since they point into the buffer
+static void compact_buffer(LineReader *reader) {
+    gsize tail = reader->length - reader->line_start;
+    if (reader->line_start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->line_start, tail);
+        reader->scan -= reader->line_start;
+        reader->length = tail;
+        reader->line_start = 0;
+    }
+
+    // A single line longer than the buffer
+    if (reader->size - reader->length < LINE_READER_BUFFER_SIZE / 4) {
+        reader->size *= 2;
+        reader->buffer = g_realloc(reader->buffer, reader->size);
+    }
+}
+
+static gboolean on_readable(gint fd, GIOCondition condition, gpointer user_data) {
+    LineReader *reader = (LineReader*)user_data;
+    gboolean at_eof = FALSE;
+    gsize taken = 0;
+
+    while (taken < LINE_READER_MAX_PER_WAKEUP) {
+        // One byte stays free for the NUL after a final unterminated line
+        if (reader->size - reader->length - 1 < LINE_READER_BUFFER_SIZE / 4) {
+            deliver_lines(reader);
+            compact_buffer(reader);
+        }
+
+        ssize_t n = read(reader->fd, reader->buffer + reader->length, reader->size - reader->length - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            at_eof = TRUE;
+            break;
+        }
+
+        reader->length += n;
+        taken += n;
+        split_lines(reader, FALSE);
+    }
+
+    if (at_eof) {
+        split_lines(reader, TRUE);
+        if (reader->line_start < reader->length) {
+            add_line(reader, reader->line_start, reader->length, FALSE);
+            reader->line_start = reader->length;
+        }
+    }
+
+    deliver_lines(reader);
+    compact_buffer(reader);
+
+    if (at_eof) {
+        reader->source_id = 0;
+        reader->on_done(reader->user_data);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+LineReader* line_reader_new(int fd, OutputLinesCallback on_lines, LineReaderDoneCallback on_done,
+                            gpointer user_data) {
+    LineReader *reader = g_malloc0(sizeof(LineReader));
+    reader->fd = fd;
+    reader->on_lines = on_lines;
+    reader->on_done = on_done;
+    reader->user_data = user_data;
+    reader->size = LINE_READER_BUFFER_SIZE;
+    reader->buffer = g_malloc(reader->size);
+    reader->lines = g_array_new(FALSE, FALSE, sizeof(OutputLine));
+
+    g_unix_set_fd_nonblocking(fd, TRUE, NULL);
+    reader->source_id = g_unix_fd_add(fd, G_IO_IN | G_IO_HUP | G_IO_ERR, on_readable, reader);
+
+    return reader;
+}
+
+void line_reader_free(LineReader *reader) {
+    if (!reader) return;
+
+    if (reader->source_id) g_source_remove(reader->source_id);
+    g_free(reader->buffer);
+    g_array_free(reader->lines, TRUE);
+    g_free(reader);
+}
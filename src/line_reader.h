@@ -0,0 +1,32 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <glib.h>
+
+// Reads line-oriented output from a pipe on the main loop. Each wakeup
+// drains the pipe with large read() calls into one reusable buffer and
+// splits it in place, so lines are neither copied nor allocated, and hands
+// over everything it read as one batch. Progress bars redraw their line
+// with '\r'; such an update arrives as a provisional line that the next
+// line replaces, and updates superseded within one wakeup are skipped.
+
+typedef struct {
+    const char *text;       // NUL-terminated, without its terminator
+    gsize length;
+    gboolean provisional;   // Ended by '\r'; the next line replaces it
+} OutputLine;
+
+// lines are only valid during the call
+typedef void (*OutputLinesCallback)(const OutputLine *lines, int count, gpointer user_data);
+// Called once, after the last lines, at end of file or on a read error.
+// The reader may be freed from here.
+typedef void (*LineReaderDoneCallback)(gpointer user_data);
+
+typedef struct LineReader LineReader;
+
+// fd is made non-blocking but stays owned by the caller
+LineReader* line_reader_new(int fd, OutputLinesCallback on_lines, LineReaderDoneCallback on_done,
+                            gpointer user_data);
+void line_reader_free(LineReader *reader);
+
+#endif
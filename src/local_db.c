@@ -0,0 +1,234 @@
+#include "local_db.h"
+#include "db_desc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Entries handed to a single worker at minimum; tiny chunks cost more in
+// thread-pool bookkeeping than they save in parallelism.
+#define LOCAL_DB_MIN_CHUNK 64
+
+typedef struct {
+    int dir_fd;
+    char **entries;
+    Package *packages;
+    DbDescRelations *relations;     // Parallel to packages, or NULL
+    Arena *arena;           // Per-chunk, since arenas are not thread-safe
+    int start;
+    int end;
+} LocalDbChunk;
+
+static char* read_desc_file(int dir_fd, const char *entry) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/desc", entry);
+
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *buffer = malloc(st.st_size + 1);
+    size_t total = 0;
+    while (total < (size_t)st.st_size) {
+        ssize_t n = read(fd, buffer + total, st.st_size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += n;
+    }
+    close(fd);
+
+    buffer[total] = '\0';
+    return buffer;
+}
+
+static void parse_chunk(gpointer data, gpointer user_data) {
+    LocalDbChunk *chunk = (LocalDbChunk*)data;
+
+    for (int i = chunk->start; i < chunk->end; i++) {
+        Package *pkg = &chunk->packages[i];
+        DbDescRelations *relations = chunk->relations ? &chunk->relations[i] : NULL;
+        memset(pkg, 0, sizeof(Package));
+        if (relations) memset(relations, 0, sizeof(DbDescRelations));
+
+        char *buffer = read_desc_file(chunk->dir_fd, chunk->entries[i]);
+        if (!buffer) continue;
+
+        db_desc_parse(buffer, pkg, relations, chunk->arena);
+        free(buffer);
+    }
+
+    g_free(chunk);
+}
+
+static GPtrArray* list_entries(int dir_fd) {
+    int fd = dup(dir_fd);
+    if (fd < 0) return NULL;
+
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return NULL;
+    }
+
+    GPtrArray *entries = g_ptr_array_new();
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') continue;
+        if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+        g_ptr_array_add(entries, strdup(entry->d_name));
+    }
+
+    closedir(dir);
+    return entries;
+}
+
+static int compare_package_names(const void *a, const void *b) {
+    return strcmp(((const Package*)a)->name, ((const Package*)b)->name);
+}
+
+typedef struct {
+    Package package;
+    DbDescRelations relations;
+} PackageWithRelations;
+
+static int compare_entry_names(const void *a, const void *b) {
+    return compare_package_names(&((const PackageWithRelations*)a)->package,
+                                 &((const PackageWithRelations*)b)->package);
+}
+
+// Sorts packages by name and keeps relations in step
+static void sort_with_relations(Package *packages, DbDescRelations *relations, int count) {
+    PackageWithRelations *entries = g_new(PackageWithRelations, MAX(count, 1));
+    for (int i = 0; i < count; i++) {
+        entries[i].package = packages[i];
+        entries[i].relations = relations[i];
+    }
+
+    qsort(entries, count, sizeof(PackageWithRelations), compare_entry_names);
+
+    for (int i = 0; i < count; i++) {
+        packages[i] = entries[i].package;
+        relations[i] = entries[i].relations;
+    }
+    g_free(entries);
+}
+
+PackageList* local_db_read(const char *local_dir) {
+    return local_db_read_with_relations(local_dir, NULL);
+}
+
+// Parses the desc files of entries (directory names under dir_fd)
+static PackageList* read_entries(int dir_fd, GPtrArray *entries, DbDescRelations **relations_out) {
+    int count = entries->len;
+    PackageList *list = package_list_new(count);
+    Package *packages = list->packages;
+    DbDescRelations *relations = relations_out ? g_new(DbDescRelations, MAX(count, 1)) : NULL;
+    GPtrArray *arenas = g_ptr_array_new();
+
+    int n_threads = g_get_num_processors();
+    int chunk_size = MAX(LOCAL_DB_MIN_CHUNK, (count + n_threads * 4 - 1) / (n_threads * 4));
+
+    GThreadPool *pool = NULL;
+    if (count > chunk_size) {
+        pool = g_thread_pool_new(parse_chunk, NULL, n_threads, FALSE, NULL);
+    }
+
+    for (int start = 0; start < count; start += chunk_size) {
+        LocalDbChunk *chunk = g_malloc(sizeof(LocalDbChunk));
+        chunk->dir_fd = dir_fd;
+        chunk->entries = (char**)entries->pdata;
+        chunk->packages = packages;
+        chunk->relations = relations;
+        chunk->arena = arena_new();
+        g_ptr_array_add(arenas, chunk->arena);
+        chunk->start = start;
+        chunk->end = MIN(start + chunk_size, count);
+
+        if (pool) {
+            g_thread_pool_push(pool, chunk, NULL);
+        } else {
+            parse_chunk(chunk, NULL);
+        }
+    }
+
+    // Wait for every queued chunk to finish
+    if (pool) {
+        g_thread_pool_free(pool, FALSE, TRUE);
+    }
+
+    for (guint i = 0; i < arenas->len; i++) {
+        arena_adopt(list->arena, g_ptr_array_index(arenas, i));
+    }
+    g_ptr_array_free(arenas, TRUE);
+
+    // Compact valid entries and fill in the fields pacman -Q implies
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        Package *pkg = &packages[i];
+        // Strings of skipped entries stay in the arena until the list is freed
+        if (!pkg->name || !pkg->version) continue;
+
+        if (!pkg->description) {
+            pkg->description = arena_intern(list->arena, "No description available");
+        }
+        pkg->repository = arena_intern(list->arena, "local");
+        pkg->installed = TRUE;
+
+        if (relations) relations[valid] = relations[i];
+        packages[valid++] = *pkg;
+    }
+
+    if (relations) {
+        sort_with_relations(packages, relations, valid);
+        *relations_out = relations;
+    } else {
+        qsort(packages, valid, sizeof(Package), compare_package_names);
+    }
+
+    list->count = valid;
+    return list;
+}
+
+PackageList* local_db_read_with_relations(const char *local_dir, DbDescRelations **relations_out) {
+    int dir_fd = open(local_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NULL;
+
+    GPtrArray *entries = list_entries(dir_fd);
+    if (!entries) {
+        close(dir_fd);
+        return NULL;
+    }
+
+    PackageList *list = read_entries(dir_fd, entries, relations_out);
+
+    for (guint i = 0; i < entries->len; i++) {
+        free(g_ptr_array_index(entries, i));
+    }
+    g_ptr_array_free(entries, TRUE);
+    close(dir_fd);
+    return list;
+}
+
+PackageList* local_db_read_entries(const char *local_dir, const char *const *entries, int count) {
+    int dir_fd = open(local_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NULL;
+
+    GPtrArray *names = g_ptr_array_sized_new(count);
+    for (int i = 0; i < count; i++) g_ptr_array_add(names, (gpointer)entries[i]);
+
+    PackageList *list = read_entries(dir_fd, names, NULL);
+
+    g_ptr_array_free(names, TRUE);
+    close(dir_fd);
+    return list;
+}
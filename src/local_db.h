@@ -0,0 +1,19 @@
+#ifndef LOCAL_DB_H
+#define LOCAL_DB_H
+
+#include "pacman_wrapper.h"
+#include "db_desc.h"
+
+// Reads every <local_dir>/<pkg>/desc entry of the pacman local database
+// in-process, parsing entries in parallel. Returns NULL if the directory
+// cannot be opened. Packages are sorted by name, like `pacman -Q`.
+PackageList* local_db_read(const char *local_dir);
+// Same, and also stores a g_malloc'd array with the relations of each
+// package (in list order) in *relations. Their strings live in the list's
+// arena.
+PackageList* local_db_read_with_relations(const char *local_dir, DbDescRelations **relations);
+// Reads only the named entries, e.g. "bash-5.2.037-1"; missing or
+// unreadable ones are left out
+PackageList* local_db_read_entries(const char *local_dir, const char *const *entries, int count);
+
+#endif
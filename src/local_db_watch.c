@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include "local_db_watch.h"
+#include "local_db.h"
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+
+// Quiet period after the last event before the entries are compared; pacman
+// touches many of them in a burst
+#define SETTLE_DELAY_MS 150
+// A lock held this long with the entries untouched may have been left by a
+// pacman that crashed; pending changes are then compared anyway
+#define STALE_LOCK_SECONDS 30
+
+typedef struct {
+    LocalDbWatcher *watcher;    // NULL once the watcher has been freed
+    char *local_dir;
+    GHashTable *previous;       // Entry -> desc mtime; NULL for the first pass
+    GHashTable *current;
+    LocalDbChanges *changes;
+} SyncJob;
+
+struct LocalDbWatcher {
+    char *local_dir;
+    char *lock_path;
+    LocalDbChangesCallback callback;
+    gpointer user_data;
+
+    GFileMonitor *local_monitor;
+    GFileMonitor *lock_monitor;
+    GHashTable *snapshot;       // Entry directory name -> gint64 desc mtime (ns)
+    SyncJob *job;               // Comparison in flight
+    gboolean locked;            // db.lck exists: a transaction is running
+    gboolean dirty;             // Something changed since the last comparison
+    guint settle_source;
+    guint lock_source;          // Stale lock check, while locked
+    gint64 last_event;          // Monotonic time of the last entry event
+};
+
+static GHashTable* new_snapshot(void) {
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+// Every "<name>-<version>-<rel>" entry with a desc file, and when that was
+// last written. Entries pacman is still filling in have no desc yet.
+static GHashTable* read_snapshot(const char *local_dir) {
+    int dir_fd = open(local_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NULL;
+
+    int list_fd = fcntl(dir_fd, F_DUPFD_CLOEXEC, 0);
+    DIR *dir = list_fd >= 0 ? fdopendir(list_fd) : NULL;
+    if (!dir) {
+        if (list_fd >= 0) close(list_fd);
+        close(dir_fd);
+        return NULL;
+    }
+
+    GHashTable *snapshot = new_snapshot();
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') continue;
+        if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/desc", entry->d_name);
+        struct statx info;
+        if (statx(dir_fd, path, AT_STATX_DONT_SYNC, STATX_MTIME, &info) != 0) continue;
+
+        gint64 *mtime = g_new(gint64, 1);
+        *mtime = (gint64)info.stx_mtime.tv_sec * 1000000000 + info.stx_mtime.tv_nsec;
+        g_hash_table_insert(snapshot, g_strdup(entry->d_name), mtime);
+    }
+
+    closedir(dir);
+    close(dir_fd);
+    return snapshot;
+}
+
+// "<name>-<pkgver>-<pkgrel>" -> "<name>"
+static char* entry_package_name(const char *entry) {
+    const char *end = strrchr(entry, '-');
+    if (end) {
+        while (end > entry && *(end - 1) != '-') end--;
+        if (end > entry) end--;
+    }
+    return end && end > entry ? g_strndup(entry, end - entry) : g_strdup(entry);
+}
+
+static void compare_snapshots(SyncJob *job) {
+    LocalDbChanges *changes = g_malloc0(sizeof(LocalDbChanges));
+    changes->removed = g_ptr_array_new_with_free_func(g_free);
+    GPtrArray *stale = g_ptr_array_new();
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, job->current);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const gint64 *before = g_hash_table_lookup(job->previous, key);
+        if (!before || *before != *(const gint64*)value) g_ptr_array_add(stale, key);
+    }
+
+    g_hash_table_iter_init(&iter, job->previous);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        if (!g_hash_table_contains(job->current, key)) {
+            g_ptr_array_add(changes->removed, entry_package_name(key));
+        }
+    }
+
+    if (stale->len > 0) {
+        changes->changed = local_db_read_entries(job->local_dir, (const char *const *)stale->pdata, stale->len);
+    }
+    g_ptr_array_free(stale, TRUE);
+
+    if (changes->removed->len == 0 && (!changes->changed || changes->changed->count == 0)) {
+        local_db_changes_free(changes);
+        return;
+    }
+    job->changes = changes;
+}
+
+static void schedule_sync(LocalDbWatcher *watcher);
+
+static gboolean finish_sync(gpointer data) {
+    SyncJob *job = (SyncJob*)data;
+    LocalDbWatcher *watcher = job->watcher;
+
+    if (watcher) {
+        watcher->job = NULL;
+        // An unreadable directory keeps the last known state
+        if (job->current) {
+            watcher->snapshot = job->current;
+            job->current = NULL;
+        } else {
+            watcher->snapshot = job->previous ? job->previous : new_snapshot();
+            job->previous = NULL;
+        }
+
+        if (job->changes) {
+            LocalDbChanges *changes = job->changes;
+            job->changes = NULL;
+            watcher->callback(changes, watcher->user_data);
+        }
+        if (watcher->dirty) schedule_sync(watcher);
+    }
+
+    if (job->previous) g_hash_table_destroy(job->previous);
+    if (job->current) g_hash_table_destroy(job->current);
+    local_db_changes_free(job->changes);
+    g_free(job->local_dir);
+    g_free(job);
+    return FALSE;
+}
+
+static gpointer sync_thread(gpointer data) {
+    SyncJob *job = (SyncJob*)data;
+
+    job->current = read_snapshot(job->local_dir);
+    if (job->current && job->previous) compare_snapshots(job);
+
+    g_idle_add(finish_sync, job);
+    return NULL;
+}
+
+static void start_sync(LocalDbWatcher *watcher) {
+    SyncJob *job = g_malloc0(sizeof(SyncJob));
+    job->watcher = watcher;
+    job->local_dir = g_strdup(watcher->local_dir);
+    // The snapshot belongs to the job until it finishes
+    job->previous = watcher->snapshot;
+    watcher->snapshot = NULL;
+    watcher->job = job;
+    watcher->dirty = FALSE;
+
+    GThread *thread = g_thread_new("local_db_sync", sync_thread, job);
+    g_thread_unref(thread);
+}
+
+static gboolean on_settled(gpointer user_data) {
+    LocalDbWatcher *watcher = (LocalDbWatcher*)user_data;
+    watcher->settle_source = 0;
+
+    if (!watcher->locked && !watcher->job) start_sync(watcher);
+    return FALSE;
+}
+
+static void schedule_sync(LocalDbWatcher *watcher) {
+    watcher->dirty = TRUE;
+    // Picked up once the transaction or the running comparison ends
+    if (watcher->locked || watcher->job) return;
+
+    // Every new event restarts the quiet period
+    if (watcher->settle_source) g_source_remove(watcher->settle_source);
+    watcher->settle_source = g_timeout_add(SETTLE_DELAY_MS, on_settled, watcher);
+}
+
+static void on_local_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                 GFileMonitorEvent event, gpointer user_data) {
+    LocalDbWatcher *watcher = (LocalDbWatcher*)user_data;
+    watcher->last_event = g_get_monotonic_time();
+    schedule_sync(watcher);
+}
+
+static void set_unlocked(LocalDbWatcher *watcher) {
+    watcher->locked = FALSE;
+    if (watcher->lock_source) {
+        g_source_remove(watcher->lock_source);
+        watcher->lock_source = 0;
+    }
+}
+
+static gboolean on_lock_check(gpointer user_data) {
+    LocalDbWatcher *watcher = (LocalDbWatcher*)user_data;
+
+    // The removal may have gone unnoticed
+    if (!g_file_test(watcher->lock_path, G_FILE_TEST_EXISTS)) {
+        watcher->lock_source = 0;
+        watcher->locked = FALSE;
+        schedule_sync(watcher);
+        return G_SOURCE_REMOVE;
+    }
+
+    gint64 quiet = g_get_monotonic_time() - watcher->last_event;
+    if (watcher->dirty && !watcher->job && quiet >= (gint64)STALE_LOCK_SECONDS * G_USEC_PER_SEC) {
+        start_sync(watcher);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void set_locked(LocalDbWatcher *watcher) {
+    watcher->locked = TRUE;
+    if (!watcher->lock_source) {
+        watcher->lock_source = g_timeout_add_seconds(STALE_LOCK_SECONDS, on_lock_check, watcher);
+    }
+}
+
+static void on_db_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                              GFileMonitorEvent event, gpointer user_data) {
+    LocalDbWatcher *watcher = (LocalDbWatcher*)user_data;
+
+    char *basename = g_file_get_basename(file);
+    gboolean is_lock = g_strcmp0(basename, "db.lck") == 0;
+    g_free(basename);
+    if (!is_lock) return;
+
+    if (event == G_FILE_MONITOR_EVENT_CREATED || event == G_FILE_MONITOR_EVENT_MOVED_IN) {
+        // A transaction started; wait for all of it
+        set_locked(watcher);
+        if (watcher->settle_source) {
+            g_source_remove(watcher->settle_source);
+            watcher->settle_source = 0;
+        }
+    } else if (event == G_FILE_MONITOR_EVENT_DELETED || event == G_FILE_MONITOR_EVENT_MOVED_OUT) {
+        // Always compare: rewriting the desc of an entry, as pacman -D does,
+        // raises no event in the local directory itself
+        set_unlocked(watcher);
+        schedule_sync(watcher);
+    }
+}
+
+static GFileMonitor* watch_dir(const char *path, GCallback callback, LocalDbWatcher *watcher) {
+    GFile *dir = g_file_new_for_path(path);
+    GFileMonitor *monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    g_object_unref(dir);
+
+    if (monitor) g_signal_connect(monitor, "changed", callback, watcher);
+    return monitor;
+}
+
+LocalDbWatcher* local_db_watcher_new(const char *db_path, LocalDbChangesCallback callback, gpointer user_data) {
+    LocalDbWatcher *watcher = g_malloc0(sizeof(LocalDbWatcher));
+    watcher->local_dir = g_build_filename(db_path, "local", NULL);
+    watcher->callback = callback;
+    watcher->user_data = user_data;
+
+    watcher->lock_path = g_build_filename(db_path, "db.lck", NULL);
+    watcher->last_event = g_get_monotonic_time();
+    if (g_file_test(watcher->lock_path, G_FILE_TEST_EXISTS)) set_locked(watcher);
+
+    watcher->local_monitor = watch_dir(watcher->local_dir, G_CALLBACK(on_local_dir_changed), watcher);
+    watcher->lock_monitor = watch_dir(db_path, G_CALLBACK(on_db_dir_changed), watcher);
+
+    // The first pass only records the baseline
+    start_sync(watcher);
+    return watcher;
+}
+
+static void free_monitor(GFileMonitor *monitor, LocalDbWatcher *watcher) {
+    if (!monitor) return;
+    g_signal_handlers_disconnect_by_data(monitor, watcher);
+    g_file_monitor_cancel(monitor);
+    g_object_unref(monitor);
+}
+
+void local_db_watcher_free(LocalDbWatcher *watcher) {
+    if (!watcher) return;
+
+    // A running comparison finishes on its own and then drops its results
+    if (watcher->job) watcher->job->watcher = NULL;
+    if (watcher->settle_source) g_source_remove(watcher->settle_source);
+    if (watcher->lock_source) g_source_remove(watcher->lock_source);
+    free_monitor(watcher->local_monitor, watcher);
+    free_monitor(watcher->lock_monitor, watcher);
+    if (watcher->snapshot) g_hash_table_destroy(watcher->snapshot);
+    g_free(watcher->local_dir);
+    g_free(watcher->lock_path);
+    g_free(watcher);
+}
+
+void local_db_changes_free(LocalDbChanges *changes) {
+    if (!changes) return;
+
+    g_ptr_array_free(changes->removed, TRUE);
+    package_list_free(changes->changed);
+    g_free(changes);
+}
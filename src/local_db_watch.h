@@ -0,0 +1,29 @@
+#ifndef LOCAL_DB_WATCH_H
+#define LOCAL_DB_WATCH_H
+
+#include "pacman_wrapper.h"
+
+// Watches <dbpath>/local for packages being installed, removed or changed,
+// by the GUI or by a pacman run elsewhere. While pacman holds <dbpath>/db.lck
+// a transaction is under way and nothing is reported; once the lock goes,
+// the entries' desc files are compared with the previous state on a worker
+// thread and only the packages that differ are read. A lock that stays while
+// the entries are quiet for 30 seconds, as one left behind by a crashed
+// pacman does, no longer holds back changes.
+
+typedef struct {
+    GPtrArray *removed;         // char*, names of packages no longer installed
+    PackageList *changed;       // Installed or changed packages, sorted by name
+} LocalDbChanges;
+
+// Owns changes; release them with local_db_changes_free. Runs on the main loop.
+typedef void (*LocalDbChangesCallback)(LocalDbChanges *changes, gpointer user_data);
+
+typedef struct LocalDbWatcher LocalDbWatcher;
+
+// Records the current state right away and reports changes from then on
+LocalDbWatcher* local_db_watcher_new(const char *db_path, LocalDbChangesCallback callback, gpointer user_data);
+void local_db_watcher_free(LocalDbWatcher *watcher);
+void local_db_changes_free(LocalDbChanges *changes);
+
+#endif
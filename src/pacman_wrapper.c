@@ -1,21 +1,48 @@
+#define _GNU_SOURCE
 #include "pacman_wrapper.h"
+#include "local_db.h"
+#include "sync_db.h"
+#include "catalog_cache.h"
+#include "aur_rpc.h"
+#include "dep_graph.h"
+#include "vercmp.h"
+#include "helper_client.h"
+#include "subprocess.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
-#include <sys/wait.h>
+
+// Installed location of pacman-gui-helper, set by the build
+#ifndef PACMAN_GUI_HELPER_PATH
+#define PACMAN_GUI_HELPER_PATH "/usr/lib/pacman-gui/pacman-gui-helper"
+#endif
 
 static AURHelper current_aur_helper = AUR_HELPER_NONE;
+static char *db_path = NULL;
+static char *cache_dir = NULL;
+static HelperClient *privileged_helper = NULL;
+static gboolean privileged_helper_checked = FALSE;
+
+// Give up on a search command that hangs, e.g. an AUR helper waiting on
+// the network
+#define SEARCH_COMMAND_TIMEOUT_MS 60000
 
 typedef struct {
     LogCallback callback;
+    OperationDoneCallback done;
     gpointer user_data;
-    int pipe_fd;
-    GIOChannel *channel;
-    guint watch_id;
-    pid_t child_pid;
+    Subprocess *process;
+    LineReader *reader;
 } AsyncOperation;
 
+typedef struct {
+    LogCallback callback;
+    OperationDoneCallback done;
+    gpointer user_data;
+} PrivilegedOperation;
+
 typedef struct {
     PackageListCallback callback;
     gpointer user_data;
@@ -27,10 +54,17 @@ typedef struct {
     gpointer user_data;
 } PackageLoadResult;
 
+static gboolean program_in_path(const char *program) {
+    char *path = g_find_program_in_path(program);
+    gboolean found = path != NULL;
+    g_free(path);
+    return found;
+}
+
 AURHelper detect_aur_helper(void) {
-    if (system("which yay > /dev/null 2>&1") == 0) {
+    if (program_in_path("yay")) {
         return AUR_HELPER_YAY;
-    } else if (system("which paru > /dev/null 2>&1") == 0) {
+    } else if (program_in_path("paru")) {
         return AUR_HELPER_PARU;
     }
     return AUR_HELPER_NONE;
@@ -40,276 +74,602 @@ void set_aur_helper(AURHelper helper) {
     current_aur_helper = helper;
 }
 
-static char* run_command(const char *cmd) {
-    FILE *fp = popen(cmd, "r");
-    if (!fp) return NULL;
+static char* configured_path(const char *variable, const char *fallback) {
+    const char *env_path = g_getenv(variable);
+    return strdup(env_path && *env_path ? env_path : fallback);
+}
 
-    char *output = malloc(4096);
-    char *result = malloc(1);
-    result[0] = '\0';
+void pacman_set_db_path(const char *path) {
+    free(db_path);
+    db_path = path ? strdup(path) : configured_path("PACMAN_GUI_DBPATH", "/var/lib/pacman");
+}
 
-    while (fgets(output, 4096, fp)) {
-        result = realloc(result, strlen(result) + strlen(output) + 1);
-        strcat(result, output);
+// The database path is read on worker threads (installed package loads,
+// the local dependency graph), so both defaults are filled in exactly once
+const char* pacman_get_cache_dir(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        cache_dir = configured_path("PACMAN_GUI_CACHEDIR", "/var/cache/pacman/pkg");
+        g_once_init_leave(&initialized, 1);
     }
+    return cache_dir;
+}
 
-    pclose(fp);
-    free(output);
-    return result;
+const char* pacman_get_db_path(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        if (!db_path) db_path = configured_path("PACMAN_GUI_DBPATH", "/var/lib/pacman");
+        g_once_init_leave(&initialized, 1);
+    }
+    return db_path;
 }
 
-static gboolean read_pipe_data(GIOChannel *channel, GIOCondition condition, gpointer user_data) {
-    AsyncOperation *op = (AsyncOperation*)user_data;
+// Output of argv, whatever its exit status; NULL if it could not be run.
+// Callers release the result with free().
+static char* run_command(const char *const *argv) {
+    SubprocessResult result;
+    subprocess_run(argv, SUBPROCESS_DEFAULT, 0, NULL, &result);
+    return result.output;
+}
 
-    if (condition & G_IO_IN) {
-        gchar *line;
-        gsize length;
-        GError *error = NULL;
+// Like run_command, but returns NULL once timeout_ms (0: none) has passed
+// or cancellable is triggered, killing the command's whole process group,
+// so helpers it spawns (yay runs pacman and curl) go with it
+static char* run_command_cancellable(const char *const *argv, guint timeout_ms, GCancellable *cancellable) {
+    SubprocessResult result;
+    subprocess_run(argv, SUBPROCESS_OWN_GROUP, timeout_ms, cancellable, &result);
 
-        GIOStatus status = g_io_channel_read_line(channel, &line, &length, NULL, &error);
+    if (result.status == SUBPROCESS_CANCELLED || result.status == SUBPROCESS_TIMED_OUT) {
+        subprocess_result_clear(&result);
+        return NULL;
+    }
+    return result.output;
+}
 
-        if (status == G_IO_STATUS_NORMAL) {
-            if (length > 0 && line[length-1] == '\n') {
-                line[length-1] = '\0';
-            }
+static void finish_operation(LogCallback callback, OperationDoneCallback done, gpointer user_data,
+                             gboolean success) {
+    if (callback) {
+        const char *summary = success
+            ? "=== Operation completed successfully ==="
+            : "=== Operation failed ===";
+        // Special operation end marker last, unless a done callback takes
+        // its place
+        OutputLine lines[2] = {
+            { summary, strlen(summary), FALSE },
+            { "__OPERATION_FINISHED__", strlen("__OPERATION_FINISHED__"), FALSE }
+        };
+        callback(lines, done ? 1 : 2, user_data);
+    }
+    if (done) done(success, user_data);
+}
 
-            if (op->callback) {
-                op->callback(line, op->user_data);
-            }
+static void on_operation_lines(const OutputLine *lines, int count, gpointer user_data) {
+    AsyncOperation *op = (AsyncOperation*)user_data;
+    if (op->callback) op->callback(lines, count, op->user_data);
+}
 
-            g_free(line);
-            return TRUE;
-        }
-    }
+static void on_operation_done(gpointer user_data) {
+    AsyncOperation *op = (AsyncOperation*)user_data;
 
-    if (condition & (G_IO_HUP | G_IO_ERR)) {
-        // Pipe closed - check child process status
-        int status;
-        waitpid(op->child_pid, &status, 0);
+    // Pipe closed - check child process status
+    SubprocessResult result;
+    subprocess_wait(op->process, &result);
+    finish_operation(op->callback, op->done, op->user_data, subprocess_result_succeeded(&result));
 
-        // Send operation completion signal
-        if (op->callback) {
-            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-                op->callback("=== Operation completed successfully ===", op->user_data);
-            } else {
-                op->callback("=== Operation failed ===", op->user_data);
-            }
+    line_reader_free(op->reader);
+    subprocess_free(op->process);
+    g_free(op);
+}
 
-            // Special operation end marker
-            op->callback("__OPERATION_FINISHED__", op->user_data);
-        }
+static gboolean run_command_async(const char *const *argv, LogCallback callback, OperationDoneCallback done,
+                                  gpointer user_data) {
+    Subprocess *process = subprocess_spawn(argv, SUBPROCESS_MERGE_STDERR);
+    if (!process) return FALSE;
 
-        g_io_channel_unref(channel);
-        close(op->pipe_fd);
-        g_free(op);
-        return FALSE;
-    }
+    AsyncOperation *op = g_malloc(sizeof(AsyncOperation));
+    op->callback = callback;
+    op->done = done;
+    op->user_data = user_data;
+    op->process = process;
+    op->reader = line_reader_new(subprocess_get_fd(process), on_operation_lines, on_operation_done, op);
 
     return TRUE;
 }
 
-static gboolean run_command_async(const char *cmd, LogCallback callback, gpointer user_data) {
-    int pipefd[2];
-    pid_t pid;
+// prefix followed by the package names, as one argv; g_strfreev() it
+static char** package_argv(const char *const *prefix, const char *const *names, int count) {
+    GPtrArray *argv = g_ptr_array_new();
+    for (; *prefix; prefix++) g_ptr_array_add(argv, g_strdup(*prefix));
+    for (int i = 0; i < count; i++) g_ptr_array_add(argv, g_strdup(names[i]));
+    g_ptr_array_add(argv, NULL);
+    return (char**)g_ptr_array_free(argv, FALSE);
+}
+
+// Privileged commands used when no helper is installed. Options end with
+// "--", so no package name can be taken for one.
+static const char *const PKEXEC_INSTALL_ARGV[] = { "pkexec", "pacman", "-S", "--noconfirm", "--", NULL };
+static const char *const PKEXEC_REMOVE_ARGV[] = { "pkexec", "pacman", "-R", "--noconfirm", "--", NULL };
+static const char *const PKEXEC_UPGRADE_ARGV[] = { "pkexec", "pacman", "-Syu", "--noconfirm", NULL };
+static const char *const PKEXEC_CLEAN_CACHE_ARGV[] = { "pkexec", "pacman", "-Sc", "--noconfirm", NULL };
+static const char *const PKEXEC_CLEAN_ALL_CACHE_ARGV[] = { "pkexec", "pacman", "-Scc", "--noconfirm", NULL };
+static const char *const PKEXEC_REMOVE_FILES_ARGV[] = { "pkexec", "rm", "-fv", "--", NULL };
+
+// The helper command: PACMAN_GUI_HELPER, run as given so a helper in
+// --simulate mode can be used without root, or the installed helper through
+// pkexec. NULL if neither is available.
+static char** privileged_helper_command(void) {
+    const char *override = g_getenv("PACMAN_GUI_HELPER");
+    if (override && *override) {
+        char **argv = NULL;
+        GError *error = NULL;
+        if (g_shell_parse_argv(override, NULL, &argv, &error)) return argv;
+        g_warning("Ignoring PACMAN_GUI_HELPER: %s", error->message);
+        g_error_free(error);
+    }
 
-    if (pipe(pipefd) == -1) {
-        return FALSE;
+    if (!g_file_test(PACMAN_GUI_HELPER_PATH, G_FILE_TEST_IS_EXECUTABLE)) return NULL;
+
+    char **argv = g_new0(char*, 3);
+    argv[0] = g_strdup("pkexec");
+    argv[1] = g_strdup(PACMAN_GUI_HELPER_PATH);
+    return argv;
+}
+
+static void on_privileged_lines(const OutputLine *lines, int count, gpointer user_data) {
+    PrivilegedOperation *op = (PrivilegedOperation*)user_data;
+    if (op->callback) op->callback(lines, count, op->user_data);
+}
+
+static void on_privileged_done(gboolean success, gpointer user_data) {
+    PrivilegedOperation *op = (PrivilegedOperation*)user_data;
+    finish_operation(op->callback, op->done, op->user_data, success);
+    g_free(op);
+}
+
+// The session's helper, started on first use; NULL if none is installed
+// or the installed one belongs to another release
+static HelperClient* get_privileged_helper(void) {
+    if (!privileged_helper_checked) {
+        privileged_helper_checked = TRUE;
+        char **argv = privileged_helper_command();
+        if (argv) privileged_helper = helper_client_new(argv);
+        g_strfreev(argv);
+    }
+    if (privileged_helper && helper_client_is_incompatible(privileged_helper)) return NULL;
+    return privileged_helper;
+}
+
+// Runs a pacman operation as root: through the session's helper if there
+// is one, otherwise through a pkexec of its own (fallback_argv followed by
+// the names)
+static gboolean run_privileged_async(HelperOperation operation, const char *const *fallback_argv,
+                                     const char *const *names, int count, LogCallback callback,
+                                     OperationDoneCallback done, gpointer user_data) {
+    if (helper_operation_takes_arguments(operation) && count <= 0) return FALSE;
+
+    if (!get_privileged_helper()) {
+        char **argv = package_argv(fallback_argv, names, count);
+        gboolean started = run_command_async((const char *const *)argv, callback, done, user_data);
+        g_strfreev(argv);
+        return started;
     }
 
-    pid = fork();
-    if (pid == -1) {
-        close(pipefd[0]);
-        close(pipefd[1]);
+    PrivilegedOperation *op = g_malloc(sizeof(PrivilegedOperation));
+    op->callback = callback;
+    op->done = done;
+    op->user_data = user_data;
+    if (!helper_client_submit(privileged_helper, operation, names, count,
+                              on_privileged_lines, on_privileged_done, op)) {
+        g_free(op);
         return FALSE;
     }
+    return TRUE;
+}
 
-    if (pid == 0) {
-        // Child process
-        close(pipefd[0]);
-        dup2(pipefd[1], STDOUT_FILENO);
-        dup2(pipefd[1], STDERR_FILENO);
-        close(pipefd[1]);
+// Incremental parser for `pacman -Ss` style output: "repo/name version
+// [flags]" followed by an indented description line. Input may be split
+// anywhere; a package is emitted once its description line is complete.
+typedef struct {
+    GString *partial;       // Trailing line without its newline yet
+    GString *header;        // Header line waiting for its description
+    gboolean have_header;
+    PackageList *batch;     // Packages completed since the last take
+} SearchOutputParser;
+
+static void search_parser_init(SearchOutputParser *parser) {
+    parser->partial = g_string_new(NULL);
+    parser->header = g_string_new(NULL);
+    parser->have_header = FALSE;
+    parser->batch = NULL;
+}
 
-        execl("/bin/sh", "sh", "-c", cmd, NULL);
-        exit(1);
-    } else {
-        // Parent process
-        close(pipefd[1]);
+static void search_parser_clear(SearchOutputParser *parser) {
+    g_string_free(parser->partial, TRUE);
+    g_string_free(parser->header, TRUE);
+    package_list_free(parser->batch);
+}
 
-        AsyncOperation *op = g_malloc(sizeof(AsyncOperation));
-        op->callback = callback;
-        op->user_data = user_data;
-        op->pipe_fd = pipefd[0];
-        op->child_pid = pid;
+static void search_parser_emit(SearchOutputParser *parser, const char *description) {
+    parser->have_header = FALSE;
+
+    char *line = parser->header->str;
+    char *slash = strchr(line, '/');
+    char *space = slash ? strchr(slash, ' ') : NULL;
+    if (!space) return;
+
+    if (!parser->batch) parser->batch = package_list_new(64);
+    PackageList *list = parser->batch;
+    Package *pkg = package_list_append(list);
+
+    // Flags after the version: pacman prints "[installed]" or
+    // "[installed: <version>]", yay "(Installed)" and paru "[Installed]"
+    char *flags = strchr(space + 1, ' ');
+    pkg->installed = flags && strcasestr(flags, "installed") != NULL;
+
+    *slash = '\0';
+    pkg->repository = arena_intern(list->arena, line);
+    pkg->name = arena_strndup(list->arena, slash + 1, space - slash - 1);
+    pkg->version = flags ? arena_strndup(list->arena, space + 1, flags - space - 1)
+                         : arena_strdup(list->arena, space + 1);
+    pkg->description = *description ? arena_strdup(list->arena, description) : arena_intern(list->arena, "");
+}
 
-        op->channel = g_io_channel_unix_new(pipefd[0]);
-        g_io_channel_set_flags(op->channel, G_IO_FLAG_NONBLOCK, NULL);
+static void search_parser_line(SearchOutputParser *parser, char *line) {
+    if (line[0] == ' ') {
+        if (parser->have_header) search_parser_emit(parser, g_strchug(line));
+        return;
+    }
 
-        op->watch_id = g_io_add_watch(op->channel,
-                                      G_IO_IN | G_IO_HUP | G_IO_ERR,
-                                      read_pipe_data, op);
+    // A header without a description line is still a package
+    if (parser->have_header) search_parser_emit(parser, "");
 
-        return TRUE;
+    if (strchr(line, '/')) {
+        g_string_assign(parser->header, line);
+        parser->have_header = TRUE;
     }
 }
 
-PackageList* pacman_search(const char *query) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "pacman -Ss %s", query);
+static void search_parser_feed(SearchOutputParser *parser, const char *data, gsize length) {
+    g_string_append_len(parser->partial, data, length);
 
-    char *output = run_command(cmd);
-    if (!output) return NULL;
+    char *start = parser->partial->str;
+    char *newline;
+    while ((newline = memchr(start, '\n', parser->partial->str + parser->partial->len - start))) {
+        *newline = '\0';
+        search_parser_line(parser, start);
+        start = newline + 1;
+    }
 
-    PackageList *list = malloc(sizeof(PackageList));
-    list->packages = malloc(sizeof(Package) * 100);
-    list->count = 0;
+    g_string_erase(parser->partial, 0, start - parser->partial->str);
+}
 
-    char *line = strtok(output, "\n");
-    while (line && list->count < 100) {
-        if (strstr(line, "/")) {
-            Package *pkg = &list->packages[list->count];
+static void search_parser_finish(SearchOutputParser *parser) {
+    if (parser->partial->len > 0) {
+        search_parser_line(parser, parser->partial->str);
+        g_string_truncate(parser->partial, 0);
+    }
+    if (parser->have_header) search_parser_emit(parser, "");
+}
 
-            char *slash = strchr(line, '/');
-            char *space = strchr(slash, ' ');
+// Returns the packages completed so far, or NULL if there are none
+static PackageList* search_parser_take_batch(SearchOutputParser *parser) {
+    PackageList *batch = parser->batch;
+    parser->batch = NULL;
+    return batch;
+}
 
-            pkg->repository = strndup(line, slash - line);
-            pkg->name = strndup(slash + 1, space - slash - 1);
-            pkg->version = strdup(space + 1);
+static PackageList* parse_search_output(const char *output) {
+    SearchOutputParser parser;
+    search_parser_init(&parser);
+    search_parser_feed(&parser, output, strlen(output));
+    search_parser_finish(&parser);
 
-            line = strtok(NULL, "\n");
-            if (line && line[0] == ' ') {
-                pkg->description = strdup(line + 4);
-            }
+    PackageList *list = search_parser_take_batch(&parser);
+    search_parser_clear(&parser);
+    return list ? list : package_list_new(0);
+}
 
-            pkg->installed = FALSE;
-            list->count++;
-        }
-        line = strtok(NULL, "\n");
+// "<command> -Ss -- <words>"; g_strfreev() it. Each word of the query is
+// its own regex, and a package has to match all of them, as the local
+// search index and the AUR RPC search do.
+static char** search_argv(const char *command, const char *query) {
+    GPtrArray *argv = g_ptr_array_new();
+    g_ptr_array_add(argv, g_strdup(command));
+    g_ptr_array_add(argv, g_strdup("-Ss"));
+    g_ptr_array_add(argv, g_strdup("--"));
+
+    char **words = g_strsplit_set(query, " \t", -1);
+    for (char **word = words; *word; word++) {
+        if (**word) g_ptr_array_add(argv, g_strdup(*word));
     }
+    g_strfreev(words);
 
-    free(output);
-    return list;
+    g_ptr_array_add(argv, NULL);
+    return (char**)g_ptr_array_free(argv, FALSE);
 }
 
-PackageList* aur_search(const char *query) {
+static char** pacman_search_argv(const char *query) {
+    return search_argv("pacman", query);
+}
+
+// NULL when no AUR helper is available
+static char** aur_search_argv(const char *query) {
     if (current_aur_helper == AUR_HELPER_NONE) {
         current_aur_helper = detect_aur_helper();
     }
 
-    char cmd[512];
+    const char *helper;
     if (current_aur_helper == AUR_HELPER_YAY) {
-        snprintf(cmd, sizeof(cmd), "yay -Ss %s", query);
+        helper = "yay";
     } else if (current_aur_helper == AUR_HELPER_PARU) {
-        snprintf(cmd, sizeof(cmd), "paru -Ss %s", query);
+        helper = "paru";
     } else {
-        return NULL; // No AUR helper available
+        return NULL;
     }
 
-    char *output = run_command(cmd);
+    return search_argv(helper, query);
+}
+
+static PackageList* run_search_command(char **argv, GCancellable *cancellable) {
+    if (!argv) return NULL;
+
+    char *output = run_command_cancellable((const char *const *)argv, SEARCH_COMMAND_TIMEOUT_MS, cancellable);
+    g_strfreev(argv);
     if (!output) return NULL;
 
-    PackageList *list = malloc(sizeof(PackageList));
-    list->packages = malloc(sizeof(Package) * 100);
-    list->count = 0;
+    PackageList *list = parse_search_output(output);
 
-    char *line = strtok(output, "\n");
-    while (line && list->count < 100) {
-        if (strstr(line, "/")) {
-            Package *pkg = &list->packages[list->count];
+    free(output);
+    return list;
+}
 
-            char *slash = strchr(line, '/');
-            char *space = strchr(slash, ' ');
+static void mark_installed_from_list(PackageList *list, const PackageList *installed) {
+    GHashTable *names = g_hash_table_new(g_str_hash, g_str_equal);
+    for (int i = 0; i < installed->count; i++) {
+        g_hash_table_add(names, installed->packages[i].name);
+    }
 
-            pkg->repository = strndup(line, slash - line);
-            pkg->name = strndup(slash + 1, space - slash - 1);
-            pkg->version = strdup(space + 1);
+    for (int i = 0; i < list->count; i++) {
+        list->packages[i].installed = g_hash_table_contains(names, list->packages[i].name);
+    }
 
-            line = strtok(NULL, "\n");
-            if (line && line[0] == ' ') {
-                pkg->description = strdup(line + 4);
-            }
+    g_hash_table_destroy(names);
+}
+
+// Sets the installed flag the way `pacman -Ss` reports it. Lookups go to the
+// catalog's installed-name set; only the first search reads the local
+// database to build it.
+static void mark_installed_packages(PackageList *list) {
+    if (sync_catalog_mark_installed(list)) return;
+
+    guint generation = sync_catalog_installed_generation();
+    PackageList *installed = pacman_list_installed();
+    if (!installed) return;
+
+    // Packages changed while reading; the next search builds the set again
+    if (!sync_catalog_set_installed(installed, generation) || !sync_catalog_mark_installed(list)) {
+        mark_installed_from_list(list, installed);
+    }
+    package_list_free(installed);
+}
+
+PackageList* pacman_search(const char *query, GCancellable *cancellable) {
+    // Serve from the in-memory catalog once the sync databases are loaded
+    if (sync_catalog_is_ready()) {
+        PackageList *list = sync_catalog_search(query);
+        mark_installed_packages(list);
+        return list;
+    }
 
-            pkg->installed = FALSE;
-            list->count++;
+    return run_search_command(pacman_search_argv(query), cancellable);
+}
+
+PackageList* aur_search(const char *query, GCancellable *cancellable) {
+    PackageList *list = aur_rpc_search(query, cancellable);
+    if (list) {
+        mark_installed_packages(list);
+        return list;
+    }
+
+    // The AUR could not be reached; an installed helper may still manage
+    if (g_cancellable_is_cancelled(cancellable)) return NULL;
+    return run_search_command(aur_search_argv(query), cancellable);
+}
+
+// Upper bound on output consumed per wakeup, so one burst from the helper
+// cannot hold up a frame
+#define SEARCH_STREAM_READ_BUDGET (256 * 1024)
+
+typedef struct {
+    PackageBatchCallback callback;
+    gpointer user_data;
+    SearchOutputParser parser;
+    Subprocess *process;
+    GIOChannel *channel;
+    GCancellable *cancellable;
+    gulong cancel_id;
+} SearchStream;
+
+static void on_search_stream_cancelled(GCancellable *cancellable, gpointer user_data) {
+    SearchStream *stream = (SearchStream*)user_data;
+
+    // The pipe then hangs up and read_search_stream finishes normally
+    subprocess_terminate(stream->process);
+}
+
+static gboolean read_search_stream(GIOChannel *channel, GIOCondition condition, gpointer user_data) {
+    SearchStream *stream = (SearchStream*)user_data;
+
+    // Same watch as run_command_async, but drain whatever is available
+    // instead of one line per wakeup
+    char buffer[16384];
+    gsize budget = SEARCH_STREAM_READ_BUDGET;
+    gboolean finished = FALSE;
+
+    while (budget > 0) {
+        ssize_t n = read(subprocess_get_fd(stream->process), buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) break;
+        if (n <= 0) {
+            finished = TRUE;
+            break;
         }
-        line = strtok(NULL, "\n");
+
+        search_parser_feed(&stream->parser, buffer, n);
+        budget -= MIN((gsize)n, budget);
     }
 
-    free(output);
-    return list;
+    if (!finished) {
+        PackageList *batch = search_parser_take_batch(&stream->parser);
+        if (batch) stream->callback(batch, FALSE, stream->user_data);
+        return TRUE;
+    }
+
+    search_parser_finish(&stream->parser);
+    subprocess_wait(stream->process, NULL);
+
+    if (stream->cancellable) {
+        g_cancellable_disconnect(stream->cancellable, stream->cancel_id);
+        g_object_unref(stream->cancellable);
+    }
+
+    stream->callback(search_parser_take_batch(&stream->parser), TRUE, stream->user_data);
+
+    search_parser_clear(&stream->parser);
+    g_io_channel_unref(channel);
+    subprocess_free(stream->process);
+    g_free(stream);
+    return FALSE;
 }
 
-gboolean pacman_install_async(const char *package_name, LogCallback callback, gpointer user_data) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "pkexec pacman -S --noconfirm %s", package_name);
+static gboolean run_search_stream(char **argv, GCancellable *cancellable,
+                                  PackageBatchCallback callback, gpointer user_data) {
+    if (!argv) return FALSE;
+
+    // Own group, so a cancelled AUR helper takes pacman and curl with it
+    Subprocess *process = subprocess_spawn((const char *const *)argv, SUBPROCESS_OWN_GROUP);
+    g_strfreev(argv);
+    if (!process) return FALSE;
+
+    SearchStream *stream = g_malloc(sizeof(SearchStream));
+    stream->callback = callback;
+    stream->user_data = user_data;
+    search_parser_init(&stream->parser);
+    stream->process = process;
+    stream->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+    stream->cancel_id = 0;
+
+    stream->channel = g_io_channel_unix_new(subprocess_get_fd(process));
+    g_io_channel_set_flags(stream->channel, G_IO_FLAG_NONBLOCK, NULL);
+    g_io_add_watch(stream->channel, G_IO_IN | G_IO_HUP | G_IO_ERR, read_search_stream, stream);
+
+    if (cancellable) {
+        stream->cancel_id = g_cancellable_connect(cancellable, G_CALLBACK(on_search_stream_cancelled),
+                                                  stream, NULL);
+    }
 
-    return run_command_async(cmd, callback, user_data);
+    return TRUE;
 }
 
-gboolean aur_install_async(const char *package_name, LogCallback callback, gpointer user_data) {
+gboolean pacman_search_stream(const char *query, GCancellable *cancellable,
+                              PackageBatchCallback callback, gpointer user_data) {
+    return run_search_stream(pacman_search_argv(query), cancellable, callback, user_data);
+}
+
+static gboolean run_package_command(const char *const *prefix, const char *const *names, int count,
+                                    LogCallback callback, OperationDoneCallback done, gpointer user_data) {
+    if (count <= 0) return FALSE;
+
+    char **argv = package_argv(prefix, names, count);
+    gboolean started = run_command_async((const char *const *)argv, callback, done, user_data);
+    g_strfreev(argv);
+    return started;
+}
+
+gboolean pacman_install_packages_async(const char *const *names, int count, LogCallback callback,
+                                       OperationDoneCallback done, gpointer user_data) {
+    return run_privileged_async(HELPER_OP_INSTALL, PKEXEC_INSTALL_ARGV, names, count,
+                                callback, done, user_data);
+}
+
+gboolean aur_install_packages_async(const char *const *names, int count, LogCallback callback,
+                                    OperationDoneCallback done, gpointer user_data) {
     if (current_aur_helper == AUR_HELPER_NONE) {
         current_aur_helper = detect_aur_helper();
     }
 
-    char cmd[512];
+    // Options end with "--", as for pacman, so no name can be taken for one
+    static const char *const yay_argv[] = { "yay", "-S", "--noconfirm", "--", NULL };
+    static const char *const paru_argv[] = { "paru", "-S", "--noconfirm", "--", NULL };
+
     if (current_aur_helper == AUR_HELPER_YAY) {
-        snprintf(cmd, sizeof(cmd), "yay -S --noconfirm %s", package_name);
+        return run_package_command(yay_argv, names, count, callback, done, user_data);
     } else if (current_aur_helper == AUR_HELPER_PARU) {
-        snprintf(cmd, sizeof(cmd), "paru -S --noconfirm %s", package_name);
-    } else {
-        return FALSE;
+        return run_package_command(paru_argv, names, count, callback, done, user_data);
     }
+    return FALSE;
+}
 
-    return run_command_async(cmd, callback, user_data);
+gboolean pacman_remove_packages_async(const char *const *names, int count, LogCallback callback,
+                                      OperationDoneCallback done, gpointer user_data) {
+    return run_privileged_async(HELPER_OP_REMOVE, PKEXEC_REMOVE_ARGV, names, count,
+                                callback, done, user_data);
 }
 
-gboolean pacman_remove_async(const char *package_name, LogCallback callback, gpointer user_data) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "pkexec pacman -R --noconfirm %s", package_name);
+gboolean pacman_install_async(const char *package_name, LogCallback callback, gpointer user_data) {
+    return pacman_install_packages_async(&package_name, 1, callback, NULL, user_data);
+}
 
-    return run_command_async(cmd, callback, user_data);
+gboolean aur_install_async(const char *package_name, LogCallback callback, gpointer user_data) {
+    return aur_install_packages_async(&package_name, 1, callback, NULL, user_data);
+}
+
+gboolean pacman_remove_async(const char *package_name, LogCallback callback, gpointer user_data) {
+    return pacman_remove_packages_async(&package_name, 1, callback, NULL, user_data);
 }
 
 gboolean pacman_update_system_async(LogCallback callback, gpointer user_data) {
-    return run_command_async("pkexec pacman -Syu --noconfirm", callback, user_data);
+    return run_privileged_async(HELPER_OP_UPGRADE, PKEXEC_UPGRADE_ARGV, NULL, 0,
+                                callback, NULL, user_data);
 }
 
 PackageList* pacman_list_installed(void) {
-    char *output = run_command("pacman -Q");
+    char *local_dir = g_build_filename(pacman_get_db_path(), "local", NULL);
+    PackageList *list = catalog_cache_load_local(local_dir);
+    if (!list) {
+        // Stamp first, so a change made while reading invalidates the snapshot
+        gint64 stamp = catalog_cache_file_stamp(local_dir);
+        list = local_db_read(local_dir);
+        if (list) catalog_cache_save_local(local_dir, stamp, list);
+    }
+    g_free(local_dir);
+    return list;
+}
+
+PackageList* pacman_list_installed_cached(void) {
+    char *local_dir = g_build_filename(pacman_get_db_path(), "local", NULL);
+    PackageList *list = catalog_cache_load_local(local_dir);
+    g_free(local_dir);
+    return list;
+}
+
+PackageList* pacman_list_updates(void) {
+    static const char *const argv[] = { "pacman", "-Qu", NULL };
+    char *output = run_command(argv);
     if (!output) return NULL;
 
-    PackageList *list = malloc(sizeof(PackageList));
-    list->packages = malloc(sizeof(Package) * 1000);
-    list->count = 0;
+    PackageList *list = package_list_new(64);
 
     char *line = strtok(output, "\n");
-    while (line && list->count < 1000) {
+    while (line) {
         char *space = strchr(line, ' ');
         if (space) {
-            Package *pkg = &list->packages[list->count];
-            pkg->name = strndup(line, space - line);
-            pkg->version = strdup(space + 1);
-            pkg->repository = strdup("local");
-            
-            // Get detailed package info including description
-            char info_cmd[256];
-            snprintf(info_cmd, sizeof(info_cmd), "pacman -Qi %s 2>/dev/null | grep 'Description' | cut -d ':' -f2-", pkg->name);
-            char *desc_output = run_command(info_cmd);
-            if (desc_output && strlen(desc_output) > 1) {
-                // Remove leading whitespace and newline
-                char *desc_start = desc_output;
-                while (*desc_start == ' ' || *desc_start == '\t') desc_start++;
-                char *desc_end = strchr(desc_start, '\n');
-                if (desc_end) *desc_end = '\0';
-                pkg->description = strdup(desc_start);
-                free(desc_output);
-            } else {
-                pkg->description = strdup("No description available");
-                if (desc_output) free(desc_output);
-            }
-            
+            Package *pkg = package_list_append(list);
+            pkg->name = arena_strndup(list->arena, line, space - line);
+            pkg->version = arena_strdup(list->arena, space + 1);
+            pkg->repository = arena_intern(list->arena, "local");
+            pkg->description = arena_intern(list->arena, "Update available");
             pkg->installed = TRUE;
-            list->count++;
         }
         line = strtok(NULL, "\n");
     }
@@ -318,159 +678,321 @@ PackageList* pacman_list_installed(void) {
     return list;
 }
 
-PackageList* pacman_list_updates(void) {
-    char *output = run_command("pacman -Qu");
+// Installed packages that no sync database provides, i.e. AUR and local
+// builds; the Package pointers point into installed
+static GPtrArray* foreign_packages(PackageList *installed) {
+    GPtrArray *foreign = sync_catalog_foreign_packages(installed);
+    if (foreign) return foreign;
+
+    // The catalog is still loading, so ask pacman instead
+    static const char *const argv[] = { "pacman", "-Qmq", NULL };
+    char *output = run_command(argv);
     if (!output) return NULL;
 
-    PackageList *list = malloc(sizeof(PackageList));
-    list->packages = malloc(sizeof(Package) * 100);
-    list->count = 0;
+    GHashTable *names = g_hash_table_new(g_str_hash, g_str_equal);
+    for (char *line = strtok(output, "\n"); line; line = strtok(NULL, "\n")) {
+        g_hash_table_add(names, line);
+    }
 
-    char *line = strtok(output, "\n");
-    while (line && list->count < 100) {
-        char *space = strchr(line, ' ');
-        if (space) {
-            Package *pkg = &list->packages[list->count];
-            pkg->name = strndup(line, space - line);
-            pkg->version = strdup(space + 1);
-            pkg->repository = strdup("local");
-            pkg->description = strdup("Update available");
-            pkg->installed = TRUE;
-            list->count++;
+    foreign = g_ptr_array_new();
+    for (int i = 0; i < installed->count; i++) {
+        if (g_hash_table_contains(names, installed->packages[i].name)) {
+            g_ptr_array_add(foreign, &installed->packages[i]);
         }
-        line = strtok(NULL, "\n");
     }
 
+    g_hash_table_destroy(names);
     free(output);
+    return foreign;
+}
+
+PackageList* aur_list_updates(GCancellable *cancellable) {
+    PackageList *installed = pacman_list_installed();
+    if (!installed) return NULL;
+
+    GPtrArray *foreign = foreign_packages(installed);
+    if (!foreign) {
+        package_list_free(installed);
+        return NULL;
+    }
+
+    // All foreign packages are looked up in one batched info request rather
+    // than one helper call each
+    const char **names = g_new(const char*, MAX(foreign->len, 1));
+    GHashTable *local = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < foreign->len; i++) {
+        Package *pkg = g_ptr_array_index(foreign, i);
+        names[i] = pkg->name;
+        g_hash_table_insert(local, pkg->name, pkg);
+    }
+
+    PackageList *remote = aur_rpc_info(names, foreign->len, cancellable);
+    PackageList *list = NULL;
+
+    if (remote) {
+        list = package_list_new(16);
+        for (int i = 0; i < remote->count; i++) {
+            Package *available = &remote->packages[i];
+            Package *current = g_hash_table_lookup(local, available->name);
+            if (!current || vercmp(available->version, current->version) <= 0) continue;
+
+            // Same shape as pacman_list_updates: "old -> new"
+            char *version = g_strdup_printf("%s -> %s", current->version, available->version);
+            Package *pkg = package_list_append(list);
+            pkg->name = arena_strdup(list->arena, available->name);
+            pkg->version = arena_strdup(list->arena, version);
+            pkg->repository = arena_intern(list->arena, "aur");
+            pkg->description = arena_intern(list->arena, "Update available");
+            pkg->installed = TRUE;
+            g_free(version);
+        }
+        package_list_free(remote);
+    }
+
+    g_hash_table_destroy(local);
+    g_free(names);
+    g_ptr_array_free(foreign, TRUE);
+    package_list_free(installed);
+    return list;
+}
+
+PackageList* package_list_new(int capacity) {
+    PackageList *list = malloc(sizeof(PackageList));
+    list->capacity = MAX(capacity, 16);
+    list->packages = malloc(sizeof(Package) * list->capacity);
+    list->count = 0;
+    list->arena = arena_new();
+    list->backing = NULL;
+    list->backing_free = NULL;
     return list;
 }
 
+Package* package_list_append(PackageList *list) {
+    if (list->count == list->capacity) {
+        list->capacity *= 2;
+        list->packages = realloc(list->packages, sizeof(Package) * list->capacity);
+    }
+
+    Package *pkg = &list->packages[list->count++];
+    memset(pkg, 0, sizeof(Package));
+    return pkg;
+}
+
 void package_list_free(PackageList *list) {
     if (!list) return;
 
-    for (int i = 0; i < list->count; i++) {
-        free(list->packages[i].name);
-        free(list->packages[i].version);
-        free(list->packages[i].description);
-        free(list->packages[i].repository);
+    arena_free(list->arena);
+    if (list->backing && list->backing_free) {
+        list->backing_free(list->backing);
     }
 
     free(list->packages);
     free(list);
 }
 
-DependencyList* pacman_get_dependencies(const char *package_name) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "pacman -Qi %s 2>/dev/null | grep 'Depends On' | cut -d ':' -f2", package_name);
-    
-    char *output = run_command(cmd);
-    if (!output) return NULL;
-    
+// A view of the given node ids; the names are borrowed from graph
+static DependencyList* dependency_list_for_nodes(DepGraph *graph, const int *nodes, int count) {
     DependencyList *list = malloc(sizeof(DependencyList));
-    list->dependencies = malloc(sizeof(char*) * 50);
-    list->count = 0;
-    
-    char *token = strtok(output, " \t\n");
-    while (token && list->count < 50) {
-        if (strcmp(token, "None") != 0) {
-            char *dep_name = strdup(token);
-            char *version_pos = strchr(dep_name, '>');
-            if (!version_pos) version_pos = strchr(dep_name, '<');
-            if (!version_pos) version_pos = strchr(dep_name, '=');
-            if (version_pos) *version_pos = '\0';
-            
-            list->dependencies[list->count++] = dep_name;
-        }
-        token = strtok(NULL, " \t\n");
+    list->dependencies = malloc(sizeof(char*) * MAX(count, 1));
+    list->count = count;
+    list->graph = dep_graph_ref(graph);
+
+    for (int i = 0; i < count; i++) {
+        list->dependencies[i] = (char*)dep_graph_name(graph, nodes[i]);
     }
-    
-    free(output);
+    return list;
+}
+
+static DependencyList* dependency_list_for_node(DepGraph *graph, int node) {
+    int count;
+    const int *targets = dep_graph_depends(graph, node, &count);
+    return dependency_list_for_nodes(graph, targets, count);
+}
+
+static DependencyList* required_by_list_for_node(DepGraph *graph, int node) {
+    int count;
+    const int *sources = dep_graph_required_by(graph, node, &count);
+    return dependency_list_for_nodes(graph, sources, count);
+}
+
+DependencyList* pacman_get_dependencies(const char *package_name) {
+    DepGraph *graph = dep_graph_get_local();
+    if (!graph) return NULL;
+
+    int node = dep_graph_lookup(graph, package_name);
+    DependencyList *list = node >= 0 ? dependency_list_for_node(graph, node) : NULL;
+
+    dep_graph_unref(graph);
     return list;
 }
 
 DependencyList* pacman_get_required_by(const char *package_name) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "pacman -Qi %s 2>/dev/null | grep 'Required By' | cut -d ':' -f2", package_name);
-    
-    char *output = run_command(cmd);
-    if (!output) return NULL;
-    
-    DependencyList *list = malloc(sizeof(DependencyList));
-    list->dependencies = malloc(sizeof(char*) * 50);
-    list->count = 0;
-    
-    char *token = strtok(output, " \t\n");
-    while (token && list->count < 50) {
-        if (strcmp(token, "None") != 0) {
-            list->dependencies[list->count++] = strdup(token);
-        }
-        token = strtok(NULL, " \t\n");
-    }
-    
-    free(output);
+    DepGraph *graph = dep_graph_get_local();
+    if (!graph) return NULL;
+
+    int node = dep_graph_lookup(graph, package_name);
+    DependencyList *list = node >= 0 ? required_by_list_for_node(graph, node) : NULL;
+
+    dep_graph_unref(graph);
     return list;
 }
 
-static DependencyNode* find_or_create_node(DependencyTree *tree, const char *name, int depth) {
-    for (int i = 0; i < tree->count; i++) {
-        if (strcmp(tree->nodes[i].name, name) == 0) {
-            if (depth < tree->nodes[i].depth) {
-                tree->nodes[i].depth = depth;
-            }
-            return &tree->nodes[i];
-        }
+// Tree of the first count nodes of a breadth-first order
+static DependencyTree* dependency_tree_from_order(DepGraph *graph, GArray *order, GArray *depths, guint count) {
+    DependencyTree *tree = malloc(sizeof(DependencyTree));
+    tree->count = 0;
+    tree->capacity = count;
+    tree->nodes = malloc(sizeof(DependencyNode) * MAX(count, 1));
+    tree->graph = dep_graph_ref(graph);
+
+    for (guint i = 0; i < count; i++) {
+        int node = g_array_index(order, int, i);
+        DependencyNode *tree_node = &tree->nodes[tree->count++];
+        tree_node->name = (char*)dep_graph_name(graph, node);
+        tree_node->depends = dependency_list_for_node(graph, node);
+        tree_node->required_by = required_by_list_for_node(graph, node);
+        tree_node->depth = g_array_index(depths, int, i);
     }
-    
-    if (tree->count >= tree->capacity) {
-        tree->capacity *= 2;
-        tree->nodes = realloc(tree->nodes, sizeof(DependencyNode) * tree->capacity);
+    return tree;
+}
+
+DependencyTree* pacman_build_dependency_tree(const char *package_name, int max_depth) {
+    DepGraph *graph = dep_graph_get_local();
+    int root = graph ? dep_graph_lookup(graph, package_name) : -1;
+
+    if (root < 0) {
+        DependencyTree *tree = malloc(sizeof(DependencyTree));
+        tree->nodes = NULL;
+        tree->count = 0;
+        tree->capacity = 0;
+        tree->graph = graph;
+        return tree;
     }
-    
-    DependencyNode *node = &tree->nodes[tree->count++];
-    node->name = strdup(name);
-    node->depends = NULL;
-    node->required_by = NULL;
-    node->depth = depth;
-    
-    return node;
+
+    GArray *depths;
+    GArray *order = dep_graph_subtree(graph, root, max_depth, &depths);
+    DependencyTree *tree = dependency_tree_from_order(graph, order, depths, order->len);
+
+    g_array_free(order, TRUE);
+    g_array_free(depths, TRUE);
+    dep_graph_unref(graph);
+    return tree;
 }
 
-static void build_tree_recursive(DependencyTree *tree, const char *package_name, int current_depth, int max_depth) {
-    if (current_depth > max_depth) return;
-    
-    DependencyNode *node = find_or_create_node(tree, package_name, current_depth);
-    
-    if (!node->depends) {
-        node->depends = pacman_get_dependencies(package_name);
-        if (node->depends) {
-            for (int i = 0; i < node->depends->count; i++) {
-                build_tree_recursive(tree, node->depends->dependencies[i], current_depth + 1, max_depth);
+typedef struct {
+    char *package_name;
+    int max_depth;
+    GCancellable *cancellable;
+    DependencyTreeCallback callback;
+    gpointer user_data;
+} TreeBuildJob;
+
+typedef struct {
+    DependencyTree *tree;
+    int depth;
+    gboolean finished;
+    GCancellable *cancellable;
+    DependencyTreeCallback callback;
+    gpointer user_data;
+} TreeBuildUpdate;
+
+static gboolean deliver_tree_update(gpointer data) {
+    TreeBuildUpdate *update = (TreeBuildUpdate*)data;
+
+    if (g_cancellable_is_cancelled(update->cancellable)) {
+        dependency_tree_free(update->tree);
+    } else {
+        update->callback(update->tree, update->depth, update->finished, update->user_data);
+    }
+
+    if (update->cancellable) g_object_unref(update->cancellable);
+    g_free(update);
+    return FALSE;
+}
+
+static void publish_tree_update(TreeBuildJob *job, DependencyTree *tree, int depth, gboolean finished) {
+    TreeBuildUpdate *update = g_malloc0(sizeof(TreeBuildUpdate));
+    update->tree = tree;
+    update->depth = depth;
+    update->finished = finished;
+    update->cancellable = job->cancellable ? g_object_ref(job->cancellable) : NULL;
+    update->callback = job->callback;
+    update->user_data = job->user_data;
+    g_idle_add(deliver_tree_update, update);
+}
+
+// Same walk as dep_graph_subtree, one level at a time so every completed
+// level can be shown while the next one is expanded
+static gpointer build_tree_thread(gpointer data) {
+    TreeBuildJob *job = (TreeBuildJob*)data;
+    DepGraph *graph = dep_graph_get_local();
+    int root = graph ? dep_graph_lookup(graph, job->package_name) : -1;
+    int depth = 0;
+
+    if (root >= 0 && !g_cancellable_is_cancelled(job->cancellable)) {
+        GArray *order = g_array_new(FALSE, FALSE, sizeof(int));
+        GArray *depths = g_array_new(FALSE, FALSE, sizeof(int));
+        gboolean *visited = g_new0(gboolean, dep_graph_node_count(graph));
+
+        g_array_append_val(order, root);
+        g_array_append_val(depths, depth);
+        visited[root] = TRUE;
+        publish_tree_update(job, dependency_tree_from_order(graph, order, depths, order->len), depth, FALSE);
+
+        guint level_start = 0;
+        while (depth < job->max_depth && !g_cancellable_is_cancelled(job->cancellable)) {
+            guint level_end = order->len;
+            int child_depth = depth + 1;
+
+            for (guint head = level_start; head < level_end; head++) {
+                int count;
+                const int *targets = dep_graph_depends(graph, g_array_index(order, int, head), &count);
+                for (int i = 0; i < count; i++) {
+                    if (visited[targets[i]]) continue;
+                    visited[targets[i]] = TRUE;
+                    g_array_append_val(order, targets[i]);
+                    g_array_append_val(depths, child_depth);
+                }
             }
+
+            if (order->len == level_end || g_cancellable_is_cancelled(job->cancellable)) break;
+
+            depth = child_depth;
+            level_start = level_end;
+            publish_tree_update(job, dependency_tree_from_order(graph, order, depths, order->len), depth, FALSE);
         }
+
+        g_free(visited);
+        g_array_free(order, TRUE);
+        g_array_free(depths, TRUE);
     }
-    
-    if (!node->required_by) {
-        node->required_by = pacman_get_required_by(package_name);
-    }
+
+    publish_tree_update(job, NULL, depth, TRUE);
+
+    dep_graph_unref(graph);
+    if (job->cancellable) g_object_unref(job->cancellable);
+    free(job->package_name);
+    g_free(job);
+    return NULL;
 }
 
-DependencyTree* pacman_build_dependency_tree(const char *package_name, int max_depth) {
-    DependencyTree *tree = malloc(sizeof(DependencyTree));
-    tree->nodes = malloc(sizeof(DependencyNode) * 100);
-    tree->count = 0;
-    tree->capacity = 100;
-    
-    build_tree_recursive(tree, package_name, 0, max_depth);
-    
-    return tree;
+void pacman_build_dependency_tree_async(const char *package_name, int max_depth, GCancellable *cancellable,
+                                        DependencyTreeCallback callback, gpointer user_data) {
+    TreeBuildJob *job = g_malloc0(sizeof(TreeBuildJob));
+    job->package_name = strdup(package_name);
+    job->max_depth = max_depth;
+    job->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+    job->callback = callback;
+    job->user_data = user_data;
+
+    GThread *thread = g_thread_new("dependency_tree", build_tree_thread, job);
+    g_thread_unref(thread);
 }
 
 void dependency_list_free(DependencyList *list) {
     if (!list) return;
-    
-    for (int i = 0; i < list->count; i++) {
-        free(list->dependencies[i]);
-    }
+
+    dep_graph_unref(list->graph);
     free(list->dependencies);
     free(list);
 }
@@ -479,34 +1001,43 @@ void dependency_tree_free(DependencyTree *tree) {
     if (!tree) return;
     
     for (int i = 0; i < tree->count; i++) {
-        free(tree->nodes[i].name);
         dependency_list_free(tree->nodes[i].depends);
         dependency_list_free(tree->nodes[i].required_by);
     }
-    
+
     free(tree->nodes);
+    dep_graph_unref(tree->graph);
     free(tree);
 }
 
 gboolean pacman_clean_cache_async(LogCallback callback, gpointer user_data) {
-    return run_command_async("pkexec pacman -Sc --noconfirm", callback, user_data);
+    return run_privileged_async(HELPER_OP_CLEAN_CACHE, PKEXEC_CLEAN_CACHE_ARGV, NULL, 0,
+                                callback, NULL, user_data);
 }
 
 gboolean pacman_clean_all_cache_async(LogCallback callback, gpointer user_data) {
-    return run_command_async("pkexec pacman -Scc --noconfirm", callback, user_data);
+    return run_privileged_async(HELPER_OP_CLEAN_ALL_CACHE, PKEXEC_CLEAN_ALL_CACHE_ARGV, NULL, 0,
+                                callback, NULL, user_data);
 }
 
-char* pacman_get_cache_size(void) {
-    char *output = run_command("du -sh /var/cache/pacman/pkg 2>/dev/null | cut -f1");
-    if (!output || strlen(output) == 0) {
-        if (output) free(output);
-        return strdup("Unknown");
+gboolean pacman_prune_cache_async(const char *const *files, int count, LogCallback callback,
+                                  OperationDoneCallback done, gpointer user_data) {
+    if (count <= 0) return FALSE;
+    for (int i = 0; i < count; i++) {
+        if (!helper_cache_file_name_valid(files[i])) return FALSE;
     }
-    
-    char *newline = strchr(output, '\n');
-    if (newline) *newline = '\0';
-    
-    return output;
+
+    if (get_privileged_helper()) {
+        return run_privileged_async(HELPER_OP_PRUNE_CACHE, NULL, files, count, callback, done, user_data);
+    }
+
+    // rm needs full paths
+    char **paths = g_new0(char*, count + 1);
+    for (int i = 0; i < count; i++) paths[i] = g_build_filename(pacman_get_cache_dir(), files[i], NULL);
+    gboolean started = run_privileged_async(HELPER_OP_PRUNE_CACHE, PKEXEC_REMOVE_FILES_ARGV,
+                                            (const char *const *)paths, count, callback, done, user_data);
+    g_strfreev(paths);
+    return started;
 }
 
 static gboolean call_package_list_callback(gpointer data) {
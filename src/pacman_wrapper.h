@@ -2,6 +2,14 @@
 #define PACMAN_WRAPPER_H
 
 #include <glib.h>
+#include <gio/gio.h>
+#include "arena.h"
+#include "line_reader.h"
+
+typedef enum {
+    INSTALL_REASON_EXPLICIT,
+    INSTALL_REASON_DEPEND
+} InstallReason;
 
 typedef struct {
     char *name;
@@ -9,11 +17,22 @@ typedef struct {
     char *description;
     char *repository;
     gboolean installed;
+    guint64 installed_size;
+    gint64 install_date;
+    InstallReason reason;
 } Package;
 
+// Package strings live in the list's arena (or its backing block) and are
+// released with the list, never individually.
 typedef struct {
     Package *packages;
     int count;
+    int capacity;           // Grows on demand; there is no fixed limit
+    Arena *arena;
+    // Shared block the package strings point into (e.g. a mapped catalog
+    // snapshot), or NULL
+    gpointer backing;
+    GDestroyNotify backing_free;
 } PackageList;
 
 typedef enum {
@@ -22,48 +41,110 @@ typedef enum {
     AUR_HELPER_PARU
 } AURHelper;
 
-typedef void (*LogCallback)(const char *line, gpointer user_data);
+// Receives the output of an operation in batches, see OutputLine. The last
+// batch ends with a summary line and the "__OPERATION_FINISHED__" marker.
+typedef OutputLinesCallback LogCallback;
+// End of an operation started with a done callback, in place of the marker
+typedef void (*OperationDoneCallback)(gboolean success, gpointer user_data);
 typedef void (*PackageListCallback)(PackageList *list, gpointer user_data);
+// Receives ownership of batch. Called with finished set exactly once, last,
+// even after cancellation; that final batch may be NULL.
+typedef void (*PackageBatchCallback)(PackageList *batch, gboolean finished, gpointer user_data);
+
+struct DepGraph;
 
 typedef struct {
     char **dependencies;
     int count;
+    struct DepGraph *graph;     // Reference keeping the borrowed names alive
 } DependencyList;
 
 typedef struct {
-    char *name;
+    char *name;             // Borrowed from the tree's graph
     DependencyList *depends;
     DependencyList *required_by;
     int depth;
 } DependencyNode;
 
+// A view over the installed-package dependency graph, in breadth-first
+// order from the root
 typedef struct {
     DependencyNode *nodes;
     int count;
     int capacity;
+    struct DepGraph *graph;
 } DependencyTree;
 
-PackageList* pacman_search(const char *query);
-PackageList* aur_search(const char *query);
+// Receives ownership of tree, which holds every node up to depth edges from
+// the root. Unless the build is cancelled, called with finished set exactly
+// once, last; that final tree may be NULL, and no tree at all arrives if the
+// package is not installed. After cancellation nothing more is called, not
+// even the finished call, so user_data may be released once cancelled.
+typedef void (*DependencyTreeCallback)(DependencyTree *tree, int depth, gboolean finished, gpointer user_data);
+
+// Both return NULL on failure or once cancellable (may be NULL) is
+// cancelled, killing the search process. aur_search asks the AUR RPC
+// interface and only falls back to the AUR helper if it is unreachable.
+PackageList* pacman_search(const char *query, GCancellable *cancellable);
+PackageList* aur_search(const char *query, GCancellable *cancellable);
+// Streams the output of `pacman -Ss` on the main loop, delivering packages
+// in batches as their lines complete. Cancelling kills the search process;
+// the final callback still follows. Returns FALSE if the search could not be
+// started.
+gboolean pacman_search_stream(const char *query, GCancellable *cancellable,
+                              PackageBatchCallback callback, gpointer user_data);
 gboolean pacman_install_async(const char *package_name, LogCallback callback, gpointer user_data);
 gboolean pacman_remove_async(const char *package_name, LogCallback callback, gpointer user_data);
 gboolean aur_install_async(const char *package_name, LogCallback callback, gpointer user_data);
+// One transaction over all names: a single authorization prompt, database
+// lock and dependency resolution. done (may be NULL) is called at the end
+// instead of the "__OPERATION_FINISHED__" marker being logged.
+gboolean pacman_install_packages_async(const char *const *names, int count, LogCallback callback,
+                                       OperationDoneCallback done, gpointer user_data);
+gboolean aur_install_packages_async(const char *const *names, int count, LogCallback callback,
+                                    OperationDoneCallback done, gpointer user_data);
+gboolean pacman_remove_packages_async(const char *const *names, int count, LogCallback callback,
+                                      OperationDoneCallback done, gpointer user_data);
 PackageList* pacman_list_installed(void);
+// The installed packages from an up-to-date snapshot, which only needs to
+// be mapped; NULL if there is none and the database would have to be read
+PackageList* pacman_list_installed_cached(void);
 gboolean pacman_list_installed_async(PackageListCallback callback, gpointer user_data);
 PackageList* pacman_list_updates(void);
+// Foreign packages with a newer version in the AUR, checked with a single
+// batched RPC request. Blocks; NULL on failure or cancellation.
+PackageList* aur_list_updates(GCancellable *cancellable);
 gboolean pacman_update_system_async(LogCallback callback, gpointer user_data);
 gboolean pacman_clean_cache_async(LogCallback callback, gpointer user_data);
 gboolean pacman_clean_all_cache_async(LogCallback callback, gpointer user_data);
-char* pacman_get_cache_size(void);
+// Deletes the named package files (no directories) from the cache
+gboolean pacman_prune_cache_async(const char *const *files, int count, LogCallback callback,
+                                  OperationDoneCallback done, gpointer user_data);
 
+// capacity is only a hint
+PackageList* package_list_new(int capacity);
+// Appends a zeroed package, growing the list as needed
+Package* package_list_append(PackageList *list);
 void package_list_free(PackageList *list);
 char* pacman_get_package_info(const char *package_name);
 DependencyList* pacman_get_dependencies(const char *package_name);
 DependencyList* pacman_get_required_by(const char *package_name);
 DependencyTree* pacman_build_dependency_tree(const char *package_name, int max_depth);
+// Walks the tree on a worker thread and publishes it level by level on the
+// main loop. Once cancellable (may be NULL) is cancelled the walk stops and
+// no further callbacks are made, including the finished one.
+void pacman_build_dependency_tree_async(const char *package_name, int max_depth, GCancellable *cancellable,
+                                        DependencyTreeCallback callback, gpointer user_data);
 void dependency_list_free(DependencyList *list);
 void dependency_tree_free(DependencyTree *tree);
 AURHelper detect_aur_helper(void);
+// Root of the pacman database (defaults to /var/lib/pacman, or $PACMAN_GUI_DBPATH).
+// Set it, if at all, from the main thread before anything reads it; NULL
+// restores the default.
+void pacman_set_db_path(const char *path);
+const char* pacman_get_db_path(void);
+// Package cache directory (defaults to /var/cache/pacman/pkg, or $PACMAN_GUI_CACHEDIR)
+const char* pacman_get_cache_dir(void);
 void set_aur_helper(AURHelper helper);
 
 #endif
\ No newline at end of file
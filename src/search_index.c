@@ -0,0 +1,365 @@
+#define _GNU_SOURCE
+#include "search_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Postings are stored CSR-style: the packages containing keys[i] are
+// postings[offsets[i] .. offsets[i + 1]), in ascending order.
+struct SearchIndex {
+    guint32 *keys;
+    guint32 *offsets;
+    guint32 *postings;
+    guint n_keys;
+};
+
+typedef struct {
+    char *literal;      // Lowercase substring, NULL for regex terms
+    GRegex *regex;
+} SearchTerm;
+
+struct SearchQuery {
+    SearchTerm *terms;
+    int n_terms;
+    GArray *trigrams;   // Sorted, distinct trigrams every match must contain
+};
+
+typedef struct {
+    const guint32 *postings;
+    guint length;
+} PostingList;
+
+static guint32 trigram_key(const char *text) {
+    return ((guint32)(guchar)g_ascii_tolower(text[0]) << 16) |
+           ((guint32)(guchar)g_ascii_tolower(text[1]) << 8) |
+           (guint32)(guchar)g_ascii_tolower(text[2]);
+}
+
+static void add_trigrams(GArray *keys, const char *text, gsize length) {
+    for (gsize i = 0; i + 2 < length; i++) {
+        guint32 key = trigram_key(text + i);
+        g_array_append_val(keys, key);
+    }
+}
+
+static int compare_keys(const void *a, const void *b) {
+    guint32 key_a = *(const guint32*)a;
+    guint32 key_b = *(const guint32*)b;
+    return key_a < key_b ? -1 : key_a > key_b;
+}
+
+static void sort_unique(GArray *keys) {
+    if (keys->len == 0) return;
+
+    qsort(keys->data, keys->len, sizeof(guint32), compare_keys);
+
+    guint32 *data = (guint32*)keys->data;
+    guint unique = 1;
+    for (guint i = 1; i < keys->len; i++) {
+        if (data[i] != data[unique - 1]) {
+            data[unique++] = data[i];
+        }
+    }
+    g_array_set_size(keys, unique);
+}
+
+// LSD radix sort of (trigram << 32 | package) entries on the 24 trigram
+// bits. It is stable, so packages stay ascending within each trigram.
+static void radix_sort_entries(guint64 *entries, guint64 *scratch, gsize count) {
+    for (int shift = 32; shift < 56; shift += 8) {
+        gsize counts[257] = {0};
+
+        for (gsize i = 0; i < count; i++) {
+            counts[((entries[i] >> shift) & 0xff) + 1]++;
+        }
+        for (int bucket = 0; bucket < 256; bucket++) {
+            counts[bucket + 1] += counts[bucket];
+        }
+        for (gsize i = 0; i < count; i++) {
+            scratch[counts[(entries[i] >> shift) & 0xff]++] = entries[i];
+        }
+
+        memcpy(entries, scratch, count * sizeof(guint64));
+    }
+}
+
+SearchIndex* search_index_build(const PackageList *packages) {
+    GArray *entries = g_array_new(FALSE, FALSE, sizeof(guint64));
+    GArray *keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    for (int i = 0; i < packages->count; i++) {
+        const Package *pkg = &packages->packages[i];
+
+        g_array_set_size(keys, 0);
+        add_trigrams(keys, pkg->name, strlen(pkg->name));
+        if (pkg->description) {
+            add_trigrams(keys, pkg->description, strlen(pkg->description));
+        }
+        sort_unique(keys);
+
+        for (guint k = 0; k < keys->len; k++) {
+            guint64 entry = ((guint64)g_array_index(keys, guint32, k) << 32) | (guint32)i;
+            g_array_append_val(entries, entry);
+        }
+    }
+    g_array_free(keys, TRUE);
+
+    gsize count = entries->len;
+    guint64 *sorted = (guint64*)entries->data;
+    guint64 *scratch = g_malloc(sizeof(guint64) * MAX(count, 1));
+    radix_sort_entries(sorted, scratch, count);
+    g_free(scratch);
+
+    SearchIndex *index = g_malloc(sizeof(SearchIndex));
+    index->keys = g_malloc(sizeof(guint32) * MAX(count, 1));
+    index->offsets = g_malloc(sizeof(guint32) * (count + 1));
+    index->postings = g_malloc(sizeof(guint32) * MAX(count, 1));
+
+    guint n_keys = 0;
+    for (gsize i = 0; i < count; i++) {
+        guint32 key = (guint32)(sorted[i] >> 32);
+        if (n_keys == 0 || index->keys[n_keys - 1] != key) {
+            index->keys[n_keys] = key;
+            index->offsets[n_keys] = i;
+            n_keys++;
+        }
+        index->postings[i] = (guint32)sorted[i];
+    }
+    index->offsets[n_keys] = count;
+    index->n_keys = n_keys;
+
+    index->keys = g_renew(guint32, index->keys, MAX(n_keys, 1));
+    index->offsets = g_renew(guint32, index->offsets, n_keys + 1);
+
+    g_array_free(entries, TRUE);
+    return index;
+}
+
+void search_index_free(SearchIndex *index) {
+    if (!index) return;
+
+    g_free(index->keys);
+    g_free(index->offsets);
+    g_free(index->postings);
+    g_free(index);
+}
+
+static gboolean lookup_postings(const SearchIndex *index, guint32 key, PostingList *list) {
+    guint low = 0;
+    guint high = index->n_keys;
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        if (index->keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == index->n_keys || index->keys[low] != key) return FALSE;
+
+    list->postings = &index->postings[index->offsets[low]];
+    list->length = index->offsets[low + 1] - index->offsets[low];
+    return TRUE;
+}
+
+static void add_literal(GArray *trigrams, GString *literal) {
+    add_trigrams(trigrams, literal->str, literal->len);
+    g_string_truncate(literal, 0);
+}
+
+// Collects the literal runs every match of pattern must contain. This is
+// deliberately conservative: alternation disables prefiltering entirely and
+// anything inside groups or classes is ignored.
+static void add_regex_literals(GArray *trigrams, const char *pattern) {
+    if (strchr(pattern, '|')) return;
+
+    GString *literal = g_string_new(NULL);
+    int depth = 0;
+
+    for (const char *p = pattern; *p; p++) {
+        switch (*p) {
+        case '\\':
+            if (p[1] && !g_ascii_isalnum(p[1]) && depth == 0 && (guchar)p[1] < 0x80) {
+                g_string_append_c(literal, p[1]);
+            } else {
+                add_literal(trigrams, literal);
+            }
+            if (p[1]) p++;
+            break;
+        case '*':
+        case '?':
+        case '{':
+            // The preceding character is optional
+            if (literal->len > 0) g_string_truncate(literal, literal->len - 1);
+            add_literal(trigrams, literal);
+            if (*p == '{') {
+                while (*p && *p != '}') p++;
+                if (!*p) p--;
+            }
+            break;
+        case '[':
+            add_literal(trigrams, literal);
+            p++;
+            if (*p == '^') p++;
+            if (*p == ']') p++;
+            while (*p && *p != ']') p++;
+            if (!*p) p--;
+            break;
+        case '(':
+            depth++;
+            add_literal(trigrams, literal);
+            break;
+        case ')':
+            depth--;
+            add_literal(trigrams, literal);
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            add_literal(trigrams, literal);
+            break;
+        default:
+            if (depth == 0 && (guchar)*p < 0x80) {
+                g_string_append_c(literal, *p);
+            } else {
+                add_literal(trigrams, literal);
+            }
+            break;
+        }
+    }
+
+    add_literal(trigrams, literal);
+    g_string_free(literal, TRUE);
+}
+
+static gboolean has_regex_syntax(const char *term) {
+    return strpbrk(term, ".[]()*+?{}|^$\\") != NULL;
+}
+
+SearchQuery* search_query_new(const char *query) {
+    char **words = g_strsplit_set(query, " \t", -1);
+
+    SearchQuery *compiled = g_malloc(sizeof(SearchQuery));
+    compiled->terms = g_malloc(sizeof(SearchTerm) * (g_strv_length(words) + 1));
+    compiled->n_terms = 0;
+    compiled->trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    for (int i = 0; words[i]; i++) {
+        if (words[i][0] == '\0') continue;
+
+        SearchTerm *term = &compiled->terms[compiled->n_terms++];
+        term->literal = NULL;
+        term->regex = NULL;
+
+        // Like pacman -Ss, terms are regular expressions; invalid ones
+        // degrade to plain substrings
+        if (has_regex_syntax(words[i])) {
+            term->regex = g_regex_new(words[i], G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+        }
+
+        if (term->regex) {
+            add_regex_literals(compiled->trigrams, words[i]);
+        } else {
+            term->literal = g_ascii_strdown(words[i], -1);
+            add_trigrams(compiled->trigrams, term->literal, strlen(term->literal));
+        }
+    }
+
+    sort_unique(compiled->trigrams);
+    g_strfreev(words);
+    return compiled;
+}
+
+void search_query_free(SearchQuery *query) {
+    if (!query) return;
+
+    for (int i = 0; i < query->n_terms; i++) {
+        g_free(query->terms[i].literal);
+        if (query->terms[i].regex) g_regex_unref(query->terms[i].regex);
+    }
+
+    g_free(query->terms);
+    g_array_free(query->trigrams, TRUE);
+    g_free(query);
+}
+
+gboolean search_query_matches(const SearchQuery *query, const Package *pkg) {
+    const char *description = pkg->description ? pkg->description : "";
+
+    for (int i = 0; i < query->n_terms; i++) {
+        const SearchTerm *term = &query->terms[i];
+
+        if (term->literal) {
+            if (!strcasestr(pkg->name, term->literal) && !strcasestr(description, term->literal)) {
+                return FALSE;
+            }
+        } else if (!g_regex_match(term->regex, pkg->name, 0, NULL) &&
+                   !g_regex_match(term->regex, description, 0, NULL)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static int compare_posting_lengths(const void *a, const void *b) {
+    guint length_a = ((const PostingList*)a)->length;
+    guint length_b = ((const PostingList*)b)->length;
+    return length_a < length_b ? -1 : length_a > length_b;
+}
+
+// Intersects sorted candidates with a sorted posting list in place
+static guint intersect(guint32 *candidates, guint n_candidates, const PostingList *list) {
+    guint kept = 0;
+    guint j = 0;
+
+    for (guint i = 0; i < n_candidates && j < list->length; i++) {
+        while (j < list->length && list->postings[j] < candidates[i]) j++;
+        if (j < list->length && list->postings[j] == candidates[i]) {
+            candidates[kept++] = candidates[i];
+        }
+    }
+
+    return kept;
+}
+
+void search_index_foreach_match(const SearchIndex *index, const PackageList *packages,
+                                const SearchQuery *query, SearchMatchFunc func, gpointer user_data) {
+    guint n_trigrams = query->trigrams->len;
+
+    if (!index || n_trigrams == 0) {
+        for (int i = 0; i < packages->count; i++) {
+            const Package *pkg = &packages->packages[i];
+            if (search_query_matches(query, pkg) && !func(pkg, user_data)) return;
+        }
+        return;
+    }
+
+    PostingList *lists = g_malloc(sizeof(PostingList) * n_trigrams);
+    for (guint k = 0; k < n_trigrams; k++) {
+        // A required trigram that never occurs rules out every package
+        if (!lookup_postings(index, g_array_index(query->trigrams, guint32, k), &lists[k])) {
+            g_free(lists);
+            return;
+        }
+    }
+
+    // Start from the rarest trigram so the candidate set shrinks fastest
+    qsort(lists, n_trigrams, sizeof(PostingList), compare_posting_lengths);
+
+    guint n_candidates = lists[0].length;
+    guint32 *candidates = g_memdup2(lists[0].postings, sizeof(guint32) * MAX(n_candidates, 1));
+    for (guint k = 1; k < n_trigrams && n_candidates > 0; k++) {
+        n_candidates = intersect(candidates, n_candidates, &lists[k]);
+    }
+    g_free(lists);
+
+    // Trigrams only prefilter; candidates still need a real match
+    for (guint i = 0; i < n_candidates; i++) {
+        const Package *pkg = &packages->packages[candidates[i]];
+        if (search_query_matches(query, pkg) && !func(pkg, user_data)) break;
+    }
+
+    g_free(candidates);
+}
@@ -0,0 +1,29 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "pacman_wrapper.h"
+
+// Trigram inverted index over the names and descriptions of one PackageList
+typedef struct SearchIndex SearchIndex;
+
+// A compiled `pacman -Ss` style query: whitespace separated terms that must
+// all match the name or the description. Terms containing regex syntax are
+// matched as case-insensitive regular expressions, others as substrings.
+typedef struct SearchQuery SearchQuery;
+
+typedef gboolean (*SearchMatchFunc)(const Package *pkg, gpointer user_data);
+
+SearchIndex* search_index_build(const PackageList *packages);
+void search_index_free(SearchIndex *index);
+
+SearchQuery* search_query_new(const char *query);
+void search_query_free(SearchQuery *query);
+gboolean search_query_matches(const SearchQuery *query, const Package *pkg);
+
+// Calls func for every package of packages matching query, in list order,
+// until it returns FALSE. index may be NULL, in which case every package is
+// checked.
+void search_index_foreach_match(const SearchIndex *index, const PackageList *packages,
+                                const SearchQuery *query, SearchMatchFunc func, gpointer user_data);
+
+#endif
@@ -0,0 +1,334 @@
+#include "search_pipeline.h"
+#include "sync_db.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct SearchPipeline {
+    gint ref_count;         // Held by the owner and by every running job
+    SearchResultCallback callback;
+    gpointer user_data;
+    guint generation;       // Bumped whenever earlier results become stale
+    guint debounce_id;
+    char *pending_query;
+    SearchSource pending_source;
+    GCancellable *cancellable;  // Of the live search, if any
+};
+
+// One query, answered by one backend or, for SEARCH_SOURCE_ALL, by the
+// repositories and the AUR concurrently
+typedef struct {
+    SearchPipeline *pipeline;
+    guint generation;
+    char *query;
+    SearchSource source;
+    GCancellable *cancellable;
+    int n_parts;
+    int n_running;          // Parts that have not finished yet
+    int n_failed;
+    gboolean delivered;     // A FIRST batch has been passed on
+    // SEARCH_SOURCE_ALL: batches of each source, merged and ranked once
+    // both have finished
+    GPtrArray *held_repo;
+    GPtrArray *held_aur;
+} SearchJob;
+
+// A single backend's share of a job
+typedef struct {
+    SearchJob *job;
+    SearchSource source;
+    PackageList *results;   // Set by the worker for in-memory searches
+} SearchPart;
+
+static SearchPipeline* pipeline_ref(SearchPipeline *pipeline) {
+    pipeline->ref_count++;
+    return pipeline;
+}
+
+// Only touched on the main thread, so the count needs no atomics
+static void pipeline_unref(SearchPipeline *pipeline) {
+    if (--pipeline->ref_count > 0) return;
+
+    g_free(pipeline->pending_query);
+    g_free(pipeline);
+}
+
+static void search_job_free(SearchJob *job) {
+    pipeline_unref(job->pipeline);
+    g_object_unref(job->cancellable);
+    g_ptr_array_free(job->held_repo, TRUE);
+    g_ptr_array_free(job->held_aur, TRUE);
+    g_free(job->query);
+    g_free(job);
+}
+
+static gboolean search_job_is_live(SearchJob *job) {
+    return job->generation == job->pipeline->generation && !g_cancellable_is_cancelled(job->cancellable);
+}
+
+static void deliver_batch(SearchJob *job, PackageList *batch, gboolean last) {
+    SearchPipeline *pipeline = job->pipeline;
+
+    SearchBatchFlags flags = 0;
+    if (!job->delivered) flags |= SEARCH_BATCH_FIRST;
+    if (last) flags |= SEARCH_BATCH_LAST;
+    job->delivered = TRUE;
+
+    if (last) g_clear_object(&pipeline->cancellable);
+
+    if (pipeline->callback) {
+        pipeline->callback(batch, flags, job->query, job->source, pipeline->user_data);
+    } else {
+        package_list_free(batch);
+    }
+}
+
+// Lower is better: exact name, name prefix, name substring, then matches
+// found only in the description. Compared against the first query term,
+// ignoring ASCII case, without allocating.
+static int relevance_tier(const char *name, const char *term, gsize term_length) {
+    if (g_ascii_strncasecmp(name, term, term_length) == 0) return name[term_length] ? 1 : 0;
+
+    for (const char *start = name + 1; *start; start++) {
+        if (g_ascii_strncasecmp(start, term, term_length) == 0) return 2;
+    }
+    return 3;
+}
+
+typedef struct {
+    int tier;
+    int index;
+} RankKey;
+
+static int compare_rank_keys(const void *a, const void *b) {
+    const RankKey *x = a, *y = b;
+    if (x->tier != y->tier) return x->tier - y->tier;
+    return x->index - y->index;
+}
+
+// Each package's tier is computed once; ties keep their incoming order, so
+// repository order from pacman.conf, and repositories before the AUR, hold
+// within a tier
+static void rank_results(PackageList *list, const char *query) {
+    if (!list || list->count < 2) return;
+
+    char **terms = g_strsplit_set(query, " \t", -1);
+    const char *term = "";
+    for (char **word = terms; *word; word++) {
+        if (**word) {
+            term = *word;
+            break;
+        }
+    }
+
+    gsize term_length = strlen(term);
+    if (term_length > 0) {
+        RankKey *keys = g_new(RankKey, list->count);
+        for (int i = 0; i < list->count; i++) {
+            keys[i].tier = relevance_tier(list->packages[i].name, term, term_length);
+            keys[i].index = i;
+        }
+        qsort(keys, list->count, sizeof(RankKey), compare_rank_keys);
+
+        Package *ranked = malloc(sizeof(Package) * list->capacity);
+        for (int i = 0; i < list->count; i++) ranked[i] = list->packages[keys[i].index];
+        free(list->packages);
+        list->packages = ranked;
+        g_free(keys);
+    }
+    g_strfreev(terms);
+}
+
+static void emit_batch(SearchJob *job, PackageList *batch) {
+    gboolean last = job->n_running == 0;
+    if (batch->count == 0 && !last) {
+        package_list_free(batch);
+        return;
+    }
+    deliver_batch(job, batch, last);
+}
+
+// Moves the packages of held batches into merged, skipping names it already
+// has; the strings come along with the batches' arenas
+static void merge_held_batches(PackageList *merged, GPtrArray *held, GHashTable *seen) {
+    for (guint i = 0; i < held->len; i++) {
+        PackageList *batch = g_ptr_array_index(held, i);
+        for (int k = 0; k < batch->count; k++) {
+            Package *pkg = &batch->packages[k];
+            if (!g_hash_table_add(seen, pkg->name)) continue;
+            *package_list_append(merged) = *pkg;
+        }
+        arena_adopt(merged->arena, batch->arena);
+        batch->arena = NULL;
+    }
+    g_ptr_array_set_size(held, 0);
+}
+
+// Both sources as one list in relevance order, a repository package
+// winning over an AUR one of the same name
+static PackageList* merge_all_sources(SearchJob *job) {
+    PackageList *merged = package_list_new(0);
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    merge_held_batches(merged, job->held_repo, seen);
+    merge_held_batches(merged, job->held_aur, seen);
+    g_hash_table_destroy(seen);
+
+    rank_results(merged, job->query);
+    return merged;
+}
+
+// Handles a batch from one part; batch is NULL only when a finished part
+// failed
+static void handle_part_batch(SearchPart *part, PackageList *batch, gboolean finished) {
+    SearchJob *job = part->job;
+
+    if (finished) {
+        job->n_running--;
+        if (!batch) job->n_failed++;
+    }
+
+    if (!search_job_is_live(job)) {
+        package_list_free(batch);
+    } else if (job->n_running == 0 && job->n_failed == job->n_parts) {
+        // Nothing answered; a partial failure only loses that source
+        package_list_free(batch);
+        deliver_batch(job, NULL, TRUE);
+    } else if (job->source == SEARCH_SOURCE_ALL) {
+        // Ranking needs every result, so both sources arrive as one batch
+        if (batch) g_ptr_array_add(part->source == SEARCH_SOURCE_AUR ? job->held_aur : job->held_repo, batch);
+        if (job->n_running == 0) deliver_batch(job, merge_all_sources(job), TRUE);
+    } else {
+        emit_batch(job, batch ? batch : package_list_new(0));
+    }
+
+    if (finished) {
+        g_free(part);
+        if (job->n_running == 0) search_job_free(job);
+    }
+}
+
+static void on_stream_batch(PackageList *batch, gboolean finished, gpointer user_data) {
+    // A stream that ran to completion succeeded even if it found nothing
+    if (finished && !batch) batch = package_list_new(0);
+    handle_part_batch((SearchPart*)user_data, batch, finished);
+}
+
+static gboolean deliver_worker_results(gpointer data) {
+    SearchPart *part = (SearchPart*)data;
+    handle_part_batch(part, part->results, TRUE);
+    return FALSE;
+}
+
+static gpointer search_thread(gpointer data) {
+    SearchPart *part = (SearchPart*)data;
+
+    if (part->source == SEARCH_SOURCE_AUR) {
+        part->results = aur_search(part->job->query, part->job->cancellable);
+    } else {
+        part->results = pacman_search(part->job->query, part->job->cancellable);
+    }
+    // An "all" search ranks once, after merging
+    if (part->job->source != SEARCH_SOURCE_ALL) rank_results(part->results, part->job->query);
+
+    g_idle_add(deliver_worker_results, part);
+    return NULL;
+}
+
+static void start_part(SearchJob *job, SearchSource source) {
+    SearchPart *part = g_malloc(sizeof(SearchPart));
+    part->job = job;
+    part->source = source;
+    part->results = NULL;
+
+    // Output of a spawned `pacman -Ss` is parsed as it arrives on the main
+    // loop; catalog and AUR RPC searches block, so they run on a worker
+    gboolean started;
+    if (source == SEARCH_SOURCE_REPOS && !sync_catalog_is_ready()) {
+        started = pacman_search_stream(job->query, job->cancellable, on_stream_batch, part);
+    } else {
+        GThread *thread = g_thread_new("search", search_thread, part);
+        g_thread_unref(thread);
+        started = TRUE;
+    }
+
+    // Report a search that could not be started from the main loop, like
+    // every other result
+    if (!started) g_idle_add(deliver_worker_results, part);
+}
+
+static void start_search(SearchPipeline *pipeline) {
+    SearchJob *job = g_malloc0(sizeof(SearchJob));
+    job->pipeline = pipeline_ref(pipeline);
+    job->generation = pipeline->generation;
+    job->query = pipeline->pending_query;
+    job->source = pipeline->pending_source;
+    job->cancellable = g_cancellable_new();
+    job->held_repo = g_ptr_array_new_with_free_func((GDestroyNotify)package_list_free);
+    job->held_aur = g_ptr_array_new_with_free_func((GDestroyNotify)package_list_free);
+
+    pipeline->pending_query = NULL;
+    pipeline->cancellable = g_object_ref(job->cancellable);
+
+    // Both sources of an "all" search run at once, so it takes as long as
+    // the slower one rather than the sum
+    job->n_parts = job->source == SEARCH_SOURCE_ALL ? 2 : 1;
+    job->n_running = job->n_parts;
+
+    if (job->source != SEARCH_SOURCE_AUR) start_part(job, SEARCH_SOURCE_REPOS);
+    if (job->source != SEARCH_SOURCE_REPOS) start_part(job, SEARCH_SOURCE_AUR);
+}
+
+static gboolean on_debounce_elapsed(gpointer data) {
+    SearchPipeline *pipeline = (SearchPipeline*)data;
+
+    pipeline->debounce_id = 0;
+    start_search(pipeline);
+    return FALSE;
+}
+
+SearchPipeline* search_pipeline_new(SearchResultCallback callback, gpointer user_data) {
+    SearchPipeline *pipeline = g_malloc0(sizeof(SearchPipeline));
+    pipeline->ref_count = 1;
+    pipeline->callback = callback;
+    pipeline->user_data = user_data;
+    return pipeline;
+}
+
+void search_pipeline_cancel(SearchPipeline *pipeline) {
+    pipeline->generation++;
+
+    if (pipeline->debounce_id) {
+        g_source_remove(pipeline->debounce_id);
+        pipeline->debounce_id = 0;
+    }
+
+    g_free(pipeline->pending_query);
+    pipeline->pending_query = NULL;
+
+    // A streamed search kills its process; either way the result is dropped
+    if (pipeline->cancellable) {
+        g_cancellable_cancel(pipeline->cancellable);
+        g_clear_object(&pipeline->cancellable);
+    }
+}
+
+void search_pipeline_submit(SearchPipeline *pipeline, const char *query,
+                            SearchSource source, guint delay_ms) {
+    search_pipeline_cancel(pipeline);
+
+    pipeline->pending_query = g_strdup(query);
+    pipeline->pending_source = source;
+
+    if (delay_ms == 0) {
+        start_search(pipeline);
+    } else {
+        pipeline->debounce_id = g_timeout_add(delay_ms, on_debounce_elapsed, pipeline);
+    }
+}
+
+void search_pipeline_free(SearchPipeline *pipeline) {
+    if (!pipeline) return;
+
+    search_pipeline_cancel(pipeline);
+    pipeline->callback = NULL;
+    pipeline_unref(pipeline);
+}
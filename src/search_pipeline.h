@@ -0,0 +1,42 @@
+#ifndef SEARCH_PIPELINE_H
+#define SEARCH_PIPELINE_H
+
+#include "pacman_wrapper.h"
+
+typedef enum {
+    SEARCH_SOURCE_REPOS,
+    SEARCH_SOURCE_AUR,
+    // Both at once, merged by name and ranked together, repository packages
+    // first within a relevance tier and over AUR packages of the same name
+    SEARCH_SOURCE_ALL
+} SearchSource;
+
+typedef enum {
+    SEARCH_BATCH_FIRST = 1 << 0,    // Replaces the previous query's results
+    SEARCH_BATCH_LAST = 1 << 1      // No more batches follow for this query
+} SearchBatchFlags;
+
+// Runs on the main loop with results of the latest submitted query and
+// takes ownership of them. Catalog, AUR and "all" searches arrive as a
+// single FIRST | LAST batch ranked by relevance; a repository-only
+// `pacman -Ss` search, used until the catalog is loaded, streams several
+// batches in pacman's order.
+// batch is NULL if the search failed. Superseded or cancelled searches never
+// call back.
+typedef void (*SearchResultCallback)(PackageList *batch, SearchBatchFlags flags, const char *query,
+                                     SearchSource source, gpointer user_data);
+
+// Debounced background searches. At most one search is live: submitting a
+// new query cancels the one in flight (killing its search process) and
+// restarts the debounce timer.
+typedef struct SearchPipeline SearchPipeline;
+
+SearchPipeline* search_pipeline_new(SearchResultCallback callback, gpointer user_data);
+// delay_ms of 0 starts the search right away, e.g. for an explicit button press
+void search_pipeline_submit(SearchPipeline *pipeline, const char *query,
+                            SearchSource source, guint delay_ms);
+void search_pipeline_cancel(SearchPipeline *pipeline);
+// Cancels any pending search; the callback is not called afterwards
+void search_pipeline_free(SearchPipeline *pipeline);
+
+#endif
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include "subprocess.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// First capture buffer; it doubles whenever it fills
+#define OUTPUT_INITIAL_CAPACITY 16384
+// How long a terminated child gets before SIGKILL
+#define TERMINATE_GRACE_MS 2000
+
+struct Subprocess {
+    pid_t pid;
+    int fd;
+    gboolean own_group;
+    gboolean reaped;
+    gint64 started;
+};
+
+Subprocess* subprocess_spawn(const char *const *argv, SubprocessFlags flags) {
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) == -1) return NULL;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    // dup2 clears close-on-exec on the copies
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+    if (flags & SUBPROCESS_MERGE_STDERR) {
+        posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDERR_FILENO);
+    } else if (flags & SUBPROCESS_DISCARD_STDERR) {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short attr_flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    if (flags & SUBPROCESS_OWN_GROUP) {
+        attr_flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    posix_spawnattr_setflags(&attr, attr_flags);
+
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], &actions, &attr, (char *const *)argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(pipefd[1]);
+
+    if (error != 0) {
+        close(pipefd[0]);
+        return NULL;
+    }
+
+    Subprocess *process = g_malloc(sizeof(Subprocess));
+    process->pid = pid;
+    process->fd = pipefd[0];
+    process->own_group = (flags & SUBPROCESS_OWN_GROUP) != 0;
+    process->reaped = FALSE;
+    process->started = g_get_monotonic_time();
+    return process;
+}
+
+int subprocess_get_fd(const Subprocess *process) {
+    return process->fd;
+}
+
+static void send_signal(Subprocess *process, int signal) {
+    if (process->reaped) return;
+    if (process->own_group) kill(-process->pid, signal);
+    kill(process->pid, signal);
+}
+
+void subprocess_terminate(Subprocess *process) {
+    send_signal(process, SIGTERM);
+}
+
+static void fill_result(Subprocess *process, int status, const struct rusage *usage, SubprocessResult *result) {
+    result->elapsed_us = g_get_monotonic_time() - process->started;
+    result->user_time = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6;
+    result->system_time = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+    result->max_rss_kb = usage->ru_maxrss;
+
+    if (WIFEXITED(status)) {
+        result->status = SUBPROCESS_EXITED;
+        result->exit_code = WEXITSTATUS(status);
+        result->signal = 0;
+    } else {
+        result->status = SUBPROCESS_SIGNALED;
+        result->exit_code = -1;
+        result->signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+    }
+}
+
+void subprocess_wait(Subprocess *process, SubprocessResult *result) {
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+
+    if (!process->reaped) {
+        while (wait4(process->pid, &status, 0, &usage) < 0 && errno == EINTR);
+        process->reaped = TRUE;
+    }
+    if (result) fill_result(process, status, &usage, result);
+}
+
+// SIGTERM, then SIGKILL if the child is still around after the grace period
+static void terminate_and_wait(Subprocess *process, SubprocessResult *result) {
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+
+    subprocess_terminate(process);
+    gint64 kill_at = g_get_monotonic_time() + TERMINATE_GRACE_MS * 1000;
+    gboolean killed = FALSE;
+
+    while (!process->reaped) {
+        pid_t pid = wait4(process->pid, &status, killed ? 0 : WNOHANG, &usage);
+        if (pid == process->pid || (pid < 0 && errno != EINTR)) {
+            process->reaped = TRUE;
+        } else if (pid == 0 && g_get_monotonic_time() >= kill_at) {
+            send_signal(process, SIGKILL);
+            killed = TRUE;
+        } else if (pid == 0) {
+            g_usleep(10 * 1000);
+        }
+    }
+    if (result) fill_result(process, status, &usage, result);
+}
+
+void subprocess_free(Subprocess *process) {
+    if (!process) return;
+
+    if (!process->reaped) terminate_and_wait(process, NULL);
+    close(process->fd);
+    g_free(process);
+}
+
+gboolean subprocess_run(const char *const *argv, SubprocessFlags flags, guint timeout_ms,
+                        GCancellable *cancellable, SubprocessResult *result) {
+    memset(result, 0, sizeof(*result));
+
+    Subprocess *process = subprocess_spawn(argv, flags);
+    if (!process) {
+        result->status = SUBPROCESS_SPAWN_FAILED;
+        result->exit_code = -1;
+        return FALSE;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = process->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = cancellable ? g_cancellable_get_fd(cancellable) : -1;
+    fds[1].events = POLLIN;
+    int nfds = fds[1].fd >= 0 ? 2 : 1;
+
+    gint64 deadline = timeout_ms ? process->started + (gint64)timeout_ms * 1000 : 0;
+    gsize capacity = OUTPUT_INITIAL_CAPACITY;
+    gsize length = 0;
+    char *output = malloc(capacity);
+    SubprocessStatus stopped = SUBPROCESS_EXITED;
+
+    while (TRUE) {
+        if (cancellable && g_cancellable_is_cancelled(cancellable)) {
+            stopped = SUBPROCESS_CANCELLED;
+            break;
+        }
+
+        int wait_ms = -1;
+        if (deadline) {
+            gint64 remaining = deadline - g_get_monotonic_time();
+            if (remaining <= 0) {
+                stopped = SUBPROCESS_TIMED_OUT;
+                break;
+            }
+            wait_ms = (int)MIN((remaining + 999) / 1000, G_MAXINT);
+        }
+
+        int ready = poll(fds, nfds, wait_ms);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0 || !(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        // Always room for the terminator
+        if (capacity - length < 2) {
+            capacity *= 2;
+            output = realloc(output, capacity);
+        }
+        ssize_t n = read(process->fd, output + length, capacity - length - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        length += n;
+    }
+
+    if (cancellable && fds[1].fd >= 0) g_cancellable_release_fd(cancellable);
+
+    if (stopped == SUBPROCESS_EXITED) {
+        subprocess_wait(process, result);
+    } else {
+        terminate_and_wait(process, result);
+        result->status = stopped;
+    }
+    subprocess_free(process);
+
+    output[length] = '\0';
+    result->output = output;
+    result->output_length = length;
+    return subprocess_result_succeeded(result);
+}
+
+gboolean subprocess_result_succeeded(const SubprocessResult *result) {
+    return result->status == SUBPROCESS_EXITED && result->exit_code == 0;
+}
+
+void subprocess_result_clear(SubprocessResult *result) {
+    free(result->output);
+    result->output = NULL;
+    result->output_length = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef SUBPROCESS_H
+#define SUBPROCESS_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <sys/types.h>
+
+// Child processes started with posix_spawn from an argv; no shell is
+// involved, so arguments such as package names or search queries are
+// passed through untouched. The child's stdin is /dev/null and its stdout
+// (optionally stderr too) is a pipe the caller reads from.
+
+typedef enum {
+    SUBPROCESS_DEFAULT = 0,
+    SUBPROCESS_MERGE_STDERR = 1 << 0,   // stderr joins the output
+    SUBPROCESS_DISCARD_STDERR = 1 << 1, // stderr goes to /dev/null; otherwise inherited
+    SUBPROCESS_OWN_GROUP = 1 << 2       // The child leads a new process group and is
+                                        // killed with everything it started
+} SubprocessFlags;
+
+typedef enum {
+    SUBPROCESS_EXITED,          // exit_code is valid
+    SUBPROCESS_SIGNALED,        // Killed by signal, not by us
+    SUBPROCESS_TIMED_OUT,
+    SUBPROCESS_CANCELLED,
+    SUBPROCESS_SPAWN_FAILED     // Nothing ran
+} SubprocessStatus;
+
+typedef struct {
+    SubprocessStatus status;
+    int exit_code;
+    int signal;
+    gint64 elapsed_us;          // Wall clock from spawn to reaping
+    double user_time;           // CPU seconds, children of the child included
+    double system_time;
+    long max_rss_kb;
+    // subprocess_run only: captured output, NUL-terminated; release with
+    // subprocess_result_clear or take it over and free() it
+    char *output;
+    gsize output_length;
+} SubprocessResult;
+
+typedef struct Subprocess Subprocess;
+
+// argv[0] is looked up in PATH. NULL if the child could not be started.
+Subprocess* subprocess_spawn(const char *const *argv, SubprocessFlags flags);
+// Read end of the output pipe, owned by the subprocess
+int subprocess_get_fd(const Subprocess *process);
+// SIGTERM to the child, or to its whole group with SUBPROCESS_OWN_GROUP
+void subprocess_terminate(Subprocess *process);
+// Blocks until the child exits and fills in everything but the output.
+// Call once, normally after reading the pipe to its end.
+void subprocess_wait(Subprocess *process, SubprocessResult *result);
+// Terminates and reaps the child if that has not happened yet
+void subprocess_free(Subprocess *process);
+
+// Runs argv to completion and captures its output into a buffer that
+// grows geometrically. With timeout_ms (0: none) elapsed or cancellable
+// triggered, the child is terminated and the result says why; output read
+// so far is kept. Returns TRUE if the child exited with status 0.
+gboolean subprocess_run(const char *const *argv, SubprocessFlags flags, guint timeout_ms,
+                        GCancellable *cancellable, SubprocessResult *result);
+gboolean subprocess_result_succeeded(const SubprocessResult *result);
+void subprocess_result_clear(SubprocessResult *result);
+
+#endif
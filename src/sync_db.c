@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+#include "sync_db.h"
+#include "db_desc.h"
+#include "catalog_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include <gio/gio.h>
+
+typedef struct {
+    GMutex lock;
+    GPtrArray *dbs;         // SyncDb*, in pacman.conf order
+    gboolean loading;
+    GPtrArray *loaded_dbs;  // Read by the load thread, waiting for the swap job
+    gboolean loaded_from_snapshot;
+    char *sync_dir;
+    SyncCatalogCallback callback;
+    gpointer user_data;
+    GFileMonitor *monitor;
+    GThreadPool *reload_pool;
+    GHashTable *installed;      // Names of installed packages; NULL until known
+    guint installed_generation; // Bumped by every change reported for them
+} SyncCatalog;
+
+typedef struct {
+    char *path;
+    char *name;
+    SyncDb *db;
+} SyncDbLoadJob;
+
+static SyncCatalog catalog;
+
+// Queued on reload_pool to put the databases of a full load in place, then
+// index them if restored from a snapshot or save one if read from archives
+static char swap_job_marker;
+
+static char* read_entry_data(struct archive *archive, la_int64_t size, char **buffer, size_t *buffer_size) {
+    if ((size_t)size + 1 > *buffer_size) {
+        *buffer_size = size + 1;
+        *buffer = realloc(*buffer, *buffer_size);
+    }
+
+    la_int64_t total = 0;
+    while (total < size) {
+        la_ssize_t n = archive_read_data(archive, *buffer + total, size - total);
+        if (n <= 0) break;
+        total += n;
+    }
+
+    (*buffer)[total] = '\0';
+    return *buffer;
+}
+
+SyncDb* sync_db_load(const char *path, const char *name) {
+    gint64 stamp = catalog_cache_file_stamp(path);
+    if (stamp < 0) return NULL;
+
+    struct archive *archive = archive_read_new();
+    archive_read_support_filter_all(archive);
+    archive_read_support_format_tar(archive);
+
+    if (archive_read_open_filename(archive, path, 128 * 1024) != ARCHIVE_OK) {
+        archive_read_free(archive);
+        return NULL;
+    }
+
+    PackageList *list = package_list_new(1024);
+    char *repository = arena_intern(list->arena, name);
+
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+    struct archive_entry *entry;
+
+    while (archive_read_next_header(archive, &entry) == ARCHIVE_OK) {
+        // Each package is a "<name>-<version>/" directory; only desc matters here
+        const char *pathname = archive_entry_pathname(entry);
+        if (!pathname || !g_str_has_suffix(pathname, "/desc")) continue;
+
+        la_int64_t size = archive_entry_size(entry);
+        if (size <= 0) continue;
+
+        Package *pkg = package_list_append(list);
+        db_desc_parse(read_entry_data(archive, size, &buffer, &buffer_size), pkg, NULL, list->arena);
+
+        if (!pkg->name || !pkg->version) {
+            list->count--;
+            continue;
+        }
+
+        if (!pkg->description) pkg->description = arena_intern(list->arena, "");
+        pkg->repository = repository;
+    }
+
+    free(buffer);
+    archive_read_free(archive);
+
+    SyncDb *db = g_malloc(sizeof(SyncDb));
+    db->name = strdup(name);
+    db->path = strdup(path);
+    db->mtime = stamp;
+    db->packages = list;
+    db->index = NULL;
+    return db;
+}
+
+void sync_db_free(SyncDb *db) {
+    if (!db) return;
+
+    package_list_free(db->packages);
+    search_index_free(db->index);
+    free(db->name);
+    free(db->path);
+    g_free(db);
+}
+
+// Repository order from pacman.conf, so results rank like `pacman -Ss`
+static GHashTable* configured_repository_ranks(void) {
+    GHashTable *ranks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    FILE *fp = fopen("/etc/pacman.conf", "r");
+    if (!fp) return ranks;
+
+    char line[512];
+    int rank = 1;
+    while (fgets(line, sizeof(line), fp)) {
+        char *start = g_strstrip(line);
+        if (start[0] != '[') continue;
+
+        char *end = strchr(start, ']');
+        if (!end) continue;
+        *end = '\0';
+
+        if (strcmp(start + 1, "options") != 0) {
+            g_hash_table_insert(ranks, g_strdup(start + 1), GINT_TO_POINTER(rank++));
+        }
+    }
+
+    fclose(fp);
+    return ranks;
+}
+
+static int compare_repository_names(const char *a, const char *b, GHashTable *ranks) {
+    // Unknown repositories sort after configured ones
+    int rank_a = GPOINTER_TO_INT(g_hash_table_lookup(ranks, a));
+    int rank_b = GPOINTER_TO_INT(g_hash_table_lookup(ranks, b));
+    if (rank_a == 0) rank_a = G_MAXINT;
+    if (rank_b == 0) rank_b = G_MAXINT;
+
+    if (rank_a != rank_b) return rank_a < rank_b ? -1 : 1;
+    return strcmp(a, b);
+}
+
+static int compare_load_jobs(gconstpointer a, gconstpointer b, gpointer user_data) {
+    return compare_repository_names((*(SyncDbLoadJob* const*)a)->name,
+                                    (*(SyncDbLoadJob* const*)b)->name, user_data);
+}
+
+static int compare_dbs(gconstpointer a, gconstpointer b, gpointer user_data) {
+    return compare_repository_names((*(SyncDb* const*)a)->name,
+                                    (*(SyncDb* const*)b)->name, user_data);
+}
+
+static SyncDb* load_indexed_db(const char *path, const char *name) {
+    SyncDb *db = sync_db_load(path, name);
+    if (db) {
+        db->index = search_index_build(db->packages);
+    }
+    return db;
+}
+
+static void load_db_job(gpointer data, gpointer user_data) {
+    SyncDbLoadJob *job = (SyncDbLoadJob*)data;
+    job->db = load_indexed_db(job->path, job->name);
+}
+
+static GPtrArray* load_sync_dir(const char *sync_dir) {
+    GDir *dir = g_dir_open(sync_dir, 0, NULL);
+    if (!dir) return NULL;
+
+    GPtrArray *jobs = g_ptr_array_new();
+    const char *filename;
+    while ((filename = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(filename, ".db")) continue;
+
+        SyncDbLoadJob *job = g_malloc(sizeof(SyncDbLoadJob));
+        job->path = g_build_filename(sync_dir, filename, NULL);
+        job->name = g_strndup(filename, strlen(filename) - 3);
+        job->db = NULL;
+        g_ptr_array_add(jobs, job);
+    }
+    g_dir_close(dir);
+
+    GHashTable *ranks = configured_repository_ranks();
+    g_qsort_with_data(jobs->pdata, jobs->len, sizeof(gpointer), compare_load_jobs, ranks);
+    g_hash_table_destroy(ranks);
+
+    // Decompression and indexing dominate, so every archive gets its own worker
+    GThreadPool *pool = g_thread_pool_new(load_db_job, NULL, MAX(1, (int)jobs->len), FALSE, NULL);
+    for (guint i = 0; i < jobs->len; i++) {
+        g_thread_pool_push(pool, g_ptr_array_index(jobs, i), NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    GPtrArray *dbs = g_ptr_array_new_with_free_func((GDestroyNotify)sync_db_free);
+    for (guint i = 0; i < jobs->len; i++) {
+        SyncDbLoadJob *job = g_ptr_array_index(jobs, i);
+        if (job->db) g_ptr_array_add(dbs, job->db);
+        g_free(job->path);
+        g_free(job->name);
+        g_free(job);
+    }
+    g_ptr_array_free(jobs, TRUE);
+
+    return dbs;
+}
+
+static int count_packages(GPtrArray *dbs) {
+    int count = 0;
+    for (guint i = 0; dbs && i < dbs->len; i++) {
+        count += ((SyncDb*)g_ptr_array_index(dbs, i))->packages->count;
+    }
+    return count;
+}
+
+static int find_db(GPtrArray *dbs, const char *name) {
+    for (guint i = 0; dbs && i < dbs->len; i++) {
+        if (strcmp(((SyncDb*)g_ptr_array_index(dbs, i))->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static gboolean call_catalog_callback(gpointer data) {
+    if (catalog.callback) {
+        catalog.callback(GPOINTER_TO_INT(data), catalog.user_data);
+    }
+    return FALSE;
+}
+
+// Must run on the reload worker (or before it exists), which is the only
+// place databases are freed, so packages stay valid while unlocked
+static void build_missing_indexes(void) {
+    while (TRUE) {
+        SyncDb *db = NULL;
+
+        g_mutex_lock(&catalog.lock);
+        for (guint i = 0; catalog.dbs && i < catalog.dbs->len && !db; i++) {
+            SyncDb *candidate = g_ptr_array_index(catalog.dbs, i);
+            if (!candidate->index) db = candidate;
+        }
+        g_mutex_unlock(&catalog.lock);
+
+        if (!db) break;
+
+        SearchIndex *index = search_index_build(db->packages);
+
+        g_mutex_lock(&catalog.lock);
+        db->index = index;
+        g_mutex_unlock(&catalog.lock);
+    }
+}
+
+// Same constraint as build_missing_indexes. Writing takes a while, so it
+// works from a copy of the list rather than holding the lock and stalling
+// searches on disk I/O.
+static void save_catalog_snapshot(void) {
+    g_mutex_lock(&catalog.lock);
+    GPtrArray *dbs = NULL;
+    if (catalog.dbs) {
+        dbs = g_ptr_array_sized_new(catalog.dbs->len);
+        for (guint i = 0; i < catalog.dbs->len; i++) g_ptr_array_add(dbs, g_ptr_array_index(catalog.dbs, i));
+    }
+    g_mutex_unlock(&catalog.lock);
+
+    if (!dbs) return;
+    catalog_cache_save_sync(catalog.sync_dir, dbs);
+    g_ptr_array_free(dbs, TRUE);
+}
+
+// Same constraint as build_missing_indexes: the databases it replaces are
+// freed here, so no snapshot write or index build still reads them
+static void swap_loaded_catalog(void) {
+    g_mutex_lock(&catalog.lock);
+    GPtrArray *old_dbs = catalog.dbs;
+    catalog.dbs = catalog.loaded_dbs;
+    catalog.loaded_dbs = NULL;
+    gboolean from_snapshot = catalog.loaded_from_snapshot;
+    catalog.loading = FALSE;
+    int package_count = count_packages(catalog.dbs);
+    g_mutex_unlock(&catalog.lock);
+
+    if (old_dbs) g_ptr_array_free(old_dbs, TRUE);
+
+    g_idle_add(call_catalog_callback, GINT_TO_POINTER(package_count));
+
+    if (from_snapshot) {
+        build_missing_indexes();
+    } else {
+        save_catalog_snapshot();
+    }
+}
+
+static gpointer load_catalog_thread(gpointer data) {
+    // A fresh snapshot is usable immediately; searches scan linearly until
+    // the indexes are rebuilt behind it
+    GPtrArray *dbs = catalog_cache_load_sync(catalog.sync_dir);
+    gboolean from_snapshot = dbs != NULL;
+    if (!dbs) dbs = load_sync_dir(catalog.sync_dir);
+
+    g_mutex_lock(&catalog.lock);
+    catalog.loaded_dbs = dbs;
+    catalog.loaded_from_snapshot = from_snapshot;
+    g_mutex_unlock(&catalog.lock);
+
+    if (catalog.reload_pool) {
+        g_thread_pool_push(catalog.reload_pool, &swap_job_marker, NULL);
+    } else {
+        swap_loaded_catalog();
+    }
+
+    // The local snapshot goes stale on the same package operations, so it
+    // is checked here too rather than when the installed tab is first shown.
+    // A fresh one only needs mapping; a stale one is read and rewritten.
+    guint generation = sync_catalog_installed_generation();
+    PackageList *installed = pacman_list_installed();
+    if (installed) {
+        sync_catalog_set_installed(installed, generation);
+        package_list_free(installed);
+    }
+    return NULL;
+}
+
+// Reloads and re-indexes a single repository; the others keep their
+// packages and postings untouched.
+static void reload_db_job(gpointer data, gpointer user_data) {
+    if (data == &swap_job_marker) {
+        swap_loaded_catalog();
+        return;
+    }
+
+    char *name = (char*)data;
+    char *filename = g_strconcat(name, ".db", NULL);
+    char *path = g_build_filename(catalog.sync_dir, filename, NULL);
+    g_free(filename);
+
+    gint64 stamp = catalog_cache_file_stamp(path);
+    gboolean exists = stamp >= 0;
+
+    g_mutex_lock(&catalog.lock);
+    gboolean ready = catalog.dbs != NULL;
+    int position = find_db(catalog.dbs, name);
+    gboolean unchanged = exists && position >= 0 &&
+                         ((SyncDb*)g_ptr_array_index(catalog.dbs, position))->mtime == stamp;
+    g_mutex_unlock(&catalog.lock);
+
+    // Before the initial load completes it will pick the file up by itself
+    SyncDb *db = NULL;
+    if (ready && !unchanged && (exists || position >= 0)) {
+        db = exists ? load_indexed_db(path, name) : NULL;
+
+        // A half-written archive fails to open; keep the old data until
+        // the next change notification
+        if (db || !exists) {
+            GHashTable *ranks = configured_repository_ranks();
+
+            g_mutex_lock(&catalog.lock);
+            SyncDb *old_db = NULL;
+            position = find_db(catalog.dbs, name);
+            if (position >= 0) {
+                old_db = g_ptr_array_steal_index(catalog.dbs, position);
+            }
+            if (db) {
+                g_ptr_array_add(catalog.dbs, db);
+                g_ptr_array_sort_with_data(catalog.dbs, compare_dbs, ranks);
+            }
+            int package_count = count_packages(catalog.dbs);
+            g_mutex_unlock(&catalog.lock);
+
+            g_hash_table_destroy(ranks);
+            sync_db_free(old_db);
+            g_idle_add(call_catalog_callback, GINT_TO_POINTER(package_count));
+            save_catalog_snapshot();
+        }
+    }
+
+    g_free(path);
+    g_free(name);
+}
+
+static void on_sync_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                GFileMonitorEvent event, gpointer user_data) {
+    GFile *targets[2] = { file, NULL };
+
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+        break;
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        // pacman downloads into a temporary file and renames it into place
+        targets[1] = other_file;
+        break;
+    default:
+        return;
+    }
+
+    for (int i = 0; i < 2 && targets[i]; i++) {
+        char *basename = g_file_get_basename(targets[i]);
+        if (basename && g_str_has_suffix(basename, ".db")) {
+            g_thread_pool_push(catalog.reload_pool, g_strndup(basename, strlen(basename) - 3), NULL);
+        }
+        g_free(basename);
+    }
+}
+
+static void watch_sync_dir(void) {
+    GFile *dir = g_file_new_for_path(catalog.sync_dir);
+    catalog.monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    g_object_unref(dir);
+
+    if (!catalog.monitor) return;
+
+    // A single worker keeps reloads of the same repository ordered
+    catalog.reload_pool = g_thread_pool_new(reload_db_job, NULL, 1, FALSE, NULL);
+    g_signal_connect(catalog.monitor, "changed", G_CALLBACK(on_sync_dir_changed), NULL);
+}
+
+gboolean sync_catalog_load_async(SyncCatalogCallback callback, gpointer user_data) {
+    g_mutex_lock(&catalog.lock);
+    if (catalog.loading) {
+        g_mutex_unlock(&catalog.lock);
+        return FALSE;
+    }
+    catalog.loading = TRUE;
+    g_mutex_unlock(&catalog.lock);
+
+    if (!catalog.sync_dir) {
+        catalog.sync_dir = g_build_filename(pacman_get_db_path(), "sync", NULL);
+    }
+    catalog.callback = callback;
+    catalog.user_data = user_data;
+
+    if (!catalog.monitor) {
+        watch_sync_dir();
+    }
+
+    GThread *thread = g_thread_new("load_sync_dbs", load_catalog_thread, NULL);
+    g_thread_unref(thread);
+    return TRUE;
+}
+
+gboolean sync_catalog_is_ready(void) {
+    g_mutex_lock(&catalog.lock);
+    gboolean ready = catalog.dbs != NULL;
+    g_mutex_unlock(&catalog.lock);
+    return ready;
+}
+
+static gboolean collect_match(const Package *src, gpointer user_data) {
+    PackageList *list = (PackageList*)user_data;
+
+    Package *pkg = package_list_append(list);
+    *pkg = *src;
+    pkg->name = arena_strdup(list->arena, src->name);
+    pkg->version = arena_strdup(list->arena, src->version);
+    pkg->description = arena_strdup(list->arena, src->description);
+    pkg->repository = arena_intern(list->arena, src->repository);
+
+    return TRUE;
+}
+
+PackageList* sync_catalog_search(const char *query) {
+    SearchQuery *compiled = search_query_new(query);
+
+    PackageList *list = package_list_new(128);
+
+    g_mutex_lock(&catalog.lock);
+    for (guint i = 0; catalog.dbs && i < catalog.dbs->len; i++) {
+        SyncDb *db = g_ptr_array_index(catalog.dbs, i);
+        search_index_foreach_match(db->index, db->packages, compiled, collect_match, list);
+    }
+    g_mutex_unlock(&catalog.lock);
+
+    search_query_free(compiled);
+    return list;
+}
+
+guint sync_catalog_installed_generation(void) {
+    g_mutex_lock(&catalog.lock);
+    guint generation = catalog.installed_generation;
+    g_mutex_unlock(&catalog.lock);
+    return generation;
+}
+
+gboolean sync_catalog_set_installed(const PackageList *installed, guint generation) {
+    GHashTable *names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (int i = 0; i < installed->count; i++) {
+        g_hash_table_add(names, g_strdup(installed->packages[i].name));
+    }
+
+    g_mutex_lock(&catalog.lock);
+    gboolean current = generation == catalog.installed_generation;
+    if (current) {
+        GHashTable *old_names = catalog.installed;
+        catalog.installed = names;
+        names = old_names;
+    }
+    g_mutex_unlock(&catalog.lock);
+
+    if (names) g_hash_table_destroy(names);
+    return current;
+}
+
+void sync_catalog_update_installed(GPtrArray *removed, const PackageList *changed) {
+    g_mutex_lock(&catalog.lock);
+    catalog.installed_generation++;
+    if (catalog.installed) {
+        // Removals first: an upgrade removes the old entry and adds the new one
+        for (guint i = 0; removed && i < removed->len; i++) {
+            g_hash_table_remove(catalog.installed, g_ptr_array_index(removed, i));
+        }
+        for (int i = 0; changed && i < changed->count; i++) {
+            g_hash_table_add(catalog.installed, g_strdup(changed->packages[i].name));
+        }
+    }
+    g_mutex_unlock(&catalog.lock);
+}
+
+gboolean sync_catalog_mark_installed(PackageList *list) {
+    g_mutex_lock(&catalog.lock);
+    gboolean known = catalog.installed != NULL;
+    for (int i = 0; known && i < list->count; i++) {
+        list->packages[i].installed = g_hash_table_contains(catalog.installed, list->packages[i].name);
+    }
+    g_mutex_unlock(&catalog.lock);
+    return known;
+}
+
+GPtrArray* sync_catalog_foreign_packages(PackageList *installed) {
+    g_mutex_lock(&catalog.lock);
+    if (!catalog.dbs) {
+        g_mutex_unlock(&catalog.lock);
+        return NULL;
+    }
+
+    GHashTable *names = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < catalog.dbs->len; i++) {
+        SyncDb *db = g_ptr_array_index(catalog.dbs, i);
+        for (int k = 0; k < db->packages->count; k++) {
+            g_hash_table_add(names, db->packages->packages[k].name);
+        }
+    }
+
+    GPtrArray *foreign = g_ptr_array_new();
+    for (int i = 0; i < installed->count; i++) {
+        if (!g_hash_table_contains(names, installed->packages[i].name)) {
+            g_ptr_array_add(foreign, &installed->packages[i]);
+        }
+    }
+
+    g_hash_table_destroy(names);
+    g_mutex_unlock(&catalog.lock);
+    return foreign;
+}
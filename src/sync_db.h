@@ -0,0 +1,48 @@
+#ifndef SYNC_DB_H
+#define SYNC_DB_H
+
+#include "pacman_wrapper.h"
+#include "search_index.h"
+
+typedef struct {
+    char *name;             // Repository name, e.g. "core"
+    char *path;             // Path of the .db archive
+    gint64 mtime;           // Modification time of the archive when loaded
+    PackageList *packages;
+    SearchIndex *index;     // Built in the background after loading, may be NULL
+} SyncDb;
+
+typedef void (*SyncCatalogCallback)(int package_count, gpointer user_data);
+
+// Reads one sync database archive (tar, gzip or zstd compressed)
+SyncDb* sync_db_load(const char *path, const char *name);
+void sync_db_free(SyncDb *db);
+
+// Process-wide in-memory catalog of every database in <dbpath>/sync.
+// Loading happens on a background thread; the callback runs on the main loop
+// after the initial load and again whenever a single database is reloaded
+// because it changed on disk. The initial load also brings the local
+// database's snapshot up to date and fills the installed set from it.
+gboolean sync_catalog_load_async(SyncCatalogCallback callback, gpointer user_data);
+gboolean sync_catalog_is_ready(void);
+PackageList* sync_catalog_search(const char *query);
+// Packages of installed (as pointers into it) that no sync database
+// contains, or NULL while the catalog is not loaded
+GPtrArray* sync_catalog_foreign_packages(PackageList *installed);
+
+// Names of the installed packages, kept next to the catalog so searches can
+// flag them without reading the local database per query. The set is built
+// once from a full list, then follows the changes reported by a
+// LocalDbWatcher.
+guint sync_catalog_installed_generation(void);
+// generation is sync_catalog_installed_generation(), taken before installed
+// was read. FALSE, leaving the set alone, if changes were reported since,
+// since installed may predate them.
+gboolean sync_catalog_set_installed(const PackageList *installed, guint generation);
+// removed holds char* names; either may be NULL
+void sync_catalog_update_installed(GPtrArray *removed, const PackageList *changed);
+// Sets the installed flag of every package in list; FALSE if the set is not
+// known yet
+gboolean sync_catalog_mark_installed(PackageList *list);
+
+#endif
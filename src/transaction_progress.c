@@ -0,0 +1,453 @@
+#include "transaction_progress.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STARTS_WITH(text, literal) (strncmp((text), (literal), sizeof(literal) - 1) == 0)
+
+// Share of the whole transaction given to each phase, as cumulative bounds
+static const double phase_start[] = {
+    [TRANSACTION_PHASE_NONE] = 0.0,
+    [TRANSACTION_PHASE_SYNCING] = 0.0,
+    [TRANSACTION_PHASE_RESOLVING] = 0.05,
+    [TRANSACTION_PHASE_DOWNLOADING] = 0.1,
+    [TRANSACTION_PHASE_CHECKING] = 0.45,
+    [TRANSACTION_PHASE_INSTALLING] = 0.55,
+    [TRANSACTION_PHASE_HOOKS] = 0.95
+};
+
+static const double phase_end[] = {
+    [TRANSACTION_PHASE_NONE] = 0.0,
+    [TRANSACTION_PHASE_SYNCING] = 0.05,
+    [TRANSACTION_PHASE_RESOLVING] = 0.1,
+    [TRANSACTION_PHASE_DOWNLOADING] = 0.45,
+    [TRANSACTION_PHASE_CHECKING] = 0.55,
+    [TRANSACTION_PHASE_INSTALLING] = 0.95,
+    [TRANSACTION_PHASE_HOOKS] = 1.0
+};
+
+struct TransactionProgress {
+    TransactionEventCallback callback;
+    gpointer user_data;
+
+    TransactionPhase phase;
+    int packages;               // From "Packages (N)", or -1
+    gint64 download_total;      // From "Total Download Size", or -1
+    int step;                   // Position within the current phase
+    int steps;
+    int step_percent;           // Of the current step, or -1
+    int check;                  // Of the checks pacman runs in order, or -1
+    gboolean pre_transaction;   // Hooks run before the package changes
+
+    // Latest byte count of each file, so a redrawn bar only adds its delta
+    GHashTable *file_bytes;
+    GString *key;               // Scratch copy of a name for lookups
+    gint64 downloaded;
+    int files_started;
+    double fraction;            // Never moves backwards
+};
+
+static const char* skip_spaces(const char *text) {
+    while (*text == ' ' || *text == '\t') text++;
+    return text;
+}
+
+// "12.3 MiB" or "4.5 KiB/s"; advances past the unit
+static double parse_size(const char **cursor) {
+    const char *text = skip_spaces(*cursor);
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text) return -1;
+
+    text = skip_spaces(end);
+    double scale = 1;
+    if (text[0] == 'K') scale = 1024.0;
+    else if (text[0] == 'M') scale = 1024.0 * 1024;
+    else if (text[0] == 'G') scale = 1024.0 * 1024 * 1024;
+    else if (text[0] == 'T') scale = 1024.0 * 1024 * 1024 * 1024;
+    else if (text[0] != 'B') return -1;
+
+    while (*text && *text != ' ') text++;
+    *cursor = text;
+    return value * scale;
+}
+
+// "mm:ss" or "hh:mm:ss"; "--:--" while unknown
+static int parse_eta(const char **cursor) {
+    const char *text = skip_spaces(*cursor);
+    int seconds = 0;
+    int fields = 0;
+
+    while (*text >= '0' && *text <= '9') {
+        char *end;
+        seconds = seconds * 60 + (int)strtol(text, &end, 10);
+        fields++;
+        text = end;
+        if (*text != ':') break;
+        text++;
+    }
+
+    while (*text && *text != ' ') text++;
+    *cursor = text;
+    return fields >= 2 ? seconds : -1;
+}
+
+// Percentage after the last "]" of a progress bar, or -1
+static int parse_bar_percent(const char *text, gsize length, const char **bar) {
+    const char *open = NULL;
+    for (const char *p = text + length; p > text; p--) {
+        if (p[-1] == '[') {
+            open = p - 1;
+            break;
+        }
+    }
+    if (!open) return -1;
+
+    const char *close = strchr(open, ']');
+    if (!close) return -1;
+
+    *bar = open;
+    return (int)strtol(skip_spaces(close + 1), NULL, 10);
+}
+
+static void emit(TransactionProgress *progress, TransactionEvent *event) {
+    event->phase = progress->phase;
+    if (progress->callback) progress->callback(event, progress->user_data);
+}
+
+static void set_phase(TransactionProgress *progress, TransactionPhase phase) {
+    if (phase == progress->phase) return;
+
+    progress->phase = phase;
+    progress->step = 0;
+    progress->steps = -1;
+    progress->step_percent = -1;
+    progress->check = -1;
+
+    // Database downloads while syncing don't count towards the packages
+    if (phase == TRANSACTION_PHASE_DOWNLOADING) {
+        g_hash_table_remove_all(progress->file_bytes);
+        progress->downloaded = 0;
+        progress->files_started = 0;
+    }
+
+    TransactionEvent event = { .type = TRANSACTION_EVENT_PHASE, .bytes = -1, .rate = -1, .eta = -1,
+                               .percent = -1, .step = 0, .steps = -1 };
+    emit(progress, &event);
+}
+
+static void emit_step(TransactionProgress *progress, const char *name, gsize name_length,
+                      int step, int steps, int percent) {
+    progress->step = step;
+    progress->steps = steps;
+    progress->step_percent = percent;
+
+    TransactionEvent event = { .type = TRANSACTION_EVENT_STEP, .name = name, .name_length = name_length,
+                               .bytes = -1, .rate = -1, .eta = -1, .percent = percent,
+                               .step = step, .steps = steps };
+    emit(progress, &event);
+}
+
+static void track_download(TransactionProgress *progress, const char *name, gsize name_length, gint64 bytes) {
+    g_string_truncate(progress->key, 0);
+    g_string_append_len(progress->key, name, name_length);
+    gint64 *previous = g_hash_table_lookup(progress->file_bytes, progress->key->str);
+
+    if (previous) {
+        if (bytes > *previous) {
+            progress->downloaded += bytes - *previous;
+            *previous = bytes;
+        }
+    } else {
+        progress->files_started++;
+        gint64 *current = g_new(gint64, 1);
+        *current = MAX(bytes, 0);
+        progress->downloaded += *current;
+        g_hash_table_insert(progress->file_bytes, g_strdup(progress->key->str), current);
+    }
+}
+
+// "name  9.9 MiB  10.5 MiB/s 00:01 [#####-----]  55%"
+static void parse_download_bar(TransactionProgress *progress, const char *text, gsize length) {
+    const char *bar;
+    int percent = parse_bar_percent(text, length, &bar);
+    if (percent < 0) return;
+
+    const char *name_end = text;
+    while (name_end < bar && *name_end != ' ') name_end++;
+
+    // The aggregate line of parallel downloads is not a file
+    if (name_end - text == 5 && STARTS_WITH(text, "Total")) return;
+
+    const char *cursor = name_end;
+    double bytes = parse_size(&cursor);
+    double rate = bytes >= 0 ? parse_size(&cursor) : -1;
+    int eta = rate >= 0 ? parse_eta(&cursor) : -1;
+    // A finished bar shows the time the download took instead
+    if (percent == 100 && eta >= 0) eta = 0;
+
+    if (progress->phase != TRANSACTION_PHASE_SYNCING) set_phase(progress, TRANSACTION_PHASE_DOWNLOADING);
+    track_download(progress, text, name_end - text, (gint64)bytes);
+
+    TransactionEvent event = { .type = TRANSACTION_EVENT_DOWNLOAD, .name = text, .name_length = name_end - text,
+                               .bytes = (gint64)bytes, .rate = rate, .eta = eta, .percent = percent,
+                               .step = 0, .steps = -1 };
+    emit(progress, &event);
+}
+
+// Word that starts a package step, in either output form
+static gboolean is_package_action(const char *text) {
+    return STARTS_WITH(text, "installing ") || STARTS_WITH(text, "upgrading ") ||
+           STARTS_WITH(text, "reinstalling ") || STARTS_WITH(text, "downgrading ") ||
+           STARTS_WITH(text, "removing ");
+}
+
+#define CHECK_COUNT 5
+
+// Position of a check message among the checks pacman runs before
+// changing packages, or -1. Their bars count packages in "(n/N)" but show
+// the progress of the whole check.
+static int check_index(const char *text) {
+    if (STARTS_WITH(text, "checking keyring") || STARTS_WITH(text, "checking keys")) return 0;
+    if (STARTS_WITH(text, "checking package integrity")) return 1;
+    if (STARTS_WITH(text, "loading package files")) return 2;
+    if (STARTS_WITH(text, "checking for file conflicts")) return 3;
+    if (STARTS_WITH(text, "checking available disk space")) return 4;
+    return -1;
+}
+
+static void set_check(TransactionProgress *progress, int check) {
+    set_phase(progress, TRANSACTION_PHASE_CHECKING);
+    if (check != progress->check) progress->step_percent = -1;
+    progress->check = check;
+}
+
+// "(3/9) installing foo  [####] 100%", "(1/4) checking keys in keyring ..."
+// or "(2/5) Arming ConditionNeedsUpdate..."
+static void parse_counted_line(TransactionProgress *progress, const char *text, gsize length) {
+    char *end;
+    int step = (int)strtol(text + 1, &end, 10);
+    if (*end != '/') return;
+    int steps = (int)strtol(end + 1, &end, 10);
+    if (*end != ')') return;
+
+    const char *rest = skip_spaces(end + 1);
+    const char *bar = text + length;
+    int percent = parse_bar_percent(text, length, &bar);
+    int check = check_index(rest);
+
+    if (is_package_action(rest)) {
+        set_phase(progress, TRANSACTION_PHASE_INSTALLING);
+        const char *name = strchr(rest, ' ') + 1;
+        const char *name_end = name;
+        while (name_end < bar && *name_end != ' ') name_end++;
+        emit_step(progress, name, name_end - name, step, steps, percent);
+    } else if (check >= 0) {
+        set_check(progress, check);
+        const char *name_end = bar;
+        while (name_end > rest && name_end[-1] == ' ') name_end--;
+        emit_step(progress, rest, name_end - rest, step, steps, percent);
+    } else if (progress->phase == TRANSACTION_PHASE_HOOKS) {
+        gsize name_length = text + length - rest;
+        emit_step(progress, rest, name_length, step, steps, -1);
+    }
+}
+
+static void parse_line(TransactionProgress *progress, const OutputLine *line) {
+    const char *text = skip_spaces(line->text);
+    gsize length = line->length - (text - line->text);
+    while (length > 0 && text[length - 1] == ' ') length--;
+    if (length == 0) return;
+
+    switch (text[0]) {
+    case ':':
+        if (STARTS_WITH(text, ":: Synchronizing package databases")) {
+            set_phase(progress, TRANSACTION_PHASE_SYNCING);
+        } else if (STARTS_WITH(text, ":: Starting full system upgrade")) {
+            set_phase(progress, TRANSACTION_PHASE_RESOLVING);
+        } else if (STARTS_WITH(text, ":: Retrieving packages")) {
+            set_phase(progress, TRANSACTION_PHASE_DOWNLOADING);
+        } else if (STARTS_WITH(text, ":: Processing package changes")) {
+            set_phase(progress, TRANSACTION_PHASE_INSTALLING);
+        } else if (STARTS_WITH(text, ":: Running pre-transaction hooks") ||
+                   STARTS_WITH(text, ":: Running post-transaction hooks")) {
+            // Pre- and post-transaction hooks each count from one
+            progress->pre_transaction = text[11] == 'p' && text[12] == 'r';
+            progress->phase = TRANSACTION_PHASE_NONE;
+            set_phase(progress, TRANSACTION_PHASE_HOOKS);
+        }
+        return;
+    case '(':
+        parse_counted_line(progress, text, length);
+        return;
+    case 'P':
+        if (STARTS_WITH(text, "Packages (")) progress->packages = atoi(text + sizeof("Packages (") - 1);
+        return;
+    case 'T':
+        if (STARTS_WITH(text, "Total Download Size:")) {
+            const char *cursor = text + sizeof("Total Download Size:") - 1;
+            progress->download_total = (gint64)parse_size(&cursor);
+            return;
+        }
+        break;
+    case 'r':
+        if (STARTS_WITH(text, "resolving dependencies")) {
+            set_phase(progress, TRANSACTION_PHASE_RESOLVING);
+            return;
+        }
+        break;
+    case 'l':
+        if (STARTS_WITH(text, "looking for conflicting packages")) {
+            set_phase(progress, TRANSACTION_PHASE_RESOLVING);
+            return;
+        }
+        break;
+    case 'c':
+        if (STARTS_WITH(text, "checking dependencies")) {
+            set_phase(progress, TRANSACTION_PHASE_RESOLVING);
+            return;
+        }
+        break;
+    }
+
+    int check = check_index(text);
+    if (check >= 0) {
+        set_check(progress, check);
+        return;
+    }
+
+    // Without a terminal pacman prints "installing foo..." per package and
+    // leaves the counting to us
+    if (is_package_action(text) && length > 3 && memcmp(text + length - 3, "...", 3) == 0) {
+        set_phase(progress, TRANSACTION_PHASE_INSTALLING);
+        const char *name = strchr(text, ' ') + 1;
+        emit_step(progress, name, text + length - 3 - name, progress->step + 1,
+                  progress->packages > 0 ? progress->packages : -1, -1);
+        return;
+    }
+
+    if (text[length - 1] == '%') {
+        parse_download_bar(progress, text, length);
+        return;
+    }
+
+    static const char downloading[] = " downloading...";
+    gsize suffix = sizeof(downloading) - 1;
+    if (length > suffix && memcmp(text + length - suffix, downloading, suffix) == 0) {
+        if (progress->phase != TRANSACTION_PHASE_SYNCING) set_phase(progress, TRANSACTION_PHASE_DOWNLOADING);
+        track_download(progress, text, length - suffix, -1);
+
+        TransactionEvent event = { .type = TRANSACTION_EVENT_DOWNLOAD, .name = text,
+                                   .name_length = length - suffix, .bytes = -1, .rate = -1, .eta = -1,
+                                   .percent = -1, .step = 0, .steps = -1 };
+        emit(progress, &event);
+    }
+}
+
+static double phase_fraction(const TransactionProgress *progress) {
+    switch (progress->phase) {
+    case TRANSACTION_PHASE_DOWNLOADING:
+        // Byte counts only come with the terminal progress bars
+        if (progress->download_total > 0 && progress->downloaded > 0) {
+            return (double)progress->downloaded / progress->download_total;
+        }
+        if (progress->packages > 0) {
+            // The newest file is still in flight
+            return (double)MAX(progress->files_started - 1, 0) / progress->packages;
+        }
+        return 0;
+    case TRANSACTION_PHASE_CHECKING: {
+        // Earlier checks are done, the current one as far as its bar
+        double done = MAX(progress->check, 0);
+        if (progress->step_percent > 0) done += progress->step_percent / 100.0;
+        return done / CHECK_COUNT;
+    }
+    case TRANSACTION_PHASE_INSTALLING:
+    case TRANSACTION_PHASE_HOOKS:
+        if (progress->steps > 0) {
+            double done = MAX(progress->step - 1, 0);
+            if (progress->step_percent > 0) done += progress->step_percent / 100.0;
+            return done / progress->steps;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+TransactionProgress* transaction_progress_new(TransactionEventCallback callback, gpointer user_data) {
+    TransactionProgress *progress = g_malloc0(sizeof(TransactionProgress));
+    progress->callback = callback;
+    progress->user_data = user_data;
+    progress->file_bytes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    progress->key = g_string_new(NULL);
+    transaction_progress_reset(progress);
+    return progress;
+}
+
+void transaction_progress_feed(TransactionProgress *progress, const OutputLine *lines, int count) {
+    for (int i = 0; i < count; i++) {
+        parse_line(progress, &lines[i]);
+    }
+
+    double within = CLAMP(phase_fraction(progress), 0.0, 1.0);
+    double fraction = phase_start[progress->phase] +
+                      (phase_end[progress->phase] - phase_start[progress->phase]) * within;
+    // Hooks before the package changes sit between checking and installing
+    if (progress->phase == TRANSACTION_PHASE_HOOKS && progress->pre_transaction) {
+        fraction = phase_start[TRANSACTION_PHASE_INSTALLING];
+    }
+
+    // Phases can be skipped or revisited (pre-transaction hooks); the
+    // estimate only ever grows
+    progress->fraction = MAX(progress->fraction, fraction);
+}
+
+TransactionPhase transaction_progress_phase(const TransactionProgress *progress) {
+    return progress->phase;
+}
+
+double transaction_progress_fraction(const TransactionProgress *progress) {
+    return progress->fraction;
+}
+
+const char* transaction_phase_name(TransactionPhase phase) {
+    switch (phase) {
+    case TRANSACTION_PHASE_SYNCING:
+        return "Synchronizing databases";
+    case TRANSACTION_PHASE_RESOLVING:
+        return "Resolving dependencies";
+    case TRANSACTION_PHASE_DOWNLOADING:
+        return "Downloading";
+    case TRANSACTION_PHASE_CHECKING:
+        return "Checking packages";
+    case TRANSACTION_PHASE_INSTALLING:
+        return "Installing";
+    case TRANSACTION_PHASE_HOOKS:
+        return "Running hooks";
+    default:
+        return "Starting";
+    }
+}
+
+void transaction_progress_reset(TransactionProgress *progress) {
+    progress->phase = TRANSACTION_PHASE_NONE;
+    progress->packages = -1;
+    progress->download_total = -1;
+    progress->step = 0;
+    progress->steps = -1;
+    progress->step_percent = -1;
+    progress->check = -1;
+    progress->pre_transaction = FALSE;
+    g_hash_table_remove_all(progress->file_bytes);
+    progress->downloaded = 0;
+    progress->files_started = 0;
+    progress->fraction = 0;
+}
+
+void transaction_progress_free(TransactionProgress *progress) {
+    if (!progress) return;
+
+    g_hash_table_destroy(progress->file_bytes);
+    g_string_free(progress->key, TRUE);
+    g_free(progress);
+}
@@ -0,0 +1,62 @@
+#ifndef TRANSACTION_PROGRESS_H
+#define TRANSACTION_PROGRESS_H
+
+#include <glib.h>
+#include "line_reader.h"
+
+// Follows a pacman transaction through its output and reports typed
+// events. Both output forms are understood: the plain messages pacman
+// prints into a pipe ("installing foo...") and the progress bars it draws
+// on a terminal ("(3/9) installing foo  [####] 100%", per-file download
+// bars with size, rate and ETA). Each line is classified by its first
+// characters and parsed in place; only the first sight of a downloaded file
+// allocates.
+
+typedef enum {
+    TRANSACTION_PHASE_NONE,
+    TRANSACTION_PHASE_SYNCING,      // Refreshing the sync databases
+    TRANSACTION_PHASE_RESOLVING,
+    TRANSACTION_PHASE_DOWNLOADING,
+    TRANSACTION_PHASE_CHECKING,     // Keyring, integrity, file conflicts, disk space
+    TRANSACTION_PHASE_INSTALLING,   // Also upgrades and removals
+    TRANSACTION_PHASE_HOOKS
+} TransactionPhase;
+
+typedef enum {
+    TRANSACTION_EVENT_PHASE,        // phase changed
+    TRANSACTION_EVENT_DOWNLOAD,     // Progress of one file
+    TRANSACTION_EVENT_STEP          // Package or hook step of the current phase
+} TransactionEventType;
+
+typedef struct {
+    TransactionEventType type;
+    TransactionPhase phase;
+    const char *name;       // File, package or hook; only valid during the callback
+    gsize name_length;
+    // TRANSACTION_EVENT_DOWNLOAD; unknown values are -1
+    gint64 bytes;           // Transferred so far
+    double rate;            // Bytes per second
+    int eta;                // Seconds
+    // Both kinds
+    int percent;
+    // TRANSACTION_EVENT_STEP: "(step/steps)", steps -1 if unknown
+    int step;
+    int steps;
+} TransactionEvent;
+
+typedef void (*TransactionEventCallback)(const TransactionEvent *event, gpointer user_data);
+
+typedef struct TransactionProgress TransactionProgress;
+
+TransactionProgress* transaction_progress_new(TransactionEventCallback callback, gpointer user_data);
+// Events are reported from within the call
+void transaction_progress_feed(TransactionProgress *progress, const OutputLine *lines, int count);
+TransactionPhase transaction_progress_phase(const TransactionProgress *progress);
+// Estimate of the whole transaction between 0 and 1, from the phase and
+// the position within it as of the last feed
+double transaction_progress_fraction(const TransactionProgress *progress);
+const char* transaction_phase_name(TransactionPhase phase);
+void transaction_progress_reset(TransactionProgress *progress);
+void transaction_progress_free(TransactionProgress *progress);
+
+#endif
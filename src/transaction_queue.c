@@ -0,0 +1,249 @@
+#include "transaction_queue.h"
+#include <stdio.h>
+#include <string.h>
+
+#define QUEUE_ACTION_COUNT 3
+
+typedef struct {
+    char *name;
+    QueueAction action;
+} StagedPackage;
+
+struct TransactionQueue {
+    LogCallback callback;
+    QueueBatchCallback on_batch;
+    gpointer user_data;
+    GPtrArray *staged;      // StagedPackage, in staging order
+
+    // The run in progress: package names per action, applied in enum order
+    GPtrArray *batches[QUEUE_ACTION_COUNT];
+    int current;
+    gboolean running;
+    gboolean freed;         // Freed while running; dropped when the batch ends
+};
+
+static void free_staged_package(gpointer data) {
+    StagedPackage *package = (StagedPackage*)data;
+    g_free(package->name);
+    g_free(package);
+}
+
+static int find_staged(const TransactionQueue *queue, const char *name) {
+    for (guint i = 0; i < queue->staged->len; i++) {
+        StagedPackage *package = g_ptr_array_index(queue->staged, i);
+        if (strcmp(package->name, name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static void log_line(TransactionQueue *queue, const char *text) {
+    if (!queue->callback) return;
+
+    OutputLine line = { text, strlen(text), FALSE };
+    queue->callback(&line, 1, queue->user_data);
+}
+
+static void on_queue_lines(const OutputLine *lines, int count, gpointer user_data) {
+    TransactionQueue *queue = (TransactionQueue*)user_data;
+    if (!queue->freed && queue->callback) queue->callback(lines, count, queue->user_data);
+}
+
+static void release_batches(TransactionQueue *queue) {
+    for (int i = 0; i < QUEUE_ACTION_COUNT; i++) {
+        if (queue->batches[i]) g_ptr_array_free(queue->batches[i], TRUE);
+        queue->batches[i] = NULL;
+    }
+}
+
+static int remaining_batches(const TransactionQueue *queue, int from) {
+    int remaining = 0;
+    for (int i = from; i < QUEUE_ACTION_COUNT; i++) {
+        if (queue->batches[i]->len > 0) remaining++;
+    }
+    return remaining;
+}
+
+static void finish_run(TransactionQueue *queue) {
+    release_batches(queue);
+    queue->running = FALSE;
+    log_line(queue, "__OPERATION_FINISHED__");
+}
+
+static void on_batch_done(gboolean success, gpointer user_data);
+
+static gboolean start_batch(TransactionQueue *queue, QueueAction action) {
+    GPtrArray *names = queue->batches[action];
+    const char *const *list = (const char *const *)names->pdata;
+
+    switch (action) {
+    case QUEUE_ACTION_REMOVE:
+        return pacman_remove_packages_async(list, names->len, on_queue_lines, on_batch_done, queue);
+    case QUEUE_ACTION_INSTALL:
+        return pacman_install_packages_async(list, names->len, on_queue_lines, on_batch_done, queue);
+    case QUEUE_ACTION_INSTALL_AUR:
+        return aur_install_packages_async(list, names->len, on_queue_lines, on_batch_done, queue);
+    }
+    return FALSE;
+}
+
+// Starts the next non-empty batch from queue->current on; FALSE if none
+// could be started
+static gboolean start_next_batch(TransactionQueue *queue) {
+    static const char *const verbs[] = { "Removing", "Installing", "Building and installing" };
+
+    for (; queue->current < QUEUE_ACTION_COUNT; queue->current++) {
+        GPtrArray *names = queue->batches[queue->current];
+        if (names->len == 0) continue;
+
+        if (!start_batch(queue, (QueueAction)queue->current)) return FALSE;
+
+        int batches = remaining_batches(queue, 0);
+        int batch = batches - remaining_batches(queue, queue->current) + 1;
+        if (queue->on_batch) {
+            queue->on_batch((QueueAction)queue->current, names->len, batch, batches, queue->user_data);
+        }
+
+        // Output arrives from the main loop, so the heading still comes first
+        GString *heading = g_string_new("=== ");
+        g_string_append_printf(heading, "%s %u package%s:", verbs[queue->current], names->len,
+                               names->len == 1 ? "" : "s");
+        for (guint i = 0; i < names->len; i++) {
+            g_string_append_c(heading, ' ');
+            g_string_append(heading, g_ptr_array_index(names, i));
+        }
+        g_string_append(heading, " ===");
+        log_line(queue, heading->str);
+        g_string_free(heading, TRUE);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void on_batch_done(gboolean success, gpointer user_data) {
+    TransactionQueue *queue = (TransactionQueue*)user_data;
+
+    if (queue->freed) {
+        release_batches(queue);
+        g_ptr_array_free(queue->staged, TRUE);
+        g_free(queue);
+        return;
+    }
+
+    queue->current++;
+    int remaining = remaining_batches(queue, queue->current);
+    if (remaining == 0) {
+        finish_run(queue);
+        return;
+    }
+
+    if (success && start_next_batch(queue)) return;
+
+    char message[128];
+    snprintf(message, sizeof(message), "=== %s, skipping %d remaining transaction%s ===",
+             success ? "Failed to start the next transaction" : "Transaction failed",
+             remaining, remaining == 1 ? "" : "s");
+    log_line(queue, message);
+    finish_run(queue);
+}
+
+TransactionQueue* transaction_queue_new(LogCallback callback, QueueBatchCallback on_batch, gpointer user_data) {
+    TransactionQueue *queue = g_malloc0(sizeof(TransactionQueue));
+    queue->callback = callback;
+    queue->on_batch = on_batch;
+    queue->user_data = user_data;
+    queue->staged = g_ptr_array_new_with_free_func(free_staged_package);
+    return queue;
+}
+
+void transaction_queue_stage(TransactionQueue *queue, const char *name, QueueAction action) {
+    int index = find_staged(queue, name);
+    if (index >= 0) {
+        StagedPackage *package = g_ptr_array_index(queue->staged, index);
+        package->action = action;
+        return;
+    }
+
+    StagedPackage *package = g_malloc(sizeof(StagedPackage));
+    package->name = g_strdup(name);
+    package->action = action;
+    g_ptr_array_add(queue->staged, package);
+}
+
+gboolean transaction_queue_unstage(TransactionQueue *queue, const char *name) {
+    int index = find_staged(queue, name);
+    if (index < 0) return FALSE;
+
+    g_ptr_array_remove_index(queue->staged, index);
+    return TRUE;
+}
+
+void transaction_queue_clear(TransactionQueue *queue) {
+    g_ptr_array_set_size(queue->staged, 0);
+}
+
+int transaction_queue_count(const TransactionQueue *queue) {
+    return (int)queue->staged->len;
+}
+
+char* transaction_queue_describe(const TransactionQueue *queue) {
+    static const char *const labels[] = { "Remove", "Install", "Install from AUR" };
+    GString *text = g_string_new(NULL);
+
+    for (int action = 0; action < QUEUE_ACTION_COUNT; action++) {
+        gboolean first = TRUE;
+        for (guint i = 0; i < queue->staged->len; i++) {
+            StagedPackage *package = g_ptr_array_index(queue->staged, i);
+            if ((int)package->action != action) continue;
+
+            if (first) {
+                if (text->len > 0) g_string_append_c(text, '\n');
+                g_string_append_printf(text, "%s: ", labels[action]);
+                first = FALSE;
+            } else {
+                g_string_append(text, ", ");
+            }
+            g_string_append(text, package->name);
+        }
+    }
+    return g_string_free(text, FALSE);
+}
+
+gboolean transaction_queue_is_running(const TransactionQueue *queue) {
+    return queue->running;
+}
+
+gboolean transaction_queue_run(TransactionQueue *queue) {
+    if (queue->running || queue->staged->len == 0) return FALSE;
+
+    for (int i = 0; i < QUEUE_ACTION_COUNT; i++) {
+        queue->batches[i] = g_ptr_array_new_with_free_func(g_free);
+    }
+    for (guint i = 0; i < queue->staged->len; i++) {
+        StagedPackage *package = g_ptr_array_index(queue->staged, i);
+        g_ptr_array_add(queue->batches[package->action], g_strdup(package->name));
+    }
+
+    queue->current = 0;
+    queue->running = TRUE;
+    if (!start_next_batch(queue)) {
+        // Nothing ran; keep everything staged for another try
+        release_batches(queue);
+        queue->running = FALSE;
+        return FALSE;
+    }
+
+    g_ptr_array_set_size(queue->staged, 0);
+    return TRUE;
+}
+
+void transaction_queue_free(TransactionQueue *queue) {
+    if (!queue) return;
+
+    if (queue->running) {
+        queue->freed = TRUE;
+        return;
+    }
+    release_batches(queue);
+    g_ptr_array_free(queue->staged, TRUE);
+    g_free(queue);
+}
@@ -0,0 +1,43 @@
+#ifndef TRANSACTION_QUEUE_H
+#define TRANSACTION_QUEUE_H
+
+#include "pacman_wrapper.h"
+
+typedef enum {
+    QUEUE_ACTION_REMOVE,
+    QUEUE_ACTION_INSTALL,
+    QUEUE_ACTION_INSTALL_AUR    // Built and installed by the AUR helper
+} QueueAction;
+
+// Called as each merged transaction starts, before its output. batch counts
+// from 1 to batches.
+typedef void (*QueueBatchCallback)(QueueAction action, int count, int batch, int batches, gpointer user_data);
+
+// Staged package operations, applied as few transactions as possible. A run
+// merges every staged removal into one `pacman -R`, every repository install
+// into one `pacman -S` and every AUR install into one helper call, and runs
+// them one after another in that order, so a package can be swapped for a
+// conflicting one in a single run. If a transaction fails, the rest are
+// skipped. Output goes to the log callback, followed by the
+// "__OPERATION_FINISHED__" marker once the whole run is over.
+typedef struct TransactionQueue TransactionQueue;
+
+// on_batch may be NULL
+TransactionQueue* transaction_queue_new(LogCallback callback, QueueBatchCallback on_batch, gpointer user_data);
+// A package is staged at most once; staging it again replaces its action.
+// Packages staged while a run is going on wait for the next run.
+void transaction_queue_stage(TransactionQueue *queue, const char *name, QueueAction action);
+gboolean transaction_queue_unstage(TransactionQueue *queue, const char *name);
+void transaction_queue_clear(TransactionQueue *queue);
+int transaction_queue_count(const TransactionQueue *queue);
+// Staged packages by action, e.g. "Remove: a\nInstall: b, c"; caller frees
+char* transaction_queue_describe(const TransactionQueue *queue);
+gboolean transaction_queue_is_running(const TransactionQueue *queue);
+// Starts applying everything staged. FALSE if nothing is staged, a run is
+// already going on or the first transaction could not be started.
+gboolean transaction_queue_run(TransactionQueue *queue);
+// The transaction in progress finishes in the background without calling
+// back; the rest of the run is dropped
+void transaction_queue_free(TransactionQueue *queue);
+
+#endif
@@ -1,10 +1,229 @@
 #include "dependency_viewer.h"
 #include <math.h>
 
+// Fill colours of root, missing and ordinary nodes
+static const double node_colors[3][3] = {
+    { 0.2, 0.8, 0.2 },
+    { 1.0, 0.75, 0.7 },
+    { 0.7, 0.9, 1.0 }
+};
+
+static int node_style(const GraphLayoutNode *node) {
+    if (node->flags & GRAPH_NODE_ROOT) return 0;
+    if (node->flags & GRAPH_NODE_MISSING) return 1;
+    return 2;
+}
+
+// Tiles are square in device-independent pixels at the current scale
+#define TILE_SIZE 256
+// Beyond this many cached tiles, the ones out of view are dropped
+#define TILE_CACHE_MAX 160
+#define ZOOM_MIN 0.05
+#define ZOOM_MAX 4.0
+// Wheel zoom factor per scroll step
+#define ZOOM_STEP 1.15
+
+// Satisfied, unsatisfied and conflict edges, matching the GraphEdgeFlags
+static const double edge_colors[3][3] = {
+    { 0.0, 0.0, 0.0 },
+    { 0.85, 0.1, 0.1 },
+    { 0.9, 0.45, 0.0 }
+};
+
+static int edge_style(const GraphLayoutEdge *edge) {
+    if (edge->flags & GRAPH_EDGE_CONFLICT) return 2;
+    if (edge->flags & GRAPH_EDGE_UNSATISFIED) return 1;
+    return 0;
+}
+
+// Draws the given items only; everything of one kind goes into a single
+// path so cairo strokes or fills it once
+static void draw_layout_items(cairo_t *cr, GraphLayout *layout, GArray *nodes, GArray *edges) {
+    const GraphLayoutMetrics *metrics = &layout->metrics;
+    static const double conflict_dash[] = { 4.0, 3.0 };
+
+    cairo_set_line_width(cr, 1.0);
+    for (int style = 0; style < 3; style++) {
+        for (guint i = 0; i < edges->len; i++) {
+            const GraphLayoutEdge *edge = &layout->edges[g_array_index(edges, int, i)];
+            if (edge_style(edge) != style) continue;
+
+            cairo_move_to(cr, edge->x1, edge->y1);
+            cairo_line_to(cr, edge->x2, edge->y2);
+
+            cairo_move_to(cr, edge->x2 - 5, edge->y2 - 3);
+            cairo_line_to(cr, edge->x2, edge->y2);
+            cairo_line_to(cr, edge->x2 - 5, edge->y2 + 3);
+        }
+        cairo_set_source_rgb(cr, edge_colors[style][0], edge_colors[style][1], edge_colors[style][2]);
+        cairo_set_dash(cr, conflict_dash, style == 2 ? 2 : 0, 0);
+        cairo_stroke(cr);
+    }
+    cairo_set_dash(cr, NULL, 0, 0);
+
+    // Unmet constraints are labelled with the dependency as written
+    cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 9);
+    cairo_set_source_rgb(cr, edge_colors[1][0], edge_colors[1][1], edge_colors[1][2]);
+    for (guint i = 0; i < edges->len; i++) {
+        const GraphLayoutEdge *edge = &layout->edges[g_array_index(edges, int, i)];
+        if (!edge->spec) continue;
+
+        cairo_text_extents_t extents;
+        cairo_text_extents(cr, edge->spec, &extents);
+        cairo_move_to(cr, edge->x2 - extents.x_advance - 8, edge->y2 - 4);
+        cairo_show_text(cr, edge->spec);
+    }
+
+    for (int style = 0; style < 3; style++) {
+        for (guint i = 0; i < nodes->len; i++) {
+            const GraphLayoutNode *node = &layout->nodes[g_array_index(nodes, int, i)];
+            if (node_style(node) != style) continue;
+            cairo_rectangle(cr, node->x, node->y, metrics->node_width, metrics->node_height);
+        }
+        cairo_set_source_rgb(cr, node_colors[style][0], node_colors[style][1], node_colors[style][2]);
+        cairo_fill(cr);
+    }
+
+    // Packages that conflict with something installed get a heavier outline
+    for (int conflict = 0; conflict < 2; conflict++) {
+        for (guint i = 0; i < nodes->len; i++) {
+            const GraphLayoutNode *node = &layout->nodes[g_array_index(nodes, int, i)];
+            if (((node->flags & GRAPH_NODE_CONFLICT) != 0) != conflict) continue;
+            cairo_rectangle(cr, node->x, node->y, metrics->node_width, metrics->node_height);
+        }
+        const double *color = edge_colors[conflict ? 2 : 0];
+        cairo_set_source_rgb(cr, color[0], color[1], color[2]);
+        cairo_set_line_width(cr, conflict ? 2.5 : 1.0);
+        cairo_stroke(cr);
+    }
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+
+    cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 10);
+
+    for (guint i = 0; i < nodes->len; i++) {
+        const GraphLayoutNode *node = &layout->nodes[g_array_index(nodes, int, i)];
+        cairo_move_to(cr, node->x + node->label_x, node->y + node->label_y);
+        cairo_show_text(cr, node->name);
+    }
+}
+
+// Places every node label and finds how far any label reaches past the
+// box the spatial index has for its item: node names wider than their box
+// overhang both sides, and spec labels sit left of and above the arrowhead,
+// beyond a short edge's start. Text is measured in layout units, so this is
+// done once per layout rather than per scale.
+static void measure_labels(DependencyViewer *viewer) {
+    GraphLayout *layout = viewer->layout;
+    const GraphLayoutMetrics *metrics = &layout->metrics;
+
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 1, 1);
+    cairo_t *cr = cairo_create(surface);
+    cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+
+    // Arrowheads reach 3 above and below the edge end, conflict outlines
+    // half their width past the box
+    double pad_x = 1.25;
+    double pad_y = 3;
+
+    cairo_set_font_size(cr, 10);
+    for (int i = 0; i < layout->n_nodes; i++) {
+        GraphLayoutNode *node = &layout->nodes[i];
+        cairo_text_extents_t extents;
+        cairo_text_extents(cr, node->name, &extents);
+        node->label_x = (metrics->node_width - extents.width) / 2;
+        node->label_y = metrics->node_height / 2 + extents.height / 2;
+
+        pad_x = MAX(pad_x, -(node->label_x + extents.x_bearing));
+        pad_x = MAX(pad_x, node->label_x + extents.x_bearing + extents.width - metrics->node_width);
+    }
+
+    cairo_set_font_size(cr, 9);
+    cairo_font_extents_t font;
+    cairo_font_extents(cr, &font);
+    for (int i = 0; i < layout->n_edges; i++) {
+        const GraphLayoutEdge *edge = &layout->edges[i];
+        if (!edge->spec) continue;
+
+        // Drawn from x2 - x_advance - 8 on a baseline 4 above y2
+        cairo_text_extents_t extents;
+        cairo_text_extents(cr, edge->spec, &extents);
+        double left = edge->x2 - extents.x_advance - 8 + MIN(0, extents.x_bearing);
+        pad_x = MAX(pad_x, MIN(edge->x1, edge->x2) - left);
+        pad_y = MAX(pad_y, MIN(edge->y1, edge->y2) - (edge->y2 - 4 - font.ascent));
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+
+    // A pixel of slack for hinting at other scales
+    viewer->label_pad_x = ceil(pad_x) + 1;
+    viewer->label_pad_y = ceil(pad_y) + 1;
+}
+
+static gint64 tile_key(int column, int row) {
+    return ((gint64)row << 32) | (guint32)column;
+}
+
+static void clear_tiles(DependencyViewer *viewer) {
+    g_hash_table_remove_all(viewer->tiles);
+}
+
+// Renders one tile of the layout at the current scale. Only items the
+// spatial index places in the tile are drawn.
+static cairo_surface_t* render_tile(DependencyViewer *viewer, int column, int row, int scale_factor) {
+    GraphLayout *layout = viewer->layout;
+    double span = TILE_SIZE / viewer->scale;
+    double x0 = column * span;
+    double y0 = row * span;
+
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+                                                          TILE_SIZE * scale_factor, TILE_SIZE * scale_factor);
+    cairo_surface_set_device_scale(surface, scale_factor, scale_factor);
+
+    cairo_t *cr = cairo_create(surface);
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_paint(cr);
+    cairo_scale(cr, viewer->scale, viewer->scale);
+    cairo_translate(cr, -x0, -y0);
+
+    // Labels may run past the boxes the spatial index knows
+    double pad_x = viewer->label_pad_x;
+    double pad_y = viewer->label_pad_y;
+    graph_layout_query(layout, x0 - pad_x, y0 - pad_y, x0 + span + pad_x, y0 + span + pad_y,
+                       viewer->visible_nodes, viewer->visible_edges);
+    draw_layout_items(cr, layout, viewer->visible_nodes, viewer->visible_edges);
+
+    cairo_destroy(cr);
+    return surface;
+}
+
+// Keeps the cache bounded while panning across a large graph
+static void prune_tiles(DependencyViewer *viewer, int c0, int r0, int c1, int r1) {
+    if (g_hash_table_size(viewer->tiles) <= TILE_CACHE_MAX) return;
+
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, viewer->tiles);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        gint64 packed = *(gint64*)key;
+        int row = (int)(packed >> 32);
+        int column = (int)(guint32)packed;
+        if (column < c0 || column > c1 || row < r0 || row > r1) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+// Composites cached tiles covering the visible part of the layout. A tile
+// is rendered once per layout and scale, so panning only blits surfaces.
 static void draw_dependency_graph(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data) {
     DependencyViewer *viewer = (DependencyViewer*)user_data;
-    
-    if (!viewer->current_tree || viewer->current_tree->count == 0) {
+    GraphLayout *layout = viewer->layout;
+
+    if (!layout || layout->n_nodes == 0) {
         cairo_set_source_rgb(cr, 0.5, 0.5, 0.5);
         cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 14);
@@ -12,89 +231,240 @@ static void draw_dependency_graph(GtkDrawingArea *area, cairo_t *cr, int width,
         cairo_show_text(cr, "No dependency data to display");
         return;
     }
-    
+
     cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
     cairo_paint(cr);
-    
-    int levels[10] = {0};
-    for (int i = 0; i < viewer->current_tree->count; i++) {
-        if (viewer->current_tree->nodes[i].depth < 10) {
-            levels[viewer->current_tree->nodes[i].depth]++;
-        }
+
+    if (viewer->tiles_scale != viewer->scale) {
+        clear_tiles(viewer);
+        viewer->tiles_scale = viewer->scale;
     }
-    
-    cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 10);
-    
-    for (int i = 0; i < viewer->current_tree->count; i++) {
-        DependencyNode *node = &viewer->current_tree->nodes[i];
-        if (node->depth >= 10) continue;
-        
-        int level_count = levels[node->depth];
-        int node_index = 0;
-        for (int j = 0; j < i; j++) {
-            if (viewer->current_tree->nodes[j].depth == node->depth) {
-                node_index++;
+
+    double span = TILE_SIZE / viewer->scale;
+    int max_column = (int)(layout->width / span);
+    int max_row = (int)(layout->height / span);
+    int c0 = MAX(0, (int)floor(viewer->offset_x / span));
+    int r0 = MAX(0, (int)floor(viewer->offset_y / span));
+    int c1 = MIN(max_column, (int)floor((viewer->offset_x + width / viewer->scale) / span));
+    int r1 = MIN(max_row, (int)floor((viewer->offset_y + height / viewer->scale) / span));
+
+    prune_tiles(viewer, c0, r0, c1, r1);
+
+    int scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(area));
+    // Whole pixels, so adjacent tiles meet without seams
+    double origin_x = round(viewer->offset_x * viewer->scale);
+    double origin_y = round(viewer->offset_y * viewer->scale);
+
+    for (int row = r0; row <= r1; row++) {
+        for (int column = c0; column <= c1; column++) {
+            gint64 key = tile_key(column, row);
+            cairo_surface_t *tile = g_hash_table_lookup(viewer->tiles, &key);
+            if (!tile) {
+                tile = render_tile(viewer, column, row, scale_factor);
+                g_hash_table_insert(viewer->tiles, g_memdup2(&key, sizeof(key)), tile);
             }
+            cairo_set_source_surface(cr, tile, column * TILE_SIZE - origin_x, row * TILE_SIZE - origin_y);
+            cairo_paint(cr);
         }
-        
-        int x = 50 + node->depth * viewer->level_spacing;
-        int y = 50 + node_index * viewer->node_spacing + (height - level_count * viewer->node_spacing) / 2;
-        
-        if (node->depth == 0) {
-            cairo_set_source_rgb(cr, 0.2, 0.8, 0.2);
+    }
+}
+
+static void fit_layout(DependencyViewer *viewer) {
+    GraphLayout *layout = viewer->layout;
+    int width = gtk_widget_get_width(viewer->drawing_area);
+    int height = gtk_widget_get_height(viewer->drawing_area);
+    if (!layout || width <= 0 || height <= 0) return;
+
+    // Small graphs keep their natural size; large ones shrink to fit
+    double scale = MIN(1.0, MIN(width / layout->width, height / layout->height));
+    viewer->scale = CLAMP(scale, ZOOM_MIN, ZOOM_MAX);
+    viewer->offset_x = 0;
+    viewer->offset_y = 0;
+    viewer->fit_pending = FALSE;
+}
+
+static void on_drawing_area_resize(GtkDrawingArea *area, int width, int height, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    if (viewer->fit_pending) fit_layout(viewer);
+}
+
+// Tiles hold device pixels, so a move to a monitor with another scale
+// factor needs them all rendered again
+static void on_scale_factor_changed(GObject *object, GParamSpec *pspec, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    clear_tiles(viewer);
+    gtk_widget_queue_draw(viewer->drawing_area);
+}
+
+// Changes the scale keeping the layout point under (x, y) in place
+static void zoom_at(DependencyViewer *viewer, double scale, double x, double y) {
+    scale = CLAMP(scale, ZOOM_MIN, ZOOM_MAX);
+    if (scale == viewer->scale) return;
+
+    double layout_x = viewer->offset_x + x / viewer->scale;
+    double layout_y = viewer->offset_y + y / viewer->scale;
+    viewer->scale = scale;
+    viewer->offset_x = layout_x - x / scale;
+    viewer->offset_y = layout_y - y / scale;
+    gtk_widget_queue_draw(viewer->drawing_area);
+}
+
+static void on_pointer_motion(GtkEventControllerMotion *controller, double x, double y, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    viewer->pointer_x = x;
+    viewer->pointer_y = y;
+}
+
+static gboolean on_scroll(GtkEventControllerScroll *controller, double dx, double dy, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    if (!viewer->layout || dy == 0) return FALSE;
+
+    viewer->view_touched = TRUE;
+    zoom_at(viewer, viewer->scale * pow(ZOOM_STEP, -dy), viewer->pointer_x, viewer->pointer_y);
+    return TRUE;
+}
+
+static void on_drag_begin(GtkGestureDrag *gesture, double x, double y, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    viewer->view_touched = TRUE;
+    viewer->drag_start_x = viewer->offset_x;
+    viewer->drag_start_y = viewer->offset_y;
+}
+
+static void on_drag_update(GtkGestureDrag *gesture, double dx, double dy, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    viewer->offset_x = viewer->drag_start_x - dx / viewer->scale;
+    viewer->offset_y = viewer->drag_start_y - dy / viewer->scale;
+    gtk_widget_queue_draw(viewer->drawing_area);
+}
+
+static void on_zoom_begin(GtkGesture *gesture, GdkEventSequence *sequence, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    viewer->view_touched = TRUE;
+    viewer->zoom_start_scale = viewer->scale;
+}
+
+static void on_zoom_scale_changed(GtkGestureZoom *gesture, double scale, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    double x, y;
+    if (!gtk_gesture_get_bounding_box_center(GTK_GESTURE(gesture), &x, &y)) return;
+    zoom_at(viewer, viewer->zoom_start_scale * scale, x, y);
+}
+
+static void set_layout(DependencyViewer *viewer, GraphLayout *layout) {
+    clear_tiles(viewer);
+    graph_layout_free(viewer->layout);
+    viewer->layout = layout;
+    if (layout) measure_labels(viewer);
+
+    // Deeper levels replace the layout while the user may be looking
+    // around; only views left alone follow the growing graph
+    if (!viewer->view_touched) {
+        viewer->fit_pending = TRUE;
+        fit_layout(viewer);
+    }
+    gtk_widget_queue_draw(viewer->drawing_area);
+}
+
+static double build_rate(DependencyViewer *viewer) {
+    if (viewer->build_elapsed <= 0) return 0;
+    return viewer->build_nodes / (viewer->build_elapsed / (double)G_USEC_PER_SEC);
+}
+
+static void update_build_status(DependencyViewer *viewer) {
+    char status[256];
+
+    if (!viewer->build_finished) {
+        snprintf(status, sizeof(status), "Building dependency tree: depth %d, %d packages (%.0f nodes/s)",
+                 viewer->build_depth, viewer->build_nodes, build_rate(viewer));
+    } else if (viewer->layout_cancellable) {
+        snprintf(status, sizeof(status), "Found %d packages (%.0f nodes/s), laying out dependency graph...",
+                 viewer->build_nodes, build_rate(viewer));
+    } else if (viewer->layout && (viewer->layout->unsatisfied > 0 || viewer->layout->conflicts > 0)) {
+        snprintf(status, sizeof(status),
+                 "Found %d packages in dependency tree (%.0f nodes/s): %d unmet dependencies, %d conflicts",
+                 viewer->build_nodes, build_rate(viewer), viewer->layout->unsatisfied, viewer->layout->conflicts);
+    } else {
+        snprintf(status, sizeof(status), "Found %d packages in dependency tree (%.0f nodes/s)",
+                 viewer->build_nodes, build_rate(viewer));
+    }
+    gtk_label_set_text(GTK_LABEL(viewer->status_label), status);
+}
+
+static void on_layout_ready(GraphLayout *layout, gpointer user_data);
+
+// Positions are computed once per tree, off the GTK thread
+static void start_layout(DependencyViewer *viewer, DependencyTree *tree) {
+    GraphLayoutMetrics metrics = {
+        .node_width = viewer->node_width,
+        .node_height = viewer->node_height,
+        .level_spacing = viewer->level_spacing,
+        .node_spacing = viewer->node_spacing,
+        .margin = 50
+    };
+    viewer->layout_cancellable = g_cancellable_new();
+    graph_layout_new_async(tree, &metrics, viewer->layout_cancellable, on_layout_ready, viewer);
+}
+
+static void on_layout_ready(GraphLayout *layout, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+
+    g_clear_object(&viewer->layout_cancellable);
+    set_layout(viewer, layout);
+
+    // Levels that arrived meanwhile collapse into the newest one
+    if (viewer->pending_tree) {
+        start_layout(viewer, viewer->pending_tree);
+        viewer->pending_tree = NULL;
+    }
+    update_build_status(viewer);
+}
+
+static void cancel_layout(DependencyViewer *viewer) {
+    if (viewer->layout_cancellable) {
+        g_cancellable_cancel(viewer->layout_cancellable);
+        g_clear_object(&viewer->layout_cancellable);
+    }
+}
+
+// Stops the tree walk and any layout of its levels
+static void cancel_build(DependencyViewer *viewer) {
+    if (viewer->build_cancellable) {
+        g_cancellable_cancel(viewer->build_cancellable);
+        g_clear_object(&viewer->build_cancellable);
+    }
+    cancel_layout(viewer);
+    dependency_tree_free(viewer->pending_tree);
+    viewer->pending_tree = NULL;
+}
+
+static void on_tree_level(DependencyTree *tree, int depth, gboolean finished, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+
+    if (tree) {
+        viewer->build_nodes = tree->count;
+        viewer->build_depth = depth;
+        viewer->build_elapsed = g_get_monotonic_time() - viewer->build_started;
+
+        if (viewer->layout_cancellable) {
+            dependency_tree_free(viewer->pending_tree);
+            viewer->pending_tree = tree;
         } else {
-            cairo_set_source_rgb(cr, 0.7, 0.9, 1.0);
+            start_layout(viewer, tree);
         }
-        
-        cairo_rectangle(cr, x, y, viewer->node_width, viewer->node_height);
-        cairo_fill(cr);
-        
-        cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
-        cairo_rectangle(cr, x, y, viewer->node_width, viewer->node_height);
-        cairo_stroke(cr);
-        
-        cairo_text_extents_t extents;
-        cairo_text_extents(cr, node->name, &extents);
-        
-        int text_x = x + (viewer->node_width - extents.width) / 2;
-        int text_y = y + viewer->node_height / 2 + extents.height / 2;
-        
-        cairo_move_to(cr, text_x, text_y);
-        cairo_show_text(cr, node->name);
-        
-        if (node->depends) {
-            for (int j = 0; j < node->depends->count; j++) {
-                for (int k = 0; k < viewer->current_tree->count; k++) {
-                    DependencyNode *dep_node = &viewer->current_tree->nodes[k];
-                    if (strcmp(dep_node->name, node->depends->dependencies[j]) == 0) {
-                        int dep_level_count = levels[dep_node->depth];
-                        int dep_node_index = 0;
-                        for (int l = 0; l < k; l++) {
-                            if (viewer->current_tree->nodes[l].depth == dep_node->depth) {
-                                dep_node_index++;
-                            }
-                        }
-                        
-                        int dep_x = 50 + dep_node->depth * viewer->level_spacing;
-                        int dep_y = 50 + dep_node_index * viewer->node_spacing + (height - dep_level_count * viewer->node_spacing) / 2;
-                        
-                        cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
-                        cairo_set_line_width(cr, 1.0);
-                        cairo_move_to(cr, x + viewer->node_width, y + viewer->node_height / 2);
-                        cairo_line_to(cr, dep_x, dep_y + viewer->node_height / 2);
-                        cairo_stroke(cr);
-                        
-                        cairo_move_to(cr, dep_x - 5, dep_y + viewer->node_height / 2 - 3);
-                        cairo_line_to(cr, dep_x, dep_y + viewer->node_height / 2);
-                        cairo_line_to(cr, dep_x - 5, dep_y + viewer->node_height / 2 + 3);
-                        cairo_stroke(cr);
-                        break;
-                    }
-                }
-            }
+    }
+
+    if (finished) {
+        g_clear_object(&viewer->build_cancellable);
+        viewer->build_finished = TRUE;
+
+        if (viewer->build_nodes == 0) {
+            set_layout(viewer, NULL);
+            gtk_label_set_text(GTK_LABEL(viewer->status_label), "Package not found or no dependencies");
+            return;
         }
     }
+    update_build_status(viewer);
 }
 
 static void on_refresh_clicked(GtkButton *button, gpointer user_data) {
@@ -108,27 +478,40 @@ static void on_refresh_clicked(GtkButton *button, gpointer user_data) {
     
     int depth = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(viewer->depth_spin));
     
+    cancel_build(viewer);
     gtk_label_set_text(GTK_LABEL(viewer->status_label), "Building dependency tree...");
-    
-    if (viewer->current_tree) {
-        dependency_tree_free(viewer->current_tree);
-    }
-    
-    viewer->current_tree = pacman_build_dependency_tree(package_name, depth);
-    
-    if (viewer->current_tree && viewer->current_tree->count > 0) {
-        char status[256];
-        snprintf(status, sizeof(status), "Found %d packages in dependency tree", viewer->current_tree->count);
-        gtk_label_set_text(GTK_LABEL(viewer->status_label), status);
-        
-        free(viewer->root_package);
-        viewer->root_package = strdup(package_name);
-        viewer->max_depth = depth;
-    } else {
-        gtk_label_set_text(GTK_LABEL(viewer->status_label), "Package not found or no dependencies");
-    }
-    
-    gtk_widget_queue_draw(viewer->drawing_area);
+
+    free(viewer->root_package);
+    viewer->root_package = strdup(package_name);
+    viewer->max_depth = depth;
+
+    viewer->build_started = g_get_monotonic_time();
+    viewer->build_elapsed = 0;
+    viewer->build_nodes = 0;
+    viewer->build_depth = 0;
+    viewer->build_finished = FALSE;
+    viewer->view_touched = FALSE;
+
+    // The walk publishes each completed level, so shallow levels are drawn
+    // while deeper ones are still being expanded
+    viewer->build_cancellable = g_cancellable_new();
+    pacman_build_dependency_tree_async(package_name, depth, viewer->build_cancellable, on_tree_level, viewer);
+}
+
+// A new depth makes the running walk stale; rebuild the tree on display
+static void on_depth_changed(GtkSpinButton *spin, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    if (!viewer->root_package) return;
+    on_refresh_clicked(GTK_BUTTON(viewer->refresh_btn), viewer);
+}
+
+// Typing a new name only cancels; the build starts on Refresh
+static void on_package_changed(GtkEditable *editable, gpointer user_data) {
+    DependencyViewer *viewer = (DependencyViewer*)user_data;
+    if (!viewer->build_cancellable && !viewer->layout_cancellable) return;
+
+    cancel_build(viewer);
+    gtk_label_set_text(GTK_LABEL(viewer->status_label), "Cancelled; click Refresh to build the new package");
 }
 
 static void create_legend(DependencyViewer *viewer) {
@@ -151,14 +534,29 @@ static void create_legend(DependencyViewer *viewer) {
     GtkWidget *dep_label = gtk_label_new("Dependencies");
     gtk_label_set_xalign(GTK_LABEL(dep_label), 0.0);
     
+    GtkWidget *missing_color = gtk_drawing_area_new();
+    gtk_widget_set_size_request(missing_color, 20, 20);
+    GtkWidget *missing_label = gtk_label_new("Not installed");
+    gtk_label_set_xalign(GTK_LABEL(missing_label), 0.0);
+
     GtkWidget *arrow_label = gtk_label_new("→ Dependency relationship");
     gtk_label_set_xalign(GTK_LABEL(arrow_label), 0.0);
+
+    GtkWidget *unsatisfied_label = gtk_label_new("Red arrow: version constraint not met, labelled with it");
+    gtk_label_set_xalign(GTK_LABEL(unsatisfied_label), 0.0);
+
+    GtkWidget *conflict_label = gtk_label_new("Orange dashes: conflict; orange outline: conflicts with an installed package");
+    gtk_label_set_xalign(GTK_LABEL(conflict_label), 0.0);
     
     gtk_grid_attach(GTK_GRID(legend_grid), root_color, 0, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(legend_grid), root_label, 1, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(legend_grid), dep_color, 0, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(legend_grid), dep_label, 1, 1, 1, 1);
-    gtk_grid_attach(GTK_GRID(legend_grid), arrow_label, 0, 2, 2, 1);
+    gtk_grid_attach(GTK_GRID(legend_grid), missing_color, 0, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(legend_grid), missing_label, 1, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(legend_grid), arrow_label, 0, 3, 2, 1);
+    gtk_grid_attach(GTK_GRID(legend_grid), unsatisfied_label, 0, 4, 2, 1);
+    gtk_grid_attach(GTK_GRID(legend_grid), conflict_label, 0, 5, 2, 1);
     
     gtk_frame_set_child(GTK_FRAME(legend_frame), legend_grid);
     viewer->legend_box = legend_frame;
@@ -166,9 +564,32 @@ static void create_legend(DependencyViewer *viewer) {
 
 DependencyViewer* dependency_viewer_new(void) {
     DependencyViewer *viewer = malloc(sizeof(DependencyViewer));
-    viewer->current_tree = NULL;
+    viewer->layout = NULL;
+    viewer->layout_cancellable = NULL;
+    viewer->build_cancellable = NULL;
+    viewer->pending_tree = NULL;
+    viewer->build_started = 0;
+    viewer->build_elapsed = 0;
+    viewer->build_nodes = 0;
+    viewer->build_depth = 0;
+    viewer->build_finished = TRUE;
     viewer->root_package = NULL;
     viewer->max_depth = 3;
+
+    viewer->scale = 1.0;
+    viewer->offset_x = 0;
+    viewer->offset_y = 0;
+    viewer->pointer_x = 0;
+    viewer->pointer_y = 0;
+    viewer->fit_pending = FALSE;
+    viewer->view_touched = FALSE;
+    viewer->tiles = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                          (GDestroyNotify)cairo_surface_destroy);
+    viewer->tiles_scale = 0;
+    viewer->label_pad_x = 0;
+    viewer->label_pad_y = 0;
+    viewer->visible_nodes = g_array_new(FALSE, FALSE, sizeof(int));
+    viewer->visible_edges = g_array_new(FALSE, FALSE, sizeof(int));
     
     viewer->node_width = 120;
     viewer->node_height = 30;
@@ -194,6 +615,8 @@ DependencyViewer* dependency_viewer_new(void) {
     GtkWidget *depth_label = gtk_label_new("Max Depth:");
     viewer->depth_spin = gtk_spin_button_new_with_range(1, 5, 1);
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(viewer->depth_spin), 3);
+    g_signal_connect(viewer->depth_spin, "value-changed", G_CALLBACK(on_depth_changed), viewer);
+    g_signal_connect(viewer->package_entry, "changed", G_CALLBACK(on_package_changed), viewer);
     
     viewer->refresh_btn = gtk_button_new_with_label("Refresh");
     g_signal_connect(viewer->refresh_btn, "clicked", G_CALLBACK(on_refresh_clicked), viewer);
@@ -211,17 +634,36 @@ DependencyViewer* dependency_viewer_new(void) {
     GtkWidget *content_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
     
     GtkWidget *graph_frame = gtk_frame_new("Dependency Graph");
-    GtkWidget *scrolled = gtk_scrolled_window_new();
-    gtk_widget_set_hexpand(scrolled, TRUE);
-    gtk_widget_set_vexpand(scrolled, TRUE);
-    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
     
+    // Panned and zoomed by gestures instead of scrolled, so the canvas
+    // never grows with the graph
     viewer->drawing_area = gtk_drawing_area_new();
     gtk_widget_set_size_request(viewer->drawing_area, 800, 600);
+    gtk_widget_set_hexpand(viewer->drawing_area, TRUE);
+    gtk_widget_set_vexpand(viewer->drawing_area, TRUE);
     gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(viewer->drawing_area), draw_dependency_graph, viewer, NULL);
-    
-    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), viewer->drawing_area);
-    gtk_frame_set_child(GTK_FRAME(graph_frame), scrolled);
+    g_signal_connect(viewer->drawing_area, "resize", G_CALLBACK(on_drawing_area_resize), viewer);
+    g_signal_connect(viewer->drawing_area, "notify::scale-factor", G_CALLBACK(on_scale_factor_changed), viewer);
+
+    GtkEventController *motion = gtk_event_controller_motion_new();
+    g_signal_connect(motion, "motion", G_CALLBACK(on_pointer_motion), viewer);
+    gtk_widget_add_controller(viewer->drawing_area, motion);
+
+    GtkEventController *scroll = gtk_event_controller_scroll_new(GTK_EVENT_CONTROLLER_SCROLL_VERTICAL);
+    g_signal_connect(scroll, "scroll", G_CALLBACK(on_scroll), viewer);
+    gtk_widget_add_controller(viewer->drawing_area, scroll);
+
+    GtkGesture *drag = gtk_gesture_drag_new();
+    g_signal_connect(drag, "drag-begin", G_CALLBACK(on_drag_begin), viewer);
+    g_signal_connect(drag, "drag-update", G_CALLBACK(on_drag_update), viewer);
+    gtk_widget_add_controller(viewer->drawing_area, GTK_EVENT_CONTROLLER(drag));
+
+    GtkGesture *zoom = gtk_gesture_zoom_new();
+    g_signal_connect(zoom, "begin", G_CALLBACK(on_zoom_begin), viewer);
+    g_signal_connect(zoom, "scale-changed", G_CALLBACK(on_zoom_scale_changed), viewer);
+    gtk_widget_add_controller(viewer->drawing_area, GTK_EVENT_CONTROLLER(zoom));
+
+    gtk_frame_set_child(GTK_FRAME(graph_frame), viewer->drawing_area);
     
     create_legend(viewer);
     
@@ -250,7 +692,11 @@ void dependency_viewer_set_package(DependencyViewer *viewer, const char *package
 }
 
 void dependency_viewer_free(DependencyViewer *viewer) {
-    if (viewer->current_tree) dependency_tree_free(viewer->current_tree);
+    cancel_build(viewer);
+    g_hash_table_destroy(viewer->tiles);
+    g_array_free(viewer->visible_nodes, TRUE);
+    g_array_free(viewer->visible_edges, TRUE);
+    graph_layout_free(viewer->layout);
     if (viewer->root_package) free(viewer->root_package);
     free(viewer);
 }
\ No newline at end of file
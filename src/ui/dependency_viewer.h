@@ -3,6 +3,7 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 #include "../pacman_wrapper.h"
+#include "graph_layout.h"
 
 typedef struct {
     GtkWidget *window;
@@ -14,9 +15,41 @@ typedef struct {
     GtkWidget *status_label;
     GtkWidget *legend_box;
     
-    DependencyTree *current_tree;
+    GraphLayout *layout;            // Of the tree on display, or NULL
+    GCancellable *layout_cancellable;
+    GCancellable *build_cancellable;
+    DependencyTree *pending_tree;   // Newest level, waiting for the running layout
+    gint64 build_started;
+    gint64 build_elapsed;           // Until the newest level arrived
+    int build_nodes;
+    int build_depth;
+    gboolean build_finished;
     char *root_package;
     int max_depth;
+
+    // View transform: widget point (x, y) shows layout point
+    // (offset_x + x / scale, offset_y + y / scale)
+    double scale;
+    double offset_x;
+    double offset_y;
+    double drag_start_x;            // Offset when the current pan began
+    double drag_start_y;
+    double zoom_start_scale;        // Scale when the current pinch began
+    double pointer_x;               // Last pointer position, for wheel zoom
+    double pointer_y;
+    gboolean fit_pending;           // Fit the next layout once allocated
+    gboolean view_touched;          // Panned or zoomed since the build began
+
+    // Rendered tiles of the current layout at tiles_scale and the widget's
+    // scale factor, keyed by (row << 32 | column)
+    GHashTable *tiles;
+    double tiles_scale;
+    // How far labels reach past the bounding boxes the spatial index
+    // knows, in layout units; tiles query that much beyond their edges
+    double label_pad_x;
+    double label_pad_y;
+    GArray *visible_nodes;          // Scratch for spatial queries
+    GArray *visible_edges;
     
     // Drawing properties
     int node_width;
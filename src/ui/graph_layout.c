@@ -0,0 +1,542 @@
+#include "graph_layout.h"
+#include "../dep_graph.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Upper bound on barycenter sweeps, and how many in a row may fail to
+// reduce crossings before ordering stops early
+#define LAYOUT_MAX_SWEEPS 24
+#define LAYOUT_PATIENCE 4
+
+// Side of a spatial index cell in layout units, about two node boxes wide
+#define LAYOUT_GRID_CELL 256.0
+
+typedef struct {
+    int from;
+    int to;
+} EdgePair;
+
+// What the tree's graph says about an edge, parallel to the pairs
+typedef struct {
+    GraphEdgeFlags flags;
+    const char *spec;
+} EdgeInfo;
+
+typedef struct {
+    int n_nodes;
+    int n_layers;
+    int *layer_start;       // n_layers + 1 offsets into layer_nodes
+    int *layer_nodes;       // Node indices, in their current order per layer
+    int *position;          // Node index -> position within its layer
+    double *key;
+    // Edges between adjacent layers, as CSR in both directions
+    int *parent_offsets;
+    int *parents;
+    int *child_offsets;
+    int *children;
+} LayoutState;
+
+typedef struct {
+    DependencyTree *tree;
+    GraphLayoutMetrics metrics;
+    GCancellable *cancellable;
+    GraphLayoutCallback callback;
+    gpointer user_data;
+    GraphLayout *layout;
+} LayoutJob;
+
+static int compare_keys(gconstpointer a, gconstpointer b, gpointer user_data) {
+    LayoutState *state = (LayoutState*)user_data;
+    int u = *(const int*)a;
+    int v = *(const int*)b;
+
+    if (state->key[u] != state->key[v]) return state->key[u] < state->key[v] ? -1 : 1;
+    return state->position[u] - state->position[v];
+}
+
+// Moves every node of layer to the mean position of its neighbours in the
+// adjacent, fixed layer. Nodes without neighbours there keep their place.
+static void order_layer(LayoutState *state, int layer, const int *offsets, const int *adjacent) {
+    int start = state->layer_start[layer];
+    int count = state->layer_start[layer + 1] - start;
+    int *nodes = &state->layer_nodes[start];
+
+    for (int i = 0; i < count; i++) {
+        int node = nodes[i];
+        int degree = offsets[node + 1] - offsets[node];
+        if (degree == 0) {
+            state->key[node] = state->position[node];
+            continue;
+        }
+
+        double sum = 0;
+        for (int k = offsets[node]; k < offsets[node + 1]; k++) {
+            sum += state->position[adjacent[k]];
+        }
+        state->key[node] = sum / degree;
+    }
+
+    g_qsort_with_data(nodes, count, sizeof(int), compare_keys, state);
+    for (int i = 0; i < count; i++) {
+        state->position[nodes[i]] = i;
+    }
+}
+
+static int compare_edge_positions(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const EdgePair *x = (const EdgePair*)a;
+    const EdgePair *y = (const EdgePair*)b;
+    if (x->from != y->from) return x->from - y->from;
+    return x->to - y->to;
+}
+
+// Crossings between layer and layer + 1: with edges sorted by source
+// position, every inversion of the target positions is one crossing.
+// Counted with a Fenwick tree in O(E log V).
+static long count_layer_crossings(LayoutState *state, int layer, EdgePair *scratch, int *tree) {
+    int n_edges = 0;
+    for (int i = state->layer_start[layer]; i < state->layer_start[layer + 1]; i++) {
+        int node = state->layer_nodes[i];
+        for (int k = state->child_offsets[node]; k < state->child_offsets[node + 1]; k++) {
+            scratch[n_edges].from = state->position[node];
+            scratch[n_edges].to = state->position[state->children[k]];
+            n_edges++;
+        }
+    }
+    if (n_edges < 2) return 0;
+
+    g_qsort_with_data(scratch, n_edges, sizeof(EdgePair), compare_edge_positions, NULL);
+
+    int size = state->layer_start[layer + 2] - state->layer_start[layer + 1];
+    memset(tree, 0, sizeof(int) * (size + 1));
+
+    long crossings = 0;
+    for (int i = 0; i < n_edges; i++) {
+        // Earlier edges that end further down cross this one
+        int seen_at_or_before = 0;
+        for (int k = scratch[i].to + 1; k > 0; k -= k & -k) seen_at_or_before += tree[k];
+        crossings += i - seen_at_or_before;
+
+        for (int k = scratch[i].to + 1; k <= size; k += k & -k) tree[k]++;
+    }
+    return crossings;
+}
+
+static long count_crossings(LayoutState *state, EdgePair *scratch, int *tree) {
+    long crossings = 0;
+    for (int layer = 0; layer + 1 < state->n_layers; layer++) {
+        crossings += count_layer_crossings(state, layer, scratch, tree);
+    }
+    return crossings;
+}
+
+// Builds CSR adjacency for edges from layer L to layer L + 1, in the given
+// direction. Other edges (to the same or an earlier layer) do not take part
+// in ordering.
+static void build_adjacency(LayoutState *state, const GraphLayoutNode *nodes, GArray *pairs,
+                            gboolean forward, int **offsets_out, int **adjacent_out) {
+    int *offsets = g_new0(int, state->n_nodes + 1);
+    int *adjacent = g_new(int, MAX(pairs->len, 1));
+
+    for (guint i = 0; i < pairs->len; i++) {
+        EdgePair *edge = &g_array_index(pairs, EdgePair, i);
+        if (nodes[edge->to].layer != nodes[edge->from].layer + 1) continue;
+        offsets[(forward ? edge->from : edge->to) + 1]++;
+    }
+    for (int i = 0; i < state->n_nodes; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    int *fill = g_memdup2(offsets, sizeof(int) * MAX(state->n_nodes, 1));
+    for (guint i = 0; i < pairs->len; i++) {
+        EdgePair *edge = &g_array_index(pairs, EdgePair, i);
+        if (nodes[edge->to].layer != nodes[edge->from].layer + 1) continue;
+        if (forward) {
+            adjacent[fill[edge->from]++] = edge->to;
+        } else {
+            adjacent[fill[edge->to]++] = edge->from;
+        }
+    }
+    g_free(fill);
+
+    *offsets_out = offsets;
+    *adjacent_out = adjacent;
+}
+
+// Alternating down and up barycenter sweeps, keeping the best order seen
+static int reduce_crossings(LayoutState *state, int n_proper_edges) {
+    EdgePair *scratch = g_new(EdgePair, MAX(n_proper_edges, 1));
+    int *tree = g_new(int, state->n_nodes + 1);
+    int *best = g_memdup2(state->layer_nodes, sizeof(int) * MAX(state->n_nodes, 1));
+
+    long best_crossings = count_crossings(state, scratch, tree);
+    int stale = 0;
+
+    for (int sweep = 0; sweep < LAYOUT_MAX_SWEEPS && best_crossings > 0 && stale < LAYOUT_PATIENCE; sweep++) {
+        if (sweep % 2 == 0) {
+            for (int layer = 1; layer < state->n_layers; layer++) {
+                order_layer(state, layer, state->parent_offsets, state->parents);
+            }
+        } else {
+            for (int layer = state->n_layers - 2; layer >= 0; layer--) {
+                order_layer(state, layer, state->child_offsets, state->children);
+            }
+        }
+
+        long crossings = count_crossings(state, scratch, tree);
+        if (crossings < best_crossings) {
+            best_crossings = crossings;
+            memcpy(best, state->layer_nodes, sizeof(int) * state->n_nodes);
+            stale = 0;
+        } else {
+            stale++;
+        }
+    }
+
+    memcpy(state->layer_nodes, best, sizeof(int) * state->n_nodes);
+    for (int layer = 0; layer < state->n_layers; layer++) {
+        for (int i = state->layer_start[layer]; i < state->layer_start[layer + 1]; i++) {
+            state->position[state->layer_nodes[i]] = i - state->layer_start[layer];
+        }
+    }
+
+    g_free(best);
+    g_free(tree);
+    g_free(scratch);
+    return (int)MIN(best_crossings, G_MAXINT);
+}
+
+typedef struct {
+    double x0, y0, x1, y1;
+} Box;
+
+static void box_cells(const GraphLayout *layout, const Box *box, int *c0, int *r0, int *c1, int *r1) {
+    *c0 = CLAMP((int)(box->x0 / layout->cell_size), 0, layout->grid_columns - 1);
+    *r0 = CLAMP((int)(box->y0 / layout->cell_size), 0, layout->grid_rows - 1);
+    *c1 = CLAMP((int)(box->x1 / layout->cell_size), 0, layout->grid_columns - 1);
+    *r1 = CLAMP((int)(box->y1 / layout->cell_size), 0, layout->grid_rows - 1);
+}
+
+// Buckets items into every cell their box overlaps: one pass to count, one
+// to fill
+static void build_grid(const GraphLayout *layout, const Box *boxes, int count,
+                       int **offsets_out, int **items_out) {
+    int n_cells = layout->grid_columns * layout->grid_rows;
+    int *offsets = g_new0(int, n_cells + 1);
+
+    for (int i = 0; i < count; i++) {
+        int c0, r0, c1, r1;
+        box_cells(layout, &boxes[i], &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) offsets[r * layout->grid_columns + c + 1]++;
+        }
+    }
+    for (int cell = 0; cell < n_cells; cell++) {
+        offsets[cell + 1] += offsets[cell];
+    }
+
+    int *items = g_new(int, MAX(offsets[n_cells], 1));
+    int *fill = g_memdup2(offsets, sizeof(int) * n_cells);
+    for (int i = 0; i < count; i++) {
+        int c0, r0, c1, r1;
+        box_cells(layout, &boxes[i], &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) items[fill[r * layout->grid_columns + c]++] = i;
+        }
+    }
+    g_free(fill);
+
+    *offsets_out = offsets;
+    *items_out = items;
+}
+
+static void build_spatial_index(GraphLayout *layout) {
+    layout->cell_size = LAYOUT_GRID_CELL;
+    layout->grid_columns = MAX(1, (int)(layout->width / layout->cell_size) + 1);
+    layout->grid_rows = MAX(1, (int)(layout->height / layout->cell_size) + 1);
+
+    int n_boxes = MAX(layout->n_nodes, layout->n_edges);
+    Box *boxes = g_new(Box, MAX(n_boxes, 1));
+
+    for (int i = 0; i < layout->n_nodes; i++) {
+        const GraphLayoutNode *node = &layout->nodes[i];
+        boxes[i] = (Box){ node->x, node->y, node->x + layout->metrics.node_width,
+                          node->y + layout->metrics.node_height };
+    }
+    build_grid(layout, boxes, layout->n_nodes, &layout->node_cell_offsets, &layout->node_cell_items);
+
+    for (int i = 0; i < layout->n_edges; i++) {
+        const GraphLayoutEdge *edge = &layout->edges[i];
+        boxes[i] = (Box){ MIN(edge->x1, edge->x2), MIN(edge->y1, edge->y2),
+                          MAX(edge->x1, edge->x2), MAX(edge->y1, edge->y2) };
+    }
+    build_grid(layout, boxes, layout->n_edges, &layout->edge_cell_offsets, &layout->edge_cell_items);
+
+    g_free(boxes);
+
+    layout->node_marks = g_new0(guint, MAX(layout->n_nodes, 1));
+    layout->edge_marks = g_new0(guint, MAX(layout->n_edges, 1));
+}
+
+static void collect_cell_items(GraphLayout *layout, const int *offsets, const int *items, guint *marks,
+                               int c0, int r0, int c1, int r1, GArray *out) {
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * layout->grid_columns + c;
+            for (int k = offsets[cell]; k < offsets[cell + 1]; k++) {
+                int item = items[k];
+                if (marks[item] == layout->query_stamp) continue;
+                marks[item] = layout->query_stamp;
+                g_array_append_val(out, item);
+            }
+        }
+    }
+}
+
+void graph_layout_query(GraphLayout *layout, double x0, double y0, double x1, double y1,
+                        GArray *nodes, GArray *edges) {
+    g_array_set_size(nodes, 0);
+    g_array_set_size(edges, 0);
+    if (x1 < 0 || y1 < 0 || x0 > layout->width || y0 > layout->height) return;
+
+    // A wrapped stamp could match stale marks, so start over
+    if (++layout->query_stamp == 0) {
+        memset(layout->node_marks, 0, sizeof(guint) * MAX(layout->n_nodes, 1));
+        memset(layout->edge_marks, 0, sizeof(guint) * MAX(layout->n_edges, 1));
+        layout->query_stamp = 1;
+    }
+
+    Box box = { x0, y0, x1, y1 };
+    int c0, r0, c1, r1;
+    box_cells(layout, &box, &c0, &r0, &c1, &r1);
+
+    // Cells are coarse, so check the actual boxes as well
+    collect_cell_items(layout, layout->node_cell_offsets, layout->node_cell_items, layout->node_marks,
+                       c0, r0, c1, r1, nodes);
+    int kept = 0;
+    for (guint i = 0; i < nodes->len; i++) {
+        int index = g_array_index(nodes, int, i);
+        const GraphLayoutNode *node = &layout->nodes[index];
+        if (node->x > x1 || node->y > y1 || node->x + layout->metrics.node_width < x0 ||
+            node->y + layout->metrics.node_height < y0) continue;
+        g_array_index(nodes, int, kept++) = index;
+    }
+    g_array_set_size(nodes, kept);
+
+    collect_cell_items(layout, layout->edge_cell_offsets, layout->edge_cell_items, layout->edge_marks,
+                       c0, r0, c1, r1, edges);
+}
+
+static gboolean conflicts_with(const DepGraph *graph, int node, int other) {
+    int count;
+    const int *targets = dep_graph_conflicts(graph, node, &count);
+    for (int i = 0; i < count; i++) {
+        if (targets[i] == other) return TRUE;
+    }
+    return FALSE;
+}
+
+// Conflicts between packages of the tree; a pair that conflicts both ways
+// gets one edge
+static void add_conflict_edges(DependencyTree *tree, const int *graph_nodes, GHashTable *index,
+                               GArray *pairs, GArray *infos) {
+    for (int i = 0; i < tree->count; i++) {
+        if (graph_nodes[i] < 0) continue;
+
+        int count;
+        const int *targets = dep_graph_conflicts(tree->graph, graph_nodes[i], &count);
+        for (int k = 0; k < count; k++) {
+            const char *name = dep_graph_name(tree->graph, targets[k]);
+            int target = GPOINTER_TO_INT(g_hash_table_lookup(index, name)) - 1;
+            if (target < 0 || target == i) continue;
+            if (target < i && conflicts_with(tree->graph, targets[k], graph_nodes[i])) continue;
+
+            EdgePair edge = { i, target };
+            EdgeInfo info = { GRAPH_EDGE_CONFLICT, NULL };
+            g_array_append_val(pairs, edge);
+            g_array_append_val(infos, info);
+        }
+    }
+}
+
+GraphLayout* graph_layout_new(DependencyTree *tree, const GraphLayoutMetrics *metrics) {
+    GraphLayout *layout = g_malloc0(sizeof(GraphLayout));
+    layout->tree = tree;
+    layout->metrics = *metrics;
+    layout->n_nodes = tree->count;
+    layout->nodes = g_new0(GraphLayoutNode, MAX(tree->count, 1));
+
+    int n = tree->count;
+    GHashTable *index = g_hash_table_new(g_str_hash, g_str_equal);
+    int *graph_nodes = g_new(int, MAX(n, 1));
+    for (int i = 0; i < n; i++) {
+        GraphLayoutNode *node = &layout->nodes[i];
+        node->name = tree->nodes[i].name;
+        node->layer = tree->nodes[i].depth;
+        graph_nodes[i] = tree->graph ? dep_graph_lookup(tree->graph, node->name) : -1;
+
+        if (node->layer == 0) node->flags |= GRAPH_NODE_ROOT;
+        if (graph_nodes[i] >= 0) {
+            int conflicts;
+            dep_graph_conflicts(tree->graph, graph_nodes[i], &conflicts);
+            if (!dep_graph_package(tree->graph, graph_nodes[i])) node->flags |= GRAPH_NODE_MISSING;
+            if (conflicts > 0) node->flags |= GRAPH_NODE_CONFLICT;
+        }
+
+        layout->n_layers = MAX(layout->n_layers, node->layer + 1);
+        g_hash_table_insert(index, tree->nodes[i].name, GINT_TO_POINTER(i + 1));
+    }
+
+    // Edges to nodes outside the tree (past the depth limit) are dropped.
+    // A node's depends list follows the graph's edge order, so k is also
+    // its edge index there.
+    GArray *pairs = g_array_new(FALSE, FALSE, sizeof(EdgePair));
+    GArray *infos = g_array_new(FALSE, FALSE, sizeof(EdgeInfo));
+    for (int i = 0; i < n; i++) {
+        DependencyList *depends = tree->nodes[i].depends;
+        for (int k = 0; depends && k < depends->count; k++) {
+            int target = GPOINTER_TO_INT(g_hash_table_lookup(index, depends->dependencies[k])) - 1;
+            if (target < 0 || target == i) continue;
+
+            EdgePair edge = { i, target };
+            EdgeInfo info = { 0, NULL };
+            if (graph_nodes[i] >= 0 && dep_graph_depend_status(tree->graph, graph_nodes[i], k) != DEP_EDGE_SATISFIED) {
+                info.flags = GRAPH_EDGE_UNSATISFIED;
+                info.spec = dep_graph_depend_spec(tree->graph, graph_nodes[i], k);
+            }
+            g_array_append_val(pairs, edge);
+            g_array_append_val(infos, info);
+        }
+    }
+
+    LayoutState state = {0};
+    state.n_nodes = n;
+    state.n_layers = layout->n_layers;
+    state.layer_start = g_new0(int, state.n_layers + 1);
+    state.layer_nodes = g_new(int, MAX(n, 1));
+    state.position = g_new(int, MAX(n, 1));
+    state.key = g_new(double, MAX(n, 1));
+
+    // Counting sort by layer, keeping breadth-first order as the start
+    for (int i = 0; i < n; i++) {
+        state.layer_start[layout->nodes[i].layer + 1]++;
+    }
+    for (int layer = 0; layer < state.n_layers; layer++) {
+        state.layer_start[layer + 1] += state.layer_start[layer];
+    }
+    int *fill = g_memdup2(state.layer_start, sizeof(int) * MAX(state.n_layers, 1));
+    for (int i = 0; i < n; i++) {
+        int layer = layout->nodes[i].layer;
+        state.position[i] = fill[layer] - state.layer_start[layer];
+        state.layer_nodes[fill[layer]++] = i;
+    }
+    g_free(fill);
+
+    build_adjacency(&state, layout->nodes, pairs, TRUE, &state.child_offsets, &state.children);
+    build_adjacency(&state, layout->nodes, pairs, FALSE, &state.parent_offsets, &state.parents);
+
+    layout->crossings = reduce_crossings(&state, state.child_offsets[n]);
+
+    add_conflict_edges(tree, graph_nodes, index, pairs, infos);
+    g_hash_table_destroy(index);
+    g_free(graph_nodes);
+
+    // Layers are centered on the tallest one
+    int tallest = 0;
+    for (int layer = 0; layer < state.n_layers; layer++) {
+        tallest = MAX(tallest, state.layer_start[layer + 1] - state.layer_start[layer]);
+    }
+
+    for (int i = 0; i < n; i++) {
+        GraphLayoutNode *node = &layout->nodes[i];
+        int size = state.layer_start[node->layer + 1] - state.layer_start[node->layer];
+        node->x = metrics->margin + node->layer * metrics->level_spacing;
+        node->y = metrics->margin + (state.position[i] + (tallest - size) / 2.0) * metrics->node_spacing;
+    }
+
+    layout->width = 2 * metrics->margin + MAX(state.n_layers - 1, 0) * metrics->level_spacing + metrics->node_width;
+    layout->height = 2 * metrics->margin + MAX(tallest - 1, 0) * metrics->node_spacing + metrics->node_height;
+
+    layout->n_edges = pairs->len;
+    layout->edges = g_new(GraphLayoutEdge, MAX(pairs->len, 1));
+    for (guint i = 0; i < pairs->len; i++) {
+        EdgePair *pair = &g_array_index(pairs, EdgePair, i);
+        GraphLayoutNode *from = &layout->nodes[pair->from];
+        GraphLayoutNode *to = &layout->nodes[pair->to];
+
+        layout->edges[i].x1 = from->x + metrics->node_width;
+        layout->edges[i].y1 = from->y + metrics->node_height / 2;
+        layout->edges[i].x2 = to->x;
+        layout->edges[i].y2 = to->y + metrics->node_height / 2;
+
+        EdgeInfo *info = &g_array_index(infos, EdgeInfo, i);
+        layout->edges[i].flags = info->flags;
+        layout->edges[i].spec = info->spec;
+        if (info->flags & GRAPH_EDGE_UNSATISFIED) layout->unsatisfied++;
+        if (info->flags & GRAPH_EDGE_CONFLICT) layout->conflicts++;
+    }
+
+    build_spatial_index(layout);
+
+    g_array_free(pairs, TRUE);
+    g_array_free(infos, TRUE);
+    g_free(state.layer_start);
+    g_free(state.layer_nodes);
+    g_free(state.position);
+    g_free(state.key);
+    g_free(state.parent_offsets);
+    g_free(state.parents);
+    g_free(state.child_offsets);
+    g_free(state.children);
+    return layout;
+}
+
+static gboolean deliver_layout(gpointer data) {
+    LayoutJob *job = (LayoutJob*)data;
+
+    if (g_cancellable_is_cancelled(job->cancellable)) {
+        graph_layout_free(job->layout);
+    } else {
+        job->callback(job->layout, job->user_data);
+    }
+
+    if (job->cancellable) g_object_unref(job->cancellable);
+    g_free(job);
+    return FALSE;
+}
+
+static gpointer layout_thread(gpointer data) {
+    LayoutJob *job = (LayoutJob*)data;
+
+    job->layout = graph_layout_new(job->tree, &job->metrics);
+
+    g_idle_add(deliver_layout, job);
+    return NULL;
+}
+
+void graph_layout_new_async(DependencyTree *tree, const GraphLayoutMetrics *metrics,
+                            GCancellable *cancellable, GraphLayoutCallback callback, gpointer user_data) {
+    LayoutJob *job = g_malloc0(sizeof(LayoutJob));
+    job->tree = tree;
+    job->metrics = *metrics;
+    job->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+    job->callback = callback;
+    job->user_data = user_data;
+
+    GThread *thread = g_thread_new("graph_layout", layout_thread, job);
+    g_thread_unref(thread);
+}
+
+void graph_layout_free(GraphLayout *layout) {
+    if (!layout) return;
+
+    dependency_tree_free(layout->tree);
+    g_free(layout->nodes);
+    g_free(layout->edges);
+    g_free(layout->node_cell_offsets);
+    g_free(layout->node_cell_items);
+    g_free(layout->edge_cell_offsets);
+    g_free(layout->edge_cell_items);
+    g_free(layout->node_marks);
+    g_free(layout->edge_marks);
+    g_free(layout);
+}
@@ -0,0 +1,97 @@
+#ifndef GRAPH_LAYOUT_H
+#define GRAPH_LAYOUT_H
+
+#include <gio/gio.h>
+#include "../pacman_wrapper.h"
+
+// Layered (Sugiyama-style) layout of a dependency tree. Layers are the
+// breadth-first depths, so dependency edges never point more than one layer
+// ahead; the order within each layer is chosen by barycenter sweeps that
+// minimize edge crossings. Conflicts between packages of the tree are added
+// as extra edges that take no part in ordering. The result is flat
+// coordinate arrays that a draw function only has to iterate over.
+
+typedef enum {
+    GRAPH_NODE_ROOT = 1 << 0,
+    GRAPH_NODE_MISSING = 1 << 1,    // Nothing installed satisfies it
+    GRAPH_NODE_CONFLICT = 1 << 2    // Its %CONFLICTS% match an installed package
+} GraphNodeFlags;
+
+typedef enum {
+    GRAPH_EDGE_UNSATISFIED = 1 << 0,    // Missing, or provided with the wrong version
+    GRAPH_EDGE_CONFLICT = 1 << 1        // Not a dependency: the source conflicts with the target
+} GraphEdgeFlags;
+
+typedef struct {
+    double x, y;            // Top-left corner of the node box
+    const char *name;       // Borrowed from the tree
+    int layer;
+    GraphNodeFlags flags;
+    // Label position relative to the box, measured by the viewer
+    double label_x, label_y;
+} GraphLayoutNode;
+
+typedef struct {
+    double x1, y1;          // Middle of the source's right side
+    double x2, y2;          // Middle of the target's left side
+    GraphEdgeFlags flags;
+    // The dependency as written, e.g. "glibc>=2.39", for unsatisfied edges;
+    // NULL otherwise. Borrowed from the tree's graph.
+    const char *spec;
+} GraphLayoutEdge;
+
+typedef struct {
+    double node_width;
+    double node_height;
+    double level_spacing;   // Between the left sides of adjacent layers
+    double node_spacing;    // Between the tops of nodes in one layer
+    double margin;
+} GraphLayoutMetrics;
+
+typedef struct {
+    DependencyTree *tree;
+    GraphLayoutNode *nodes; // Same order as tree->nodes
+    int n_nodes;
+    GraphLayoutEdge *edges;
+    int n_edges;
+    int n_layers;
+    int crossings;          // Edge crossings left after ordering
+    int unsatisfied;        // Edges with GRAPH_EDGE_UNSATISFIED
+    int conflicts;          // Edges with GRAPH_EDGE_CONFLICT
+    double width, height;   // Extent including margins
+    GraphLayoutMetrics metrics;
+
+    // Uniform grid over the layout; each cell lists the nodes and edges
+    // whose bounding boxes overlap it, in CSR form
+    double cell_size;
+    int grid_columns;
+    int grid_rows;
+    int *node_cell_offsets;
+    int *node_cell_items;
+    int *edge_cell_offsets;
+    int *edge_cell_items;
+    // Per-item stamps so a query reports items spanning cells once
+    guint *node_marks;
+    guint *edge_marks;
+    guint query_stamp;
+} GraphLayout;
+
+// Receives ownership of layout
+typedef void (*GraphLayoutCallback)(GraphLayout *layout, gpointer user_data);
+
+// Takes ownership of tree, which is freed with the layout
+GraphLayout* graph_layout_new(DependencyTree *tree, const GraphLayoutMetrics *metrics);
+// Computes the layout on a worker thread and calls back on the main loop.
+// Once cancellable (may be NULL) is cancelled the callback is not called.
+void graph_layout_new_async(DependencyTree *tree, const GraphLayoutMetrics *metrics,
+                            GCancellable *cancellable, GraphLayoutCallback callback, gpointer user_data);
+void graph_layout_free(GraphLayout *layout);
+
+// Replaces the contents of nodes and edges (GArrays of int) with the
+// indices of the items whose bounding boxes intersect the rectangle. Only
+// cells overlapping the rectangle are visited. Main thread only, since it
+// updates the marks.
+void graph_layout_query(GraphLayout *layout, double x0, double y0, double x1, double y1,
+                        GArray *nodes, GArray *edges);
+
+#endif
@@ -0,0 +1,166 @@
+#include "log_view.h"
+
+struct LogView {
+    GtkTextView *view;
+    GtkTextBuffer *buffer;
+    GtkTextMark *end_mark;      // Right gravity, so it stays at the end
+    int max_lines;
+    int buffer_lines;           // Complete lines currently in the buffer
+
+    // Lines queued since the last flush, a ring of max_lines slots with the
+    // oldest at pending_head
+    char **pending;
+    int pending_head;
+    int pending_count;
+    gboolean pending_overflowed;    // Lines were dropped since the last flush
+    gboolean pending_tail_provisional;
+    gboolean buffer_tail_provisional;
+    gboolean replace_buffer_tail;   // Next flush drops the buffer's last line
+    guint tick_id;
+
+    // Formatted once per second rather than once per line
+    gint64 timestamp_second;
+    char timestamp[16];
+};
+
+static gboolean on_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data) {
+    LogView *log = (LogView*)user_data;
+
+    log->tick_id = 0;
+    log_view_flush(log);
+    return G_SOURCE_REMOVE;
+}
+
+static void update_timestamp(LogView *log) {
+    gint64 second = g_get_real_time() / G_USEC_PER_SEC;
+    if (second == log->timestamp_second) return;
+
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *timestamp = g_date_time_format(now, "[%H:%M:%S] ");
+    g_strlcpy(log->timestamp, timestamp, sizeof(log->timestamp));
+    g_free(timestamp);
+    g_date_time_unref(now);
+
+    log->timestamp_second = second;
+}
+
+static void clear_pending(LogView *log) {
+    for (int i = 0; i < log->pending_count; i++) {
+        g_free(log->pending[(log->pending_head + i) % log->max_lines]);
+    }
+    log->pending_head = 0;
+    log->pending_count = 0;
+    log->pending_overflowed = FALSE;
+    log->pending_tail_provisional = FALSE;
+}
+
+LogView* log_view_new(GtkTextView *view, int max_lines) {
+    LogView *log = g_malloc0(sizeof(LogView));
+    log->view = view;
+    log->buffer = gtk_text_view_get_buffer(view);
+    log->max_lines = MAX(max_lines, 1);
+    log->pending = g_new0(char*, log->max_lines);
+    log->timestamp_second = -1;
+
+    GtkTextIter end_iter;
+    gtk_text_buffer_get_end_iter(log->buffer, &end_iter);
+    log->end_mark = gtk_text_buffer_create_mark(log->buffer, NULL, &end_iter, FALSE);
+
+    return log;
+}
+
+void log_view_append(LogView *log, const char *line, gboolean provisional) {
+    update_timestamp(log);
+    char *entry = g_strconcat(log->timestamp, line, NULL);
+
+    if (log->pending_count > 0 && log->pending_tail_provisional) {
+        int tail = (log->pending_head + log->pending_count - 1) % log->max_lines;
+        g_free(log->pending[tail]);
+        log->pending[tail] = entry;
+        log->pending_tail_provisional = provisional;
+        return;
+    }
+    if (log->pending_count == 0 && log->buffer_tail_provisional) {
+        log->buffer_tail_provisional = FALSE;
+        log->replace_buffer_tail = TRUE;
+    }
+
+    // Full ring: the oldest queued line could never survive the trim anyway
+    if (log->pending_count == log->max_lines) {
+        g_free(log->pending[log->pending_head]);
+        log->pending_head = (log->pending_head + 1) % log->max_lines;
+        log->pending_count--;
+        log->pending_overflowed = TRUE;
+    }
+    log->pending[(log->pending_head + log->pending_count) % log->max_lines] = entry;
+    log->pending_count++;
+    log->pending_tail_provisional = provisional;
+
+    if (!log->tick_id) {
+        log->tick_id = gtk_widget_add_tick_callback(GTK_WIDGET(log->view), on_tick, log, NULL);
+    }
+}
+
+void log_view_flush(LogView *log) {
+    if (log->pending_count == 0) return;
+
+    GString *text = g_string_sized_new(log->pending_count * 64);
+    for (int i = 0; i < log->pending_count; i++) {
+        g_string_append(text, log->pending[(log->pending_head + i) % log->max_lines]);
+        g_string_append_c(text, '\n');
+    }
+
+    if (log->pending_overflowed) {
+        // Everything already shown is older than the queued lines
+        gtk_text_buffer_set_text(log->buffer, text->str, text->len);
+        log->buffer_lines = log->pending_count;
+    } else {
+        GtkTextIter end_iter;
+        if (log->replace_buffer_tail && log->buffer_lines > 0) {
+            GtkTextIter tail_iter;
+            gtk_text_buffer_get_iter_at_line(log->buffer, &tail_iter, log->buffer_lines - 1);
+            gtk_text_buffer_get_end_iter(log->buffer, &end_iter);
+            gtk_text_buffer_delete(log->buffer, &tail_iter, &end_iter);
+            log->buffer_lines--;
+        }
+
+        gtk_text_buffer_get_end_iter(log->buffer, &end_iter);
+        gtk_text_buffer_insert(log->buffer, &end_iter, text->str, text->len);
+        log->buffer_lines += log->pending_count;
+
+        if (log->buffer_lines > log->max_lines) {
+            GtkTextIter start_iter, cut_iter;
+            gtk_text_buffer_get_start_iter(log->buffer, &start_iter);
+            gtk_text_buffer_get_iter_at_line(log->buffer, &cut_iter, log->buffer_lines - log->max_lines);
+            gtk_text_buffer_delete(log->buffer, &start_iter, &cut_iter);
+            log->buffer_lines = log->max_lines;
+        }
+    }
+
+    g_string_free(text, TRUE);
+    log->replace_buffer_tail = FALSE;
+    log->buffer_tail_provisional = log->pending_tail_provisional;
+    clear_pending(log);
+
+    gtk_text_view_scroll_mark_onscreen(log->view, log->end_mark);
+}
+
+void log_view_clear(LogView *log) {
+    clear_pending(log);
+    log->buffer_tail_provisional = FALSE;
+    log->replace_buffer_tail = FALSE;
+    gtk_text_buffer_set_text(log->buffer, "", -1);
+    log->buffer_lines = 0;
+}
+
+void log_view_free(LogView *log) {
+    if (!log) return;
+
+    if (log->tick_id) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(log->view), log->tick_id);
+    }
+    clear_pending(log);
+    g_free(log->pending);
+    gtk_text_buffer_delete_mark(log->buffer, log->end_mark);
+    g_free(log);
+}
@@ -0,0 +1,22 @@
+#ifndef LOG_VIEW_H
+#define LOG_VIEW_H
+
+#include <gtk-4.0/gtk/gtk.h>
+
+// Timestamped operation log shown in a GtkTextView. Appended lines are
+// queued and written to the text buffer at most once per frame, as one
+// insert, from the view's frame clock. The buffer keeps only the newest
+// max_lines lines; if more than that arrive within one frame, the older
+// ones are dropped before they ever reach the buffer.
+typedef struct LogView LogView;
+
+LogView* log_view_new(GtkTextView *view, int max_lines);
+// Main thread only; line is copied. A provisional line, such as one frame
+// of a progress bar, is replaced by whatever line is appended next.
+void log_view_append(LogView *log, const char *line, gboolean provisional);
+// Writes queued lines right away instead of on the next frame
+void log_view_flush(LogView *log);
+void log_view_clear(LogView *log);
+void log_view_free(LogView *log);
+
+#endif
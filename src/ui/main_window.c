@@ -1,50 +1,180 @@
 #include "main_window.h"
+#include "../sync_db.h"
 #include <stdio.h>
 
-// Log callback function
-static void log_output_callback(const char *line, gpointer user_data) {
-    MainWindow *win = (MainWindow*)user_data;
+// Lines kept in the operation log; older output scrolls away
+#define LOG_MAX_LINES 5000
+// Packages listed in the cache size tooltip
+#define CACHE_TOOLTIP_PACKAGES 10
+
+// Widgets of one file in the download table
+typedef struct {
+    GtkWidget *size_label;
+    GtkWidget *rate_label;
+    GtkWidget *eta_label;
+    GtkWidget *bar;
+} DownloadRow;
+
+static void clear_downloads(MainWindow *win) {
+    // Row 0 holds the column headings
+    for (; win->download_row_count > 0; win->download_row_count--) {
+        gtk_grid_remove_row(GTK_GRID(win->download_grid), win->download_row_count);
+    }
+    g_hash_table_remove_all(win->download_rows);
+    gtk_widget_set_visible(win->download_frame, FALSE);
+}
 
-    // Check operation end marker
-    if (g_strcmp0(line, "__OPERATION_FINISHED__") == 0) {
-        // Operation completed - enable buttons
-        win->operation_in_progress = FALSE;
+static DownloadRow* download_row(MainWindow *win, const char *name, gsize name_length) {
+    char *key = g_strndup(name, name_length);
+    DownloadRow *row = g_hash_table_lookup(win->download_rows, key);
+    if (row) {
+        g_free(key);
+        return row;
+    }
 
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
-        gtk_widget_set_sensitive(win->update_btn, TRUE);
-        gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
-        gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+    row = g_malloc0(sizeof(DownloadRow));
+    GtkWidget *name_label = gtk_label_new(key);
+    gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
+    gtk_label_set_ellipsize(GTK_LABEL(name_label), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_widget_set_hexpand(name_label, TRUE);
+    row->size_label = gtk_label_new("");
+    row->rate_label = gtk_label_new("");
+    row->eta_label = gtk_label_new("");
+    row->bar = gtk_progress_bar_new();
+    gtk_widget_set_valign(row->bar, GTK_ALIGN_CENTER);
+
+    int line = ++win->download_row_count;
+    gtk_grid_attach(GTK_GRID(win->download_grid), name_label, 0, line, 1, 1);
+    gtk_grid_attach(GTK_GRID(win->download_grid), row->size_label, 1, line, 1, 1);
+    gtk_grid_attach(GTK_GRID(win->download_grid), row->rate_label, 2, line, 1, 1);
+    gtk_grid_attach(GTK_GRID(win->download_grid), row->eta_label, 3, line, 1, 1);
+    gtk_grid_attach(GTK_GRID(win->download_grid), row->bar, 4, line, 1, 1);
+
+    g_hash_table_insert(win->download_rows, key, row);
+    gtk_widget_set_visible(win->download_frame, TRUE);
+    return row;
+}
 
-        gtk_label_set_text(GTK_LABEL(win->status_label), "Operation completed");
-        return;
+static void update_download_row(MainWindow *win, const TransactionEvent *event) {
+    if (!win->download_grid) return;
+
+    DownloadRow *row = download_row(win, event->name, event->name_length);
+    char text[64];
+
+    if (event->bytes >= 0) {
+        char *size = g_format_size(event->bytes);
+        gtk_label_set_text(GTK_LABEL(row->size_label), size);
+        g_free(size);
+    } else if (event->percent < 0) {
+        // Plain output only says that a download started
+        gtk_label_set_text(GTK_LABEL(row->size_label), "downloading");
     }
 
-    if (!win->log_buffer) return;
+    if (event->rate >= 0) {
+        char *rate = g_format_size((guint64)event->rate);
+        snprintf(text, sizeof(text), "%s/s", rate);
+        gtk_label_set_text(GTK_LABEL(row->rate_label), text);
+        g_free(rate);
+    }
 
-    GtkTextIter end_iter;
-    gtk_text_buffer_get_end_iter(win->log_buffer, &end_iter);
+    if (event->eta >= 0) {
+        snprintf(text, sizeof(text), "%d:%02d", event->eta / 60, event->eta % 60);
+        gtk_label_set_text(GTK_LABEL(row->eta_label), text);
+    }
 
-    // Add timestamp
-    GDateTime *now = g_date_time_new_now_local();
-    gchar *timestamp = g_date_time_format(now, "[%H:%M:%S] ");
+    if (event->percent >= 0) {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(row->bar), event->percent / 100.0);
+    }
+}
 
-    gtk_text_buffer_insert(win->log_buffer, &end_iter, timestamp, -1);
-    gtk_text_buffer_insert(win->log_buffer, &end_iter, line, -1);
-    gtk_text_buffer_insert(win->log_buffer, &end_iter, "\n", -1);
+static void on_transaction_event(const TransactionEvent *event, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    char text[256];
+
+    switch (event->type) {
+    case TRANSACTION_EVENT_PHASE:
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(win->operation_progress), transaction_phase_name(event->phase));
+        break;
+    case TRANSACTION_EVENT_DOWNLOAD:
+        update_download_row(win, event);
+        break;
+    case TRANSACTION_EVENT_STEP:
+        if (event->steps > 0) {
+            snprintf(text, sizeof(text), "%s %.*s (%d/%d)", transaction_phase_name(event->phase),
+                     (int)event->name_length, event->name, event->step, event->steps);
+        } else {
+            snprintf(text, sizeof(text), "%s %.*s", transaction_phase_name(event->phase),
+                     (int)event->name_length, event->name);
+        }
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(win->operation_progress), text);
+        break;
+    }
+}
 
-    // Auto-scroll to bottom
-    gtk_text_buffer_get_end_iter(win->log_buffer, &end_iter);
-    GtkTextMark *mark = gtk_text_buffer_create_mark(win->log_buffer, NULL, &end_iter, FALSE);
-    gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(win->log_textview), mark);
-    gtk_text_buffer_delete_mark(win->log_buffer, mark);
+static void operation_started(MainWindow *win) {
+    transaction_progress_reset(win->transaction_progress);
+    clear_downloads(win);
 
-    g_free(timestamp);
-    g_date_time_unref(now);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(win->operation_progress), 0.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(win->operation_progress),
+                              transaction_phase_name(TRANSACTION_PHASE_NONE));
+    gtk_widget_set_visible(win->operation_progress, TRUE);
+}
+
+static void update_queue_buttons(MainWindow *win) {
+    int count = transaction_queue_count(win->queue);
 
-    // Update UI
-    while (g_main_context_pending(NULL)) {
-        g_main_context_iteration(NULL, FALSE);
+    char label[64];
+    snprintf(label, sizeof(label), "Apply Queue (%d)", count);
+    gtk_button_set_label(GTK_BUTTON(win->apply_queue_btn), label);
+    gtk_widget_set_sensitive(win->apply_queue_btn, count > 0 && !win->operation_in_progress);
+    gtk_widget_set_sensitive(win->clear_queue_btn, count > 0);
+
+    char *staged = transaction_queue_describe(win->queue);
+    gtk_widget_set_tooltip_text(win->apply_queue_btn, count > 0 ? staged : NULL);
+    g_free(staged);
+}
+
+static void start_queue(MainWindow *win, gboolean continuing);
+
+static void operation_finished(MainWindow *win) {
+    // Operation completed - enable buttons
+    win->operation_in_progress = FALSE;
+    gtk_widget_set_visible(win->operation_progress, FALSE);
+
+    gtk_widget_set_sensitive(win->update_btn, TRUE);
+    gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
+    gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
+
+    gtk_label_set_text(GTK_LABEL(win->status_label), "Operation completed");
+    update_queue_buttons(win);
+
+    // Installs and removals clicked while this operation ran
+    if (win->queue_autostart) {
+        win->queue_autostart = FALSE;
+        start_queue(win, TRUE);
+    }
+}
+
+// Log callback function
+static void log_output_callback(const OutputLine *lines, int count, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    transaction_progress_feed(win->transaction_progress, lines, count);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(win->operation_progress),
+                                  transaction_progress_fraction(win->transaction_progress));
+
+    for (int i = 0; i < count; i++) {
+        // Check operation end marker
+        if (strcmp(lines[i].text, "__OPERATION_FINISHED__") == 0) {
+            operation_finished(win);
+            continue;
+        }
+
+        // Queued and written once per frame, so a flood of output never
+        // stalls the main loop
+        if (win->log_view) log_view_append(win->log_view, lines[i].text, lines[i].provisional);
     }
 }
 
@@ -55,6 +185,8 @@ static void show_log_window(MainWindow *win) {
         gtk_window_set_title(GTK_WINDOW(win->log_window), "Installation Log");
         gtk_window_set_default_size(GTK_WINDOW(win->log_window), 600, 400);
         gtk_window_set_transient_for(GTK_WINDOW(win->log_window), GTK_WINDOW(win->window));
+        // The log view lives as long as the main window
+        gtk_window_set_hide_on_close(GTK_WINDOW(win->log_window), TRUE);
 
         GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
         gtk_widget_set_margin_start(vbox, 10);
@@ -72,7 +204,7 @@ static void show_log_window(MainWindow *win) {
         win->log_textview = gtk_text_view_new();
         gtk_text_view_set_editable(GTK_TEXT_VIEW(win->log_textview), FALSE);
         gtk_text_view_set_monospace(GTK_TEXT_VIEW(win->log_textview), TRUE);
-        win->log_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(win->log_textview));
+        win->log_view = log_view_new(GTK_TEXT_VIEW(win->log_textview), LOG_MAX_LINES);
 
         gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), win->log_textview);
 
@@ -81,6 +213,32 @@ static void show_log_window(MainWindow *win) {
         g_signal_connect_swapped(win->close_log_btn, "clicked",
                                 G_CALLBACK(gtk_window_close), win->log_window);
 
+        // Per-file download progress, shown once a download starts
+        win->download_frame = gtk_frame_new("Downloads");
+        GtkWidget *download_scrolled = gtk_scrolled_window_new();
+        gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(download_scrolled),
+                                       GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+        gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(download_scrolled), 160);
+        gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(download_scrolled), TRUE);
+
+        win->download_grid = gtk_grid_new();
+        gtk_grid_set_column_spacing(GTK_GRID(win->download_grid), 10);
+        gtk_grid_set_row_spacing(GTK_GRID(win->download_grid), 2);
+        gtk_widget_set_margin_start(win->download_grid, 5);
+        gtk_widget_set_margin_end(win->download_grid, 5);
+        const char *headings[] = { "File", "Size", "Rate", "ETA", "Progress" };
+        for (int i = 0; i < 5; i++) {
+            GtkWidget *heading = gtk_label_new(headings[i]);
+            gtk_label_set_xalign(GTK_LABEL(heading), 0.0);
+            gtk_grid_attach(GTK_GRID(win->download_grid), heading, i, 0, 1, 1);
+        }
+        win->download_row_count = 0;
+
+        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(download_scrolled), win->download_grid);
+        gtk_frame_set_child(GTK_FRAME(win->download_frame), download_scrolled);
+        gtk_widget_set_visible(win->download_frame, FALSE);
+
+        gtk_box_append(GTK_BOX(vbox), win->download_frame);
         gtk_box_append(GTK_BOX(vbox), scrolled);
         gtk_box_append(GTK_BOX(vbox), win->close_log_btn);
 
@@ -88,166 +246,232 @@ static void show_log_window(MainWindow *win) {
     }
 
     // Clear previous log
-    gtk_text_buffer_set_text(win->log_buffer, "", -1);
+    log_view_clear(win->log_view);
+    operation_started(win);
 
     gtk_window_present(GTK_WINDOW(win->log_window));
 }
 
-static void on_search_clicked(GtkButton *button, gpointer user_data) {
-    MainWindow *win = (MainWindow*)user_data;
-
-    if (win->operation_in_progress) return;
-
-    const char *query = gtk_editable_get_text(GTK_EDITABLE(win->search_entry));
-    if (strlen(query) == 0) return;
+// Quiet period after the last keystroke before a search starts. The
+// in-memory catalog answers instantly; spawning a helper is worth fewer
+// restarts.
+#define SEARCH_DEBOUNCE_CATALOG_MS 120
+#define SEARCH_DEBOUNCE_COMMAND_MS 400
 
-    gtk_label_set_text(GTK_LABEL(win->status_label), "Searching...");
+static void clear_search_results(MainWindow *win) {
+    search_pipeline_cancel(win->search_pipeline);
+    package_model_set_packages(win->search_model, NULL);
+}
 
-    // Clear previous results
-    GtkWidget *child = gtk_widget_get_first_child(win->package_list);
-    while (child) {
-        GtkWidget *next = gtk_widget_get_next_sibling(child);
-        gtk_list_box_remove(GTK_LIST_BOX(win->package_list), child);
-        child = next;
+static const char* search_source_name(SearchSource source) {
+    switch (source) {
+    case SEARCH_SOURCE_AUR:
+        return "AUR";
+    case SEARCH_SOURCE_ALL:
+        return "All Sources";
+    default:
+        return "Official Repos";
     }
+}
 
-    // Check source (Official repos or AUR)
-    const char *selected_source = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(win->source_combo));
+static SearchSource selected_search_source(MainWindow *win) {
+    char *selected_source = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(win->source_combo));
 
-    PackageList *packages = NULL;
+    SearchSource source = SEARCH_SOURCE_REPOS;
     if (g_strcmp0(selected_source, "AUR") == 0) {
-        packages = aur_search(query);
-    } else {
-        packages = pacman_search(query);
+        source = SEARCH_SOURCE_AUR;
+    } else if (g_strcmp0(selected_source, "All Sources") == 0) {
+        source = SEARCH_SOURCE_ALL;
     }
 
-    if (packages) {
-        for (int i = 0; i < packages->count; i++) {
-            Package *pkg = &packages->packages[i];
-
-            GtkWidget *row = gtk_list_box_row_new();
-            GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
-
-            char title[512];
-            snprintf(title, sizeof(title), "<b>%s</b> (%s) [%s]",
-                    pkg->name, pkg->version, pkg->repository);
-            GtkWidget *name_label = gtk_label_new(NULL);
-            gtk_label_set_markup(GTK_LABEL(name_label), title);
-            gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
-
-            GtkWidget *desc_label = gtk_label_new(pkg->description);
-            gtk_label_set_xalign(GTK_LABEL(desc_label), 0.0);
-            gtk_label_set_wrap(GTK_LABEL(desc_label), TRUE);
-
-            gtk_box_append(GTK_BOX(box), name_label);
-            gtk_box_append(GTK_BOX(box), desc_label);
-            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), box);
-
-            // Store package name and source
-            g_object_set_data_full(G_OBJECT(row), "package_name",
-                                 g_strdup(pkg->name), g_free);
-            g_object_set_data_full(G_OBJECT(row), "package_source",
-                                 g_strdup(selected_source), g_free);
-
-            gtk_list_box_append(GTK_LIST_BOX(win->package_list), row);
-        }
+    g_free(selected_source);
+    return source;
+}
 
-        char status[256];
-        snprintf(status, sizeof(status), "Found %d packages in %s",
-                packages->count, selected_source);
-        gtk_label_set_text(GTK_LABEL(win->status_label), status);
+static void on_search_results(PackageList *batch, SearchBatchFlags flags, const char *query,
+                              SearchSource source, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
 
-        package_list_free(packages);
-    } else {
+    if (!batch) {
+        package_model_set_packages(win->search_model, NULL);
         gtk_label_set_text(GTK_LABEL(win->status_label), "Search failed");
+        return;
+    }
+
+    // The model only materializes rows as they scroll into view
+    if (flags & SEARCH_BATCH_FIRST) {
+        package_model_set_packages(win->search_model, batch);
+    } else {
+        package_model_append_packages(win->search_model, batch);
+    }
+
+    char status[256];
+    guint found = g_list_model_get_n_items(G_LIST_MODEL(win->search_model));
+    if (flags & SEARCH_BATCH_LAST) {
+        snprintf(status, sizeof(status), "Found %u packages in %s", found, search_source_name(source));
+    } else {
+        snprintf(status, sizeof(status), "Searching %s... %u found so far", search_source_name(source), found);
     }
+    gtk_label_set_text(GTK_LABEL(win->status_label), status);
 }
 
-static void on_package_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data) {
+static void start_search(MainWindow *win, const char *query, guint delay_ms) {
+    gtk_label_set_text(GTK_LABEL(win->status_label), "Searching...");
+    search_pipeline_submit(win->search_pipeline, query, selected_search_source(win), delay_ms);
+}
+
+static void on_search_clicked(GtkButton *button, gpointer user_data) {
     MainWindow *win = (MainWindow*)user_data;
 
-    if (row && !win->operation_in_progress) {
-        const char *pkg_name = g_object_get_data(G_OBJECT(row), "package_name");
-        if (pkg_name) {
-            free(win->selected_package);
-            win->selected_package = strdup(pkg_name);
+    if (win->operation_in_progress) return;
+
+    const char *query = gtk_editable_get_text(GTK_EDITABLE(win->search_entry));
+    if (strlen(query) == 0) return;
 
-            gtk_widget_set_sensitive(win->install_btn, TRUE);
-            gtk_widget_set_sensitive(win->remove_btn, TRUE);
-            gtk_widget_set_sensitive(win->deps_btn, TRUE);
-        }
+    start_search(win, query, 0);
+}
+
+static void on_search_changed(GtkEditable *editable, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    if (win->operation_in_progress) return;
+
+    const char *query = gtk_editable_get_text(editable);
+    if (strlen(query) == 0) {
+        clear_search_results(win);
+        return;
     }
+
+    gboolean instant = selected_search_source(win) == SEARCH_SOURCE_REPOS && sync_catalog_is_ready();
+    start_search(win, query, instant ? SEARCH_DEBOUNCE_CATALOG_MS : SEARCH_DEBOUNCE_COMMAND_MS);
 }
 
-static void on_install_clicked(GtkButton *button, gpointer user_data) {
+static void on_package_selected(GObject *selection, GParamSpec *pspec, gpointer user_data) {
     MainWindow *win = (MainWindow*)user_data;
 
-    if (!win->selected_package || win->operation_in_progress) return;
+    // Selecting stays possible during operations; installs and removals
+    // clicked meanwhile are queued
+    PackageItem *item = gtk_single_selection_get_selected_item(win->search_selection);
+    if (item) {
+        free(win->selected_package);
+        win->selected_package = strdup(package_item_get_package(item)->name);
 
-    win->operation_in_progress = TRUE;
-    gtk_widget_set_sensitive(win->install_btn, FALSE);
-    gtk_widget_set_sensitive(win->remove_btn, FALSE);
-    gtk_widget_set_sensitive(win->update_btn, FALSE);
-    gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
-    gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+        gtk_widget_set_sensitive(win->install_btn, TRUE);
+        gtk_widget_set_sensitive(win->remove_btn, TRUE);
+        gtk_widget_set_sensitive(win->queue_install_btn, TRUE);
+        gtk_widget_set_sensitive(win->queue_remove_btn, TRUE);
+        gtk_widget_set_sensitive(win->deps_btn, TRUE);
+    }
+}
+
+static void on_queue_batch(QueueAction action, int count, int batch, int batches, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    static const char *const verbs[] = { "Removing", "Installing", "Building" };
+
+    // Each transaction reports its own phases from the start
+    operation_started(win);
 
     char status[256];
-    snprintf(status, sizeof(status), "Installing %s...", win->selected_package);
+    snprintf(status, sizeof(status), "%s %d package%s (transaction %d of %d)...",
+             verbs[action], count, count == 1 ? "" : "s", batch, batches);
     gtk_label_set_text(GTK_LABEL(win->status_label), status);
+}
 
-    show_log_window(win);
+// continuing: another operation just ended and its log stays visible
+static void start_queue(MainWindow *win, gboolean continuing) {
+    if (win->operation_in_progress || transaction_queue_count(win->queue) == 0) return;
 
-    GtkListBoxRow *selected_row = gtk_list_box_get_selected_row(GTK_LIST_BOX(win->package_list));
-    const char *source = g_object_get_data(G_OBJECT(selected_row), "package_source");
+    win->operation_in_progress = TRUE;
+    gtk_widget_set_sensitive(win->update_btn, FALSE);
+    gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, FALSE);
 
-    gboolean success;
-    if (g_strcmp0(source, "AUR") == 0) {
-        success = aur_install_async(win->selected_package, log_output_callback, win);
+    if (continuing && win->log_window) {
+        gtk_window_present(GTK_WINDOW(win->log_window));
     } else {
-        success = pacman_install_async(win->selected_package, log_output_callback, win);
+        show_log_window(win);
     }
 
-    if (!success) {
-        // If failed to start - immediately enable buttons
+    if (!transaction_queue_run(win->queue)) {
         win->operation_in_progress = FALSE;
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
+        gtk_widget_set_visible(win->operation_progress, FALSE);
         gtk_widget_set_sensitive(win->update_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
-        gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start installation");
+        gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
+        gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start the queued operations");
     }
+    update_queue_buttons(win);
 }
 
-static void on_remove_clicked(GtkButton *button, gpointer user_data) {
-    MainWindow *win = (MainWindow*)user_data;
+static QueueAction selected_install_action(MainWindow *win) {
+    // AUR helpers report AUR results as "aur/<name>"
+    PackageItem *selected_item = gtk_single_selection_get_selected_item(win->search_selection);
+    const Package *selected = selected_item ? package_item_get_package(selected_item) : NULL;
 
-    if (!win->selected_package || win->operation_in_progress) return;
+    if (selected && g_strcmp0(selected->name, win->selected_package) == 0 &&
+        g_strcmp0(selected->repository, "aur") == 0) {
+        return QUEUE_ACTION_INSTALL_AUR;
+    }
+    return QUEUE_ACTION_INSTALL;
+}
 
-    win->operation_in_progress = TRUE;
-    gtk_widget_set_sensitive(win->install_btn, FALSE);
-    gtk_widget_set_sensitive(win->remove_btn, FALSE);
-    gtk_widget_set_sensitive(win->update_btn, FALSE);
-    gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
-    gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+static void stage_selected(MainWindow *win, QueueAction action, gboolean apply) {
+    if (!win->selected_package) return;
+
+    transaction_queue_stage(win->queue, win->selected_package, action);
 
     char status[256];
-    snprintf(status, sizeof(status), "Removing %s...", win->selected_package);
-    gtk_label_set_text(GTK_LABEL(win->status_label), status);
+    if (!apply) {
+        snprintf(status, sizeof(status), "Queued %s for %s", win->selected_package,
+                 action == QUEUE_ACTION_REMOVE ? "removal" : "installation");
+        gtk_label_set_text(GTK_LABEL(win->status_label), status);
+        update_queue_buttons(win);
+    } else if (win->operation_in_progress) {
+        // Runs with everything else staged once the current operation ends
+        win->queue_autostart = TRUE;
+        snprintf(status, sizeof(status), "Queued %s; it runs when the current operation finishes",
+                 win->selected_package);
+        gtk_label_set_text(GTK_LABEL(win->status_label), status);
+        update_queue_buttons(win);
+    } else {
+        start_queue(win, FALSE);
+    }
+}
 
-    show_log_window(win);
+static void on_install_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    stage_selected(win, selected_install_action(win), TRUE);
+}
 
-    gboolean success = pacman_remove_async(win->selected_package, log_output_callback, win);
+static void on_remove_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    stage_selected(win, QUEUE_ACTION_REMOVE, TRUE);
+}
 
-    if (!success) {
-        win->operation_in_progress = FALSE;
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
-        gtk_widget_set_sensitive(win->update_btn, TRUE);
-        gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
-        gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
-        gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start removal");
-    }
+static void on_queue_install_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    stage_selected(win, selected_install_action(win), FALSE);
+}
+
+static void on_queue_remove_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    stage_selected(win, QUEUE_ACTION_REMOVE, FALSE);
+}
+
+static void on_apply_queue_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    start_queue(win, FALSE);
+}
+
+static void on_clear_queue_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    transaction_queue_clear(win->queue);
+    win->queue_autostart = FALSE;
+    gtk_label_set_text(GTK_LABEL(win->status_label), "Queue cleared");
+    update_queue_buttons(win);
 }
 
 static void on_deps_clicked(GtkButton *button, gpointer user_data) {
@@ -273,13 +497,12 @@ static void on_update_clicked(GtkButton *button, gpointer user_data) {
     if (win->operation_in_progress) return;
 
     win->operation_in_progress = TRUE;
-    gtk_widget_set_sensitive(win->install_btn, FALSE);
-    gtk_widget_set_sensitive(win->remove_btn, FALSE);
     gtk_widget_set_sensitive(win->update_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, FALSE);
 
     gtk_label_set_text(GTK_LABEL(win->status_label), "Updating system...");
 
@@ -289,69 +512,97 @@ static void on_update_clicked(GtkButton *button, gpointer user_data) {
 
     if (!success) {
         win->operation_in_progress = FALSE;
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
         gtk_widget_set_sensitive(win->update_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+        gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
         gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start system update");
     }
 }
 
-static void on_installed_packages_loaded(PackageList *packages, gpointer user_data) {
-    MainWindow *win = (MainWindow*)user_data;
-    
-    if (win->installed_packages) {
-        package_list_free(win->installed_packages);
+// A one-package list for the model, copied out of the batch it came in
+static PackageList* single_package_list(const Package *src) {
+    PackageList *list = package_list_new(1);
+    Package *pkg = package_list_append(list);
+    *pkg = *src;
+    pkg->name = arena_strdup(list->arena, src->name);
+    pkg->version = arena_strdup(list->arena, src->version);
+    pkg->description = src->description ? arena_strdup(list->arena, src->description) : NULL;
+    pkg->repository = src->repository ? arena_strdup(list->arena, src->repository) : NULL;
+    return list;
+}
+
+// Applies a batch of local database changes to the installed list as row
+// removals and inserts. Applying a batch the list already reflects changes
+// nothing, so batches queued during a reload can be replayed afterwards.
+static void apply_installed_changes(MainWindow *win, const LocalDbChanges *changes) {
+    guint position;
+
+    // Removals first: an upgrade removes the old entry and adds the new one
+    for (guint i = 0; i < changes->removed->len; i++) {
+        if (package_model_find_by_name(win->installed_model, g_ptr_array_index(changes->removed, i), &position)) {
+            package_model_remove(win->installed_model, position, 1);
+        }
     }
-    
-    win->installed_packages = packages;
-    
-    if (packages) {
-        // Update progress indicator
-        char progress_text[128];
-        snprintf(progress_text, sizeof(progress_text), "Processing %d packages...", packages->count);
-        gtk_label_set_text(GTK_LABEL(win->loading_progress_label), progress_text);
-        
-        // Add packages to UI
-        for (int i = 0; i < packages->count; i++) {
-            Package *pkg = &packages->packages[i];
-
-            GtkWidget *row = gtk_list_box_row_new();
-            GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
-
-            char title[512];
-            snprintf(title, sizeof(title), "<b>%s</b> (%s)",
-                    pkg->name, pkg->version);
-            GtkWidget *name_label = gtk_label_new(NULL);
-            gtk_label_set_markup(GTK_LABEL(name_label), title);
-            gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
-
-            GtkWidget *desc_label = gtk_label_new(pkg->description);
-            gtk_label_set_xalign(GTK_LABEL(desc_label), 0.0);
-            gtk_label_set_wrap(GTK_LABEL(desc_label), TRUE);
-
-            gtk_box_append(GTK_BOX(box), name_label);
-            gtk_box_append(GTK_BOX(box), desc_label);
-            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), box);
-
-            // Store package name
-            g_object_set_data_full(G_OBJECT(row), "package_name",
-                                 g_strdup(pkg->name), g_free);
-            g_object_set_data_full(G_OBJECT(row), "package_source",
-                                 g_strdup("installed"), g_free);
-
-            gtk_list_box_append(GTK_LIST_BOX(win->installed_list), row);
+
+    int count = changes->changed ? changes->changed->count : 0;
+    for (int i = 0; i < count; i++) {
+        const Package *pkg = &changes->changed->packages[i];
+        if (package_model_find_by_name(win->installed_model, pkg->name, &position)) {
+            package_model_remove(win->installed_model, position, 1);
         }
+        package_model_insert_packages(win->installed_model, position, single_package_list(pkg));
+    }
 
+    if (!win->operation_in_progress) {
+        char status[256];
+        snprintf(status, sizeof(status), "Installed packages changed: %d added or updated, %u removed",
+                 count, changes->removed->len);
+        gtk_label_set_text(GTK_LABEL(win->status_label), status);
+    }
+}
+
+static void on_local_db_changed(LocalDbChanges *changes, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    // Searches flag installed packages from the catalog's set
+    sync_catalog_update_installed(changes->removed, changes->changed);
+
+    // Not shown yet; the first load reads the current state anyway
+    if (!win->installed_packages_loaded) {
+        local_db_changes_free(changes);
+        return;
+    }
+    // The list being loaded may predate these changes
+    if (win->installed_loading) {
+        g_ptr_array_add(win->pending_installed_changes, changes);
+        return;
+    }
+
+    apply_installed_changes(win, changes);
+    local_db_changes_free(changes);
+}
+
+static void on_installed_packages_loaded(PackageList *packages, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+    win->installed_loading = FALSE;
+
+    if (packages) {
         char status[256];
         snprintf(status, sizeof(status), "Loaded %d installed packages", packages->count);
         gtk_label_set_text(GTK_LABEL(win->status_label), status);
     } else {
         gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to load installed packages");
     }
+
+    package_model_set_packages(win->installed_model, packages);
+
+    for (guint i = 0; i < win->pending_installed_changes->len; i++) {
+        apply_installed_changes(win, g_ptr_array_index(win->pending_installed_changes, i));
+    }
+    g_ptr_array_set_size(win->pending_installed_changes, 0);
     
     // Stop spinner and show list with smooth transition
     gtk_spinner_stop(GTK_SPINNER(win->installed_spinner));
@@ -366,12 +617,8 @@ static void populate_installed_packages(MainWindow *win) {
     gtk_label_set_text(GTK_LABEL(win->status_label), "Loading installed packages...");
 
     // Clear previous results
-    GtkWidget *child = gtk_widget_get_first_child(win->installed_list);
-    while (child) {
-        GtkWidget *next = gtk_widget_get_next_sibling(child);
-        gtk_list_box_remove(GTK_LIST_BOX(win->installed_list), child);
-        child = next;
-    }
+    package_model_set_packages(win->installed_model, NULL);
+    win->installed_loading = TRUE;
 
     // Show spinner with smooth transition
     gtk_stack_set_transition_type(GTK_STACK(win->installed_stack), GTK_STACK_TRANSITION_TYPE_SLIDE_UP);
@@ -394,23 +641,74 @@ static void on_refresh_installed_clicked(GtkButton *button, gpointer user_data)
     populate_installed_packages(win);
 }
 
-static void on_installed_package_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data) {
+static void on_installed_package_selected(GObject *selection, GParamSpec *pspec, gpointer user_data) {
     MainWindow *win = (MainWindow*)user_data;
 
-    if (row && !win->operation_in_progress) {
-        const char *pkg_name = g_object_get_data(G_OBJECT(row), "package_name");
-        if (pkg_name) {
-            free(win->selected_package);
-            win->selected_package = strdup(pkg_name);
+    PackageItem *item = gtk_single_selection_get_selected_item(win->installed_selection);
+    if (item) {
+        free(win->selected_package);
+        win->selected_package = strdup(package_item_get_package(item)->name);
 
-            // For installed packages, only enable remove and dependencies
-            gtk_widget_set_sensitive(win->install_btn, FALSE);
-            gtk_widget_set_sensitive(win->remove_btn, TRUE);
-            gtk_widget_set_sensitive(win->deps_btn, TRUE);
-        }
+        // For installed packages, only enable remove and dependencies
+        gtk_widget_set_sensitive(win->install_btn, FALSE);
+        gtk_widget_set_sensitive(win->remove_btn, TRUE);
+        gtk_widget_set_sensitive(win->queue_install_btn, FALSE);
+        gtk_widget_set_sensitive(win->queue_remove_btn, TRUE);
+        gtk_widget_set_sensitive(win->deps_btn, TRUE);
     }
 }
 
+// Row widgets are created once per visible slot and rebound while scrolling
+static void on_package_row_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+
+    GtkWidget *name_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
+
+    GtkWidget *desc_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(desc_label), 0.0);
+    gtk_label_set_wrap(GTK_LABEL(desc_label), TRUE);
+
+    gtk_box_append(GTK_BOX(box), name_label);
+    gtk_box_append(GTK_BOX(box), desc_label);
+    gtk_list_item_set_child(list_item, box);
+}
+
+static void on_package_row_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    gboolean show_repository = GPOINTER_TO_INT(user_data);
+    const Package *pkg = package_item_get_package(gtk_list_item_get_item(list_item));
+
+    GtkWidget *box = gtk_list_item_get_child(list_item);
+    GtkWidget *name_label = gtk_widget_get_first_child(box);
+    GtkWidget *desc_label = gtk_widget_get_next_sibling(name_label);
+
+    char *title;
+    if (show_repository) {
+        title = g_markup_printf_escaped("<b>%s</b> (%s) [%s]%s", pkg->name, pkg->version, pkg->repository,
+                                        pkg->installed ? " [installed]" : "");
+    } else {
+        title = g_markup_printf_escaped("<b>%s</b> (%s)", pkg->name, pkg->version);
+    }
+    gtk_label_set_markup(GTK_LABEL(name_label), title);
+    g_free(title);
+
+    gtk_label_set_text(GTK_LABEL(desc_label), pkg->description ? pkg->description : "");
+}
+
+static GtkWidget* package_list_view_new(PackageModel *model, GtkSingleSelection **selection,
+                                        gboolean show_repository) {
+    *selection = gtk_single_selection_new(G_LIST_MODEL(g_object_ref(model)));
+    gtk_single_selection_set_autoselect(*selection, FALSE);
+    gtk_single_selection_set_can_unselect(*selection, TRUE);
+
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(on_package_row_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(on_package_row_bind), GINT_TO_POINTER(show_repository));
+
+    // The view takes ownership of both the selection and the factory
+    return gtk_list_view_new(GTK_SELECTION_MODEL(*selection), factory);
+}
+
 static void on_notebook_page_switched(GtkNotebook *notebook, GtkWidget *page, guint page_num, gpointer user_data) {
     MainWindow *win = (MainWindow*)user_data;
     
@@ -421,12 +719,47 @@ static void on_notebook_page_switched(GtkNotebook *notebook, GtkWidget *page, gu
     }
 }
 
-static void update_cache_size_label(MainWindow *win) {
-    char *cache_size = pacman_get_cache_size();
+static gint compare_package_bytes(gconstpointer a, gconstpointer b) {
+    const CachePackage *pa = *(const CachePackage *const *)a;
+    const CachePackage *pb = *(const CachePackage *const *)b;
+    return pa->bytes < pb->bytes ? 1 : pa->bytes > pb->bytes ? -1 : 0;
+}
+
+static void on_cache_scanned(CacheScanner *scanner, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    char *size = g_format_size(cache_scanner_get_total_bytes(scanner));
     char label_text[128];
-    snprintf(label_text, sizeof(label_text), "Cache size: %s", cache_size);
+    snprintf(label_text, sizeof(label_text), "Cache size: %s (%u packages)",
+             size, cache_scanner_get_package_count(scanner));
     gtk_label_set_text(GTK_LABEL(win->cache_size_label), label_text);
-    free(cache_size);
+    g_free(size);
+
+    // The largest cached packages, with versions
+    GPtrArray *packages = cache_scanner_list_packages(scanner);
+    g_ptr_array_sort(packages, compare_package_bytes);
+    GString *tooltip = g_string_new(NULL);
+    for (guint i = 0; i < MIN(packages->len, CACHE_TOOLTIP_PACKAGES); i++) {
+        CachePackage *package = g_ptr_array_index(packages, i);
+        char *bytes = g_format_size(package->bytes);
+        g_string_append_printf(tooltip, "%s%s %s: %s", i > 0 ? "\n" : "", package->name, package->version, bytes);
+        g_free(bytes);
+    }
+    gtk_widget_set_tooltip_text(win->cache_size_label, tooltip->len > 0 ? tooltip->str : NULL);
+    g_string_free(tooltip, TRUE);
+    g_ptr_array_unref(packages);
+
+    if (win->prune_dialog) prune_dialog_refresh(win->prune_dialog);
+}
+
+static void on_sync_catalog_loaded(int package_count, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    if (win->operation_in_progress) return;
+
+    char status[256];
+    snprintf(status, sizeof(status), "Loaded %d packages from sync databases", package_count);
+    gtk_label_set_text(GTK_LABEL(win->status_label), status);
 }
 
 static void on_clean_cache_clicked(GtkButton *button, gpointer user_data) {
@@ -435,13 +768,12 @@ static void on_clean_cache_clicked(GtkButton *button, gpointer user_data) {
     if (win->operation_in_progress) return;
 
     win->operation_in_progress = TRUE;
-    gtk_widget_set_sensitive(win->install_btn, FALSE);
-    gtk_widget_set_sensitive(win->remove_btn, FALSE);
     gtk_widget_set_sensitive(win->update_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, FALSE);
 
     gtk_label_set_text(GTK_LABEL(win->status_label), "Cleaning package cache...");
 
@@ -451,17 +783,13 @@ static void on_clean_cache_clicked(GtkButton *button, gpointer user_data) {
 
     if (!success) {
         win->operation_in_progress = FALSE;
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
         gtk_widget_set_sensitive(win->update_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+        gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
         gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start cache cleaning");
-    } else {
-        // Update cache size after cleaning
-        g_idle_add((GSourceFunc)update_cache_size_label, win);
     }
 }
 
@@ -483,13 +811,12 @@ static void on_clean_all_cache_clicked(GtkButton *button, gpointer user_data) {
     gtk_window_destroy(GTK_WINDOW(dialog));
 
     win->operation_in_progress = TRUE;
-    gtk_widget_set_sensitive(win->install_btn, FALSE);
-    gtk_widget_set_sensitive(win->remove_btn, FALSE);
     gtk_widget_set_sensitive(win->update_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
     gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, FALSE);
 
     gtk_label_set_text(GTK_LABEL(win->status_label), "Cleaning all package cache...");
 
@@ -499,29 +826,81 @@ static void on_clean_all_cache_clicked(GtkButton *button, gpointer user_data) {
 
     if (!success) {
         win->operation_in_progress = FALSE;
-        gtk_widget_set_sensitive(win->install_btn, TRUE);
-        gtk_widget_set_sensitive(win->remove_btn, TRUE);
         gtk_widget_set_sensitive(win->update_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
         gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+        gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
         gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start cache cleaning");
-    } else {
-        // Update cache size after cleaning
-        g_idle_add((GSourceFunc)update_cache_size_label, win);
     }
 }
 
+static gboolean on_prune_confirmed(const char *const *files, int count, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    // Keep the dialog open rather than dropping the confirmed removal
+    if (win->operation_in_progress) {
+        prune_dialog_set_message(win->prune_dialog,
+                                 "Another operation is running; remove the files once it has finished");
+        return FALSE;
+    }
+
+    win->operation_in_progress = TRUE;
+    gtk_widget_set_sensitive(win->update_btn, FALSE);
+    gtk_widget_set_sensitive(win->clean_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->clean_all_cache_btn, FALSE);
+    gtk_widget_set_sensitive(win->prune_cache_btn, FALSE);
+
+    gtk_label_set_text(GTK_LABEL(win->status_label), "Pruning package cache...");
+
+    show_log_window(win);
+
+    if (!pacman_prune_cache_async(files, count, log_output_callback, NULL, win)) {
+        win->operation_in_progress = FALSE;
+        gtk_widget_set_sensitive(win->update_btn, TRUE);
+        gtk_widget_set_sensitive(win->clean_cache_btn, TRUE);
+        gtk_widget_set_sensitive(win->clean_all_cache_btn, TRUE);
+        gtk_widget_set_sensitive(win->prune_cache_btn, TRUE);
+        gtk_label_set_text(GTK_LABEL(win->status_label), "Failed to start cache pruning");
+        prune_dialog_set_message(win->prune_dialog, "Failed to start cache pruning");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void on_prune_cache_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *win = (MainWindow*)user_data;
+
+    if (win->operation_in_progress) return;
+
+    if (!win->prune_dialog) {
+        win->prune_dialog = prune_dialog_new(GTK_WINDOW(win->window), win->cache_scanner, on_prune_confirmed, win);
+    }
+    prune_dialog_show(win->prune_dialog);
+}
+
 MainWindow* main_window_new(void) {
     MainWindow *win = malloc(sizeof(MainWindow));
     win->selected_package = NULL;
-    win->operation_in_progress = FALSE;
+    win->log_window = NULL;
+    win->log_view = NULL;
+    win->download_frame = NULL;
+    win->download_grid = NULL;
+    win->download_rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    win->download_row_count = 0;
+    win->transaction_progress = transaction_progress_new(on_transaction_event, win);
+    win->queue = transaction_queue_new(log_output_callback, on_queue_batch, win);
+    win->queue_autostart = FALSE;
     win->log_window = NULL;
     win->dep_viewer = NULL;
-    win->current_packages = NULL;
-    win->installed_packages = NULL;
+    win->prune_dialog = NULL;
+    win->search_model = package_model_new();
+    win->installed_model = package_model_new();
+    win->search_pipeline = search_pipeline_new(on_search_results, win);
     win->installed_packages_loaded = FALSE;
+    win->installed_loading = FALSE;
+    win->pending_installed_changes = g_ptr_array_new_with_free_func((GDestroyNotify)local_db_changes_free);
 
     // Create window
     win->window = gtk_window_new();
@@ -548,6 +927,7 @@ MainWindow* main_window_new(void) {
     win->source_combo = gtk_combo_box_text_new();
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win->source_combo), "Official Repos");
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win->source_combo), "AUR");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win->source_combo), "All Sources");
     gtk_combo_box_set_active(GTK_COMBO_BOX(win->source_combo), 0);
 
     gtk_box_append(GTK_BOX(source_box), source_label);
@@ -557,6 +937,7 @@ MainWindow* main_window_new(void) {
     GtkWidget *search_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     win->search_entry = gtk_entry_new();
     gtk_entry_set_placeholder_text(GTK_ENTRY(win->search_entry), "Search packages...");
+    g_signal_connect(win->search_entry, "changed", G_CALLBACK(on_search_changed), win);
 
     GtkWidget *search_btn = gtk_button_new_with_label("Search");
     g_signal_connect(search_btn, "clicked", G_CALLBACK(on_search_clicked), win);
@@ -570,8 +951,8 @@ MainWindow* main_window_new(void) {
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(search_scrolled),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
 
-    win->package_list = gtk_list_box_new();
-    g_signal_connect(win->package_list, "row-selected",
+    win->package_list = package_list_view_new(win->search_model, &win->search_selection, TRUE);
+    g_signal_connect(win->search_selection, "notify::selected",
                      G_CALLBACK(on_package_selected), win);
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(search_scrolled), win->package_list);
 
@@ -617,8 +998,8 @@ MainWindow* main_window_new(void) {
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(installed_scrolled),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
 
-    win->installed_list = gtk_list_box_new();
-    g_signal_connect(win->installed_list, "row-selected",
+    win->installed_list = package_list_view_new(win->installed_model, &win->installed_selection, FALSE);
+    g_signal_connect(win->installed_selection, "notify::selected",
                      G_CALLBACK(on_installed_package_selected), win);
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(installed_scrolled), win->installed_list);
     
@@ -678,40 +1059,97 @@ MainWindow* main_window_new(void) {
     gtk_box_append(GTK_BOX(btn_box), win->deps_btn);
     gtk_box_append(GTK_BOX(btn_box), win->update_btn);
 
+    // === QUEUE SECTION ===
+    // Staged installs and removals are applied as one transaction per kind
+    GtkWidget *queue_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+
+    win->queue_install_btn = gtk_button_new_with_label("Queue Install");
+    win->queue_remove_btn = gtk_button_new_with_label("Queue Remove");
+    win->apply_queue_btn = gtk_button_new_with_label("Apply Queue (0)");
+    win->clear_queue_btn = gtk_button_new_with_label("Clear Queue");
+
+    gtk_widget_set_sensitive(win->queue_install_btn, FALSE);
+    gtk_widget_set_sensitive(win->queue_remove_btn, FALSE);
+    gtk_widget_set_sensitive(win->apply_queue_btn, FALSE);
+    gtk_widget_set_sensitive(win->clear_queue_btn, FALSE);
+
+    g_signal_connect(win->queue_install_btn, "clicked", G_CALLBACK(on_queue_install_clicked), win);
+    g_signal_connect(win->queue_remove_btn, "clicked", G_CALLBACK(on_queue_remove_clicked), win);
+    g_signal_connect(win->apply_queue_btn, "clicked", G_CALLBACK(on_apply_queue_clicked), win);
+    g_signal_connect(win->clear_queue_btn, "clicked", G_CALLBACK(on_clear_queue_clicked), win);
+
+    gtk_box_append(GTK_BOX(queue_box), win->queue_install_btn);
+    gtk_box_append(GTK_BOX(queue_box), win->queue_remove_btn);
+    gtk_box_append(GTK_BOX(queue_box), win->apply_queue_btn);
+    gtk_box_append(GTK_BOX(queue_box), win->clear_queue_btn);
+
     // === CACHE MANAGEMENT SECTION ===
     GtkWidget *cache_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     
     win->cache_size_label = gtk_label_new("Cache size: calculating...");
     win->clean_cache_btn = gtk_button_new_with_label("Clean Cache (old packages)");
     win->clean_all_cache_btn = gtk_button_new_with_label("Clean All Cache");
+    win->prune_cache_btn = gtk_button_new_with_label("Prune Cache...");
+    gtk_widget_set_tooltip_text(win->prune_cache_btn, "Remove old package versions by policy, with a preview");
 
     g_signal_connect(win->clean_cache_btn, "clicked", G_CALLBACK(on_clean_cache_clicked), win);
     g_signal_connect(win->clean_all_cache_btn, "clicked", G_CALLBACK(on_clean_all_cache_clicked), win);
+    g_signal_connect(win->prune_cache_btn, "clicked", G_CALLBACK(on_prune_cache_clicked), win);
 
     gtk_box_append(GTK_BOX(cache_box), win->cache_size_label);
     gtk_box_append(GTK_BOX(cache_box), win->clean_cache_btn);
     gtk_box_append(GTK_BOX(cache_box), win->clean_all_cache_btn);
+    gtk_box_append(GTK_BOX(cache_box), win->prune_cache_btn);
 
     // === STATUS BAR ===
+    GtkWidget *status_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
     win->status_label = gtk_label_new("Ready");
     gtk_label_set_xalign(GTK_LABEL(win->status_label), 0.0);
+    gtk_widget_set_hexpand(win->status_label, TRUE);
+
+    // Phase and overall position of the running transaction
+    win->operation_progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(win->operation_progress), TRUE);
+    gtk_progress_bar_set_ellipsize(GTK_PROGRESS_BAR(win->operation_progress), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_size_request(win->operation_progress, 300, -1);
+    gtk_widget_set_valign(win->operation_progress, GTK_ALIGN_CENTER);
+    gtk_widget_set_visible(win->operation_progress, FALSE);
+
+    gtk_box_append(GTK_BOX(status_box), win->status_label);
+    gtk_box_append(GTK_BOX(status_box), win->operation_progress);
 
     // Pack everything into main container
     gtk_box_append(GTK_BOX(vbox), win->notebook);
     gtk_box_append(GTK_BOX(vbox), btn_box);
+    gtk_box_append(GTK_BOX(vbox), queue_box);
     gtk_box_append(GTK_BOX(vbox), cache_box);
-    gtk_box_append(GTK_BOX(vbox), win->status_label);
+    gtk_box_append(GTK_BOX(vbox), status_box);
 
     gtk_window_set_child(GTK_WINDOW(win->window), vbox);
 
-    // Initialize cache size display
-    update_cache_size_label(win);
+    // Sized on a worker pool, then kept current as files come and go
+    win->cache_scanner = cache_scanner_new(pacman_get_cache_dir(), on_cache_scanned, win);
 
     // Detect AUR helper on startup
     set_aur_helper(detect_aur_helper());
 
-    // Don't load installed packages immediately to speed up startup
-    win->installed_packages_loaded = FALSE;
+    // Installs and removals, from here or from a terminal, update the
+    // installed list in place
+    win->local_db_watcher = local_db_watcher_new(pacman_get_db_path(), on_local_db_changed, win);
+
+    // Load sync databases in the background so searches run in memory
+    sync_catalog_load_async(on_sync_catalog_loaded, win);
+
+    // An up-to-date snapshot only needs mapping, so the installed tab starts
+    // populated; a stale one is rebuilt by the catalog load above
+    guint generation = sync_catalog_installed_generation();
+    PackageList *installed = pacman_list_installed_cached();
+    if (installed) {
+        sync_catalog_set_installed(installed, generation);
+        package_model_set_packages(win->installed_model, installed);
+        gtk_stack_set_visible_child_name(GTK_STACK(win->installed_stack), "list");
+        win->installed_packages_loaded = TRUE;
+    }
 
     return win;
 }
@@ -722,9 +1160,18 @@ void main_window_show(MainWindow *win) {
 
 void main_window_free(MainWindow *win) {
     if (win->selected_package) free(win->selected_package);
-    if (win->current_packages) package_list_free(win->current_packages);
-    if (win->installed_packages) package_list_free(win->installed_packages);
+    search_pipeline_free(win->search_pipeline);
+    g_object_unref(win->search_model);
+    g_object_unref(win->installed_model);
+    log_view_free(win->log_view);
+    transaction_progress_free(win->transaction_progress);
+    transaction_queue_free(win->queue);
+    cache_scanner_free(win->cache_scanner);
+    local_db_watcher_free(win->local_db_watcher);
+    g_ptr_array_free(win->pending_installed_changes, TRUE);
+    g_hash_table_destroy(win->download_rows);
     if (win->log_window) gtk_window_destroy(GTK_WINDOW(win->log_window));
     if (win->dep_viewer) dependency_viewer_free(win->dep_viewer);
+    prune_dialog_free(win->prune_dialog);
     free(win);
 }
\ No newline at end of file
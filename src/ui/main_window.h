@@ -4,6 +4,14 @@
 #include <gtk-4.0/gtk/gtk.h>
 #include "../pacman_wrapper.h"
 #include "dependency_viewer.h"
+#include "prune_dialog.h"
+#include "package_model.h"
+#include "log_view.h"
+#include "../search_pipeline.h"
+#include "../transaction_progress.h"
+#include "../transaction_queue.h"
+#include "../cache_scan.h"
+#include "../local_db_watch.h"
 
 typedef struct {
     GtkWidget *window;
@@ -13,9 +21,14 @@ typedef struct {
     GtkWidget *search_entry;
     GtkWidget *package_list;
     GtkWidget *source_combo;
+    PackageModel *search_model;
+    GtkSingleSelection *search_selection;
+    SearchPipeline *search_pipeline;
     
     // Installed packages tab widgets
     GtkWidget *installed_list;
+    PackageModel *installed_model;
+    GtkSingleSelection *installed_selection;
     GtkWidget *refresh_installed_btn;
     GtkWidget *installed_spinner;
     GtkWidget *installed_stack;
@@ -26,23 +39,40 @@ typedef struct {
     GtkWidget *remove_btn;
     GtkWidget *update_btn;
     GtkWidget *deps_btn;
+    GtkWidget *queue_install_btn;
+    GtkWidget *queue_remove_btn;
+    GtkWidget *apply_queue_btn;
+    GtkWidget *clear_queue_btn;
     GtkWidget *clean_cache_btn;
     GtkWidget *clean_all_cache_btn;
+    GtkWidget *prune_cache_btn;
     GtkWidget *cache_size_label;
     GtkWidget *status_label;
+    GtkWidget *operation_progress;      // Shown while an operation runs
 
     // Log window widgets
     GtkWidget *log_window;
     GtkWidget *log_textview;
-    GtkTextBuffer *log_buffer;
+    LogView *log_view;
     GtkWidget *close_log_btn;
+    GtkWidget *download_frame;
+    GtkWidget *download_grid;
+    GHashTable *download_rows;          // File name -> DownloadRow
+    int download_row_count;
+
+    TransactionProgress *transaction_progress;
+    TransactionQueue *queue;
+    gboolean queue_autostart;           // Apply the queue once the running operation ends
+    CacheScanner *cache_scanner;
+    LocalDbWatcher *local_db_watcher;
+    GPtrArray *pending_installed_changes; // LocalDbChanges* that arrived during a reload
 
-    PackageList *current_packages;
-    PackageList *installed_packages;
     char *selected_package;
     gboolean operation_in_progress;
     gboolean installed_packages_loaded;
+    gboolean installed_loading;         // A full reload of the installed list is running
     DependencyViewer *dep_viewer;
+    PruneDialog *prune_dialog;
 } MainWindow;
 
 MainWindow* main_window_new(void);
@@ -0,0 +1,268 @@
+#include "package_model.h"
+#include <string.h>
+
+// PackageList is not reference counted itself, but items outlive the model's
+// current list when it is replaced while rows are still bound.
+typedef struct {
+    gint ref_count;
+    PackageList *packages;
+} SharedPackageList;
+
+// A run of consecutive packages of one list. Results streamed in batches
+// are kept as one chunk per batch, so appending never copies the packages
+// already shown; removing rows splits a chunk instead.
+typedef struct {
+    SharedPackageList *list;
+    guint start;            // Index of the first package in list
+    guint count;
+    guint offset;           // Model position of the first package
+} PackageChunk;
+
+struct _PackageModel {
+    GObject parent_instance;
+    GPtrArray *chunks;      // PackageChunk*, in model order
+    guint n_items;
+};
+
+struct _PackageItem {
+    GObject parent_instance;
+    SharedPackageList *list;
+    guint position;
+};
+
+static SharedPackageList* shared_list_new(PackageList *packages) {
+    SharedPackageList *list = g_malloc(sizeof(SharedPackageList));
+    list->ref_count = 1;
+    list->packages = packages;
+    return list;
+}
+
+static SharedPackageList* shared_list_ref(SharedPackageList *list) {
+    g_atomic_int_inc(&list->ref_count);
+    return list;
+}
+
+static void shared_list_unref(SharedPackageList *list) {
+    if (list && g_atomic_int_dec_and_test(&list->ref_count)) {
+        package_list_free(list->packages);
+        g_free(list);
+    }
+}
+
+// Takes over the caller's reference to list
+static PackageChunk* chunk_new(SharedPackageList *list, guint start, guint count) {
+    PackageChunk *chunk = g_malloc(sizeof(PackageChunk));
+    chunk->list = list;
+    chunk->start = start;
+    chunk->count = count;
+    chunk->offset = 0;
+    return chunk;
+}
+
+static void chunk_free(PackageChunk *chunk) {
+    shared_list_unref(chunk->list);
+    g_free(chunk);
+}
+
+// --- PackageItem ---
+
+G_DEFINE_TYPE(PackageItem, package_item, G_TYPE_OBJECT)
+
+static void package_item_finalize(GObject *object) {
+    PackageItem *item = PACKAGE_ITEM(object);
+    shared_list_unref(item->list);
+    G_OBJECT_CLASS(package_item_parent_class)->finalize(object);
+}
+
+static void package_item_class_init(PackageItemClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = package_item_finalize;
+}
+
+static void package_item_init(PackageItem *item) {
+    item->list = NULL;
+    item->position = 0;
+}
+
+const Package* package_item_get_package(PackageItem *item) {
+    return &item->list->packages->packages[item->position];
+}
+
+// --- PackageModel ---
+
+static GType package_model_get_item_type(GListModel *list) {
+    return PACKAGE_TYPE_ITEM;
+}
+
+static guint package_model_get_n_items(GListModel *list) {
+    return PACKAGE_MODEL(list)->n_items;
+}
+
+// Index of the chunk holding position, which must be < n_items
+static guint find_chunk_index(PackageModel *model, guint position) {
+    guint low = 0;
+    guint high = model->chunks->len;
+    while (high - low > 1) {
+        guint mid = low + (high - low) / 2;
+        if (((PackageChunk*)g_ptr_array_index(model->chunks, mid))->offset <= position) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static PackageChunk* find_chunk(PackageModel *model, guint position) {
+    if (position >= model->n_items) return NULL;
+    return g_ptr_array_index(model->chunks, find_chunk_index(model, position));
+}
+
+static gpointer package_model_get_item(GListModel *list, guint position) {
+    PackageChunk *chunk = find_chunk(PACKAGE_MODEL(list), position);
+    if (!chunk) return NULL;
+
+    PackageItem *item = g_object_new(PACKAGE_TYPE_ITEM, NULL);
+    item->list = shared_list_ref(chunk->list);
+    item->position = chunk->start + position - chunk->offset;
+    return item;
+}
+
+static void package_model_list_model_init(GListModelInterface *iface) {
+    iface->get_item_type = package_model_get_item_type;
+    iface->get_n_items = package_model_get_n_items;
+    iface->get_item = package_model_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE(PackageModel, package_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, package_model_list_model_init))
+
+static void package_model_finalize(GObject *object) {
+    PackageModel *model = PACKAGE_MODEL(object);
+    g_ptr_array_free(model->chunks, TRUE);
+    G_OBJECT_CLASS(package_model_parent_class)->finalize(object);
+}
+
+static void package_model_class_init(PackageModelClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = package_model_finalize;
+}
+
+static void package_model_init(PackageModel *model) {
+    model->chunks = g_ptr_array_new_with_free_func((GDestroyNotify)chunk_free);
+    model->n_items = 0;
+}
+
+PackageModel* package_model_new(void) {
+    return g_object_new(PACKAGE_TYPE_MODEL, NULL);
+}
+
+void package_model_set_packages(PackageModel *model, PackageList *packages) {
+    guint removed = model->n_items;
+
+    g_ptr_array_set_size(model->chunks, 0);
+    model->n_items = 0;
+
+    if (packages && packages->count > 0) {
+        g_ptr_array_add(model->chunks, chunk_new(shared_list_new(packages), 0, packages->count));
+        model->n_items = packages->count;
+    } else {
+        package_list_free(packages);
+    }
+
+    if (removed > 0 || model->n_items > 0) {
+        g_list_model_items_changed(G_LIST_MODEL(model), 0, removed, model->n_items);
+    }
+}
+
+void package_model_append_packages(PackageModel *model, PackageList *packages) {
+    if (!packages || packages->count == 0) {
+        package_list_free(packages);
+        return;
+    }
+
+    guint position = model->n_items;
+    PackageChunk *chunk = chunk_new(shared_list_new(packages), 0, packages->count);
+    chunk->offset = position;
+    g_ptr_array_add(model->chunks, chunk);
+    model->n_items += packages->count;
+
+    g_list_model_items_changed(G_LIST_MODEL(model), position, 0, packages->count);
+}
+
+// Splits the chunk holding position so that a chunk starts there; returns
+// the index of that chunk (chunks->len if position == n_items)
+static guint split_at(PackageModel *model, guint position) {
+    if (position >= model->n_items) return model->chunks->len;
+
+    guint index = find_chunk_index(model, position);
+    PackageChunk *chunk = g_ptr_array_index(model->chunks, index);
+    guint head = position - chunk->offset;
+    if (head == 0) return index;
+
+    PackageChunk *tail = chunk_new(shared_list_ref(chunk->list), chunk->start + head, chunk->count - head);
+    tail->offset = position;
+    chunk->count = head;
+    g_ptr_array_insert(model->chunks, index + 1, tail);
+    return index + 1;
+}
+
+static void update_offsets(PackageModel *model, guint from_index) {
+    guint offset = 0;
+    if (from_index > 0) {
+        PackageChunk *previous = g_ptr_array_index(model->chunks, from_index - 1);
+        offset = previous->offset + previous->count;
+    }
+    for (guint i = from_index; i < model->chunks->len; i++) {
+        PackageChunk *chunk = g_ptr_array_index(model->chunks, i);
+        chunk->offset = offset;
+        offset += chunk->count;
+    }
+}
+
+void package_model_insert_packages(PackageModel *model, guint position, PackageList *packages) {
+    if (!packages || packages->count == 0) {
+        package_list_free(packages);
+        return;
+    }
+    position = MIN(position, model->n_items);
+
+    guint index = split_at(model, position);
+    g_ptr_array_insert(model->chunks, index, chunk_new(shared_list_new(packages), 0, packages->count));
+    model->n_items += packages->count;
+    update_offsets(model, index);
+
+    g_list_model_items_changed(G_LIST_MODEL(model), position, 0, packages->count);
+}
+
+void package_model_remove(PackageModel *model, guint position, guint count) {
+    if (position >= model->n_items || count == 0) return;
+    count = MIN(count, model->n_items - position);
+
+    guint first = split_at(model, position);
+    guint last = split_at(model, position + count);
+    g_ptr_array_remove_range(model->chunks, first, last - first);
+    model->n_items -= count;
+    update_offsets(model, first);
+
+    g_list_model_items_changed(G_LIST_MODEL(model), position, count, 0);
+}
+
+const Package* package_model_get_package(PackageModel *model, guint position) {
+    PackageChunk *chunk = find_chunk(model, position);
+    return chunk ? &chunk->list->packages->packages[chunk->start + position - chunk->offset] : NULL;
+}
+
+gboolean package_model_find_by_name(PackageModel *model, const char *name, guint *position) {
+    guint low = 0;
+    guint high = model->n_items;
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        if (strcmp(package_model_get_package(model, mid)->name, name) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *position = low;
+    return low < model->n_items && strcmp(package_model_get_package(model, low)->name, name) == 0;
+}
@@ -0,0 +1,32 @@
+#ifndef PACKAGE_MODEL_H
+#define PACKAGE_MODEL_H
+
+#include <gtk-4.0/gtk/gtk.h>
+#include "../pacman_wrapper.h"
+
+// GListModel over a PackageList. Items are created on demand when a row
+// asks for one, so a GtkListView only ever materializes the visible rows.
+#define PACKAGE_TYPE_MODEL (package_model_get_type())
+G_DECLARE_FINAL_TYPE(PackageModel, package_model, PACKAGE, MODEL, GObject)
+
+// Item type handed out by the model; it keeps its package alive even after
+// the model switches to another list
+#define PACKAGE_TYPE_ITEM (package_item_get_type())
+G_DECLARE_FINAL_TYPE(PackageItem, package_item, PACKAGE, ITEM, GObject)
+
+PackageModel* package_model_new(void);
+// Both take ownership of packages (may be NULL). set replaces the current
+// contents; append adds a batch after them without touching existing rows.
+void package_model_set_packages(PackageModel *model, PackageList *packages);
+void package_model_append_packages(PackageModel *model, PackageList *packages);
+// Takes ownership of packages and inserts them before position
+void package_model_insert_packages(PackageModel *model, guint position, PackageList *packages);
+void package_model_remove(PackageModel *model, guint position, guint count);
+const Package* package_model_get_package(PackageModel *model, guint position);
+// For models sorted by name: TRUE if a package called name is at *position,
+// otherwise *position is where it would be inserted
+gboolean package_model_find_by_name(PackageModel *model, const char *name, guint *position);
+
+const Package* package_item_get_package(PackageItem *item);
+
+#endif
@@ -0,0 +1,162 @@
+#include "prune_dialog.h"
+#include "../pacman_wrapper.h"
+#include <stdio.h>
+
+// paccache keeps three versions by default
+#define DEFAULT_KEEP_VERSIONS 3
+
+void prune_dialog_refresh(PruneDialog *dialog) {
+    if (!gtk_widget_get_visible(dialog->window)) return;
+
+    cache_prune_plan_free(dialog->plan);
+    dialog->plan = NULL;
+
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->preview_view));
+    if (!cache_scanner_is_ready(dialog->scanner)) {
+        gtk_label_set_text(GTK_LABEL(dialog->summary_label), "Scanning the package cache...");
+        gtk_text_buffer_set_text(buffer, "", 0);
+        gtk_widget_set_sensitive(dialog->prune_btn, FALSE);
+        return;
+    }
+
+    CachePrunePolicy policy = {
+        gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dialog->keep_spin)),
+        gtk_check_button_get_active(GTK_CHECK_BUTTON(dialog->installed_check)),
+        gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dialog->age_spin))
+    };
+    dialog->plan = cache_prune_plan(dialog->scanner, &policy, dialog->installed, g_get_real_time() / G_USEC_PER_SEC);
+
+    GString *preview = g_string_new(NULL);
+    for (guint i = 0; i < dialog->plan->entries->len; i++) {
+        const CachePruneEntry *entry = &g_array_index(dialog->plan->entries, CachePruneEntry, i);
+        char *size = g_format_size(entry->bytes);
+        g_string_append_printf(preview, "%s %s (%s)  %s\n", entry->name, entry->version, entry->arch, size);
+        g_free(size);
+    }
+    gtk_text_buffer_set_text(buffer, preview->str, preview->len);
+    g_string_free(preview, TRUE);
+
+    char *size = g_format_size(dialog->plan->bytes);
+    char summary[256];
+    snprintf(summary, sizeof(summary), "%u package versions, %u files, %s to reclaim",
+             dialog->plan->entries->len, dialog->plan->files->len, size);
+    gtk_label_set_text(GTK_LABEL(dialog->summary_label), summary);
+    g_free(size);
+
+    gtk_widget_set_sensitive(dialog->prune_btn, dialog->plan->files->len > 0);
+}
+
+static void on_policy_changed(GtkWidget *widget, gpointer user_data) {
+    prune_dialog_refresh((PruneDialog*)user_data);
+}
+
+static void on_prune_clicked(GtkButton *button, gpointer user_data) {
+    PruneDialog *dialog = (PruneDialog*)user_data;
+    if (!dialog->plan || dialog->plan->files->len == 0) return;
+
+    if (dialog->confirm((const char *const *)dialog->plan->files->pdata, dialog->plan->files->len,
+                        dialog->user_data)) {
+        gtk_widget_set_visible(dialog->window, FALSE);
+    }
+}
+
+void prune_dialog_set_message(PruneDialog *dialog, const char *message) {
+    gtk_label_set_text(GTK_LABEL(dialog->summary_label), message);
+}
+
+PruneDialog* prune_dialog_new(GtkWindow *parent, CacheScanner *scanner,
+                              PruneConfirmCallback confirm, gpointer user_data) {
+    PruneDialog *dialog = g_malloc0(sizeof(PruneDialog));
+    dialog->scanner = scanner;
+    dialog->confirm = confirm;
+    dialog->user_data = user_data;
+
+    dialog->window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(dialog->window), "Prune Package Cache");
+    gtk_window_set_default_size(GTK_WINDOW(dialog->window), 600, 450);
+    gtk_window_set_transient_for(GTK_WINDOW(dialog->window), parent);
+    gtk_window_set_hide_on_close(GTK_WINDOW(dialog->window), TRUE);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_widget_set_margin_start(vbox, 10);
+    gtk_widget_set_margin_end(vbox, 10);
+    gtk_widget_set_margin_top(vbox, 10);
+    gtk_widget_set_margin_bottom(vbox, 10);
+
+    // === POLICY ===
+    GtkWidget *policy_grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(policy_grid), 5);
+    gtk_grid_set_column_spacing(GTK_GRID(policy_grid), 10);
+
+    GtkWidget *keep_label = gtk_label_new("Keep newest versions (0: none):");
+    gtk_label_set_xalign(GTK_LABEL(keep_label), 0.0);
+    dialog->keep_spin = gtk_spin_button_new_with_range(0, 100, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(dialog->keep_spin), DEFAULT_KEEP_VERSIONS);
+
+    GtkWidget *age_label = gtk_label_new("Keep versions newer than days (0: none):");
+    gtk_label_set_xalign(GTK_LABEL(age_label), 0.0);
+    dialog->age_spin = gtk_spin_button_new_with_range(0, 3650, 1);
+
+    dialog->installed_check = gtk_check_button_new_with_label("Keep installed versions");
+
+    g_signal_connect(dialog->keep_spin, "value-changed", G_CALLBACK(on_policy_changed), dialog);
+    g_signal_connect(dialog->age_spin, "value-changed", G_CALLBACK(on_policy_changed), dialog);
+    g_signal_connect(dialog->installed_check, "toggled", G_CALLBACK(on_policy_changed), dialog);
+
+    gtk_grid_attach(GTK_GRID(policy_grid), keep_label, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(policy_grid), dialog->keep_spin, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(policy_grid), age_label, 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(policy_grid), dialog->age_spin, 1, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(policy_grid), dialog->installed_check, 0, 2, 2, 1);
+
+    // === PREVIEW ===
+    dialog->summary_label = gtk_label_new("");
+    gtk_label_set_xalign(GTK_LABEL(dialog->summary_label), 0.0);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    dialog->preview_view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(dialog->preview_view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(dialog->preview_view), TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), dialog->preview_view);
+
+    // === BUTTONS ===
+    GtkWidget *btn_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_widget_set_halign(btn_box, GTK_ALIGN_END);
+    GtkWidget *close_btn = gtk_button_new_with_label("Close");
+    dialog->prune_btn = gtk_button_new_with_label("Remove Files");
+    gtk_widget_add_css_class(dialog->prune_btn, "destructive-action");
+    g_signal_connect_swapped(close_btn, "clicked", G_CALLBACK(gtk_window_close), dialog->window);
+    g_signal_connect(dialog->prune_btn, "clicked", G_CALLBACK(on_prune_clicked), dialog);
+    gtk_box_append(GTK_BOX(btn_box), close_btn);
+    gtk_box_append(GTK_BOX(btn_box), dialog->prune_btn);
+
+    gtk_box_append(GTK_BOX(vbox), policy_grid);
+    gtk_box_append(GTK_BOX(vbox), dialog->summary_label);
+    gtk_box_append(GTK_BOX(vbox), scrolled);
+    gtk_box_append(GTK_BOX(vbox), btn_box);
+
+    gtk_window_set_child(GTK_WINDOW(dialog->window), vbox);
+    return dialog;
+}
+
+void prune_dialog_show(PruneDialog *dialog) {
+    // Packages may have been installed or removed since the last time
+    if (dialog->installed) g_hash_table_destroy(dialog->installed);
+    char *local_dir = g_build_filename(pacman_get_db_path(), "local", NULL);
+    dialog->installed = cache_prune_installed_versions(local_dir);
+    g_free(local_dir);
+
+    gtk_window_present(GTK_WINDOW(dialog->window));
+    prune_dialog_refresh(dialog);
+}
+
+void prune_dialog_free(PruneDialog *dialog) {
+    if (!dialog) return;
+
+    cache_prune_plan_free(dialog->plan);
+    if (dialog->installed) g_hash_table_destroy(dialog->installed);
+    gtk_window_destroy(GTK_WINDOW(dialog->window));
+    g_free(dialog);
+}
@@ -0,0 +1,39 @@
+#ifndef PRUNE_DIALOG_H
+#define PRUNE_DIALOG_H
+
+#include <gtk-4.0/gtk/gtk.h>
+#include "../cache_prune.h"
+
+// Called with the files of the previewed plan when the user confirms.
+// Returns TRUE once their removal has started; otherwise the dialog stays
+// open, e.g. to show why with prune_dialog_set_message.
+typedef gboolean (*PruneConfirmCallback)(const char *const *files, int count, gpointer user_data);
+
+// Policy controls with a live preview of what pruning the cache would
+// remove. Hidden rather than destroyed when closed.
+typedef struct {
+    GtkWidget *window;
+    GtkWidget *keep_spin;
+    GtkWidget *installed_check;
+    GtkWidget *age_spin;
+    GtkWidget *summary_label;
+    GtkWidget *preview_view;
+    GtkWidget *prune_btn;
+
+    CacheScanner *scanner;
+    CachePrunePlan *plan;           // Of the preview on display, or NULL
+    GHashTable *installed;          // Name -> version, read when shown
+    PruneConfirmCallback confirm;
+    gpointer user_data;
+} PruneDialog;
+
+PruneDialog* prune_dialog_new(GtkWindow *parent, CacheScanner *scanner,
+                              PruneConfirmCallback confirm, gpointer user_data);
+void prune_dialog_show(PruneDialog *dialog);
+// Plans again; call whenever the cache index changes
+void prune_dialog_refresh(PruneDialog *dialog);
+// Shown in place of the plan summary until the plan changes
+void prune_dialog_set_message(PruneDialog *dialog, const char *message);
+void prune_dialog_free(PruneDialog *dialog);
+
+#endif
@@ -0,0 +1,123 @@
+#include "vercmp.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compares one version or release string segment by segment: runs of
+// digits numerically, runs of letters lexically, with numbers newer than
+// letters and a trailing alpha segment older than none ("1.0a" < "1.0").
+static int rpmvercmp(const char *a, const char *b) {
+    if (strcmp(a, b) == 0) return 0;
+
+    const char *one = a;
+    const char *two = b;
+
+    while (*one && *two) {
+        const char *sep_one = one;
+        const char *sep_two = two;
+        while (*one && !isalnum((unsigned char)*one)) one++;
+        while (*two && !isalnum((unsigned char)*two)) two++;
+
+        if (!*one || !*two) break;
+
+        // Differing separator lengths: the one with more separators wins
+        if ((one - sep_one) != (two - sep_two)) {
+            return (one - sep_one) < (two - sep_two) ? -1 : 1;
+        }
+
+        const char *start_one = one;
+        const char *start_two = two;
+        int numeric = isdigit((unsigned char)*one);
+
+        if (numeric) {
+            while (isdigit((unsigned char)*one)) one++;
+            while (isdigit((unsigned char)*two)) two++;
+        } else {
+            while (isalpha((unsigned char)*one)) one++;
+            while (isalpha((unsigned char)*two)) two++;
+        }
+
+        // The segment types differ: numeric is newer
+        if (two == start_two) return numeric ? 1 : -1;
+
+        if (numeric) {
+            while (*start_one == '0' && start_one < one - 1) start_one++;
+            while (*start_two == '0' && start_two < two - 1) start_two++;
+
+            size_t len_one = one - start_one;
+            size_t len_two = two - start_two;
+            if (len_one != len_two) return len_one < len_two ? -1 : 1;
+        }
+
+        size_t len_one = one - start_one;
+        size_t len_two = two - start_two;
+        int result = strncmp(start_one, start_two, len_one < len_two ? len_one : len_two);
+        if (result != 0) return result < 0 ? -1 : 1;
+        if (len_one != len_two) return len_one < len_two ? -1 : 1;
+    }
+
+    if (!*one && !*two) return 0;
+
+    // One string ran out: an alpha tail is older, anything else newer
+    if ((!*one && !isalpha((unsigned char)*two)) || isalpha((unsigned char)*one)) {
+        return -1;
+    }
+    return 1;
+}
+
+typedef struct {
+    char *epoch;
+    char *version;
+    char *release;  // NULL if absent
+} VersionParts;
+
+// Splits a copy of evr in place; parts point into buffer
+static void split_evr(char *buffer, VersionParts *parts) {
+    char *start = buffer;
+    while (isdigit((unsigned char)*start)) start++;
+
+    if (*start == ':') {
+        *start = '\0';
+        parts->epoch = buffer;
+        parts->version = start + 1;
+    } else {
+        parts->epoch = "0";
+        parts->version = buffer;
+    }
+
+    char *dash = strrchr(parts->version, '-');
+    if (dash) {
+        *dash = '\0';
+        parts->release = dash + 1;
+    } else {
+        parts->release = NULL;
+    }
+
+    if (*parts->epoch == '\0') parts->epoch = "0";
+}
+
+int vercmp(const char *a, const char *b) {
+    if (!a && !b) return 0;
+    if (!a) return -1;
+    if (!b) return 1;
+    if (strcmp(a, b) == 0) return 0;
+
+    char *copy_a = strdup(a);
+    char *copy_b = strdup(b);
+    VersionParts parts_a, parts_b;
+    split_evr(copy_a, &parts_a);
+    split_evr(copy_b, &parts_b);
+
+    int result = rpmvercmp(parts_a.epoch, parts_b.epoch);
+    if (result == 0) {
+        result = rpmvercmp(parts_a.version, parts_b.version);
+        // A missing release matches any release, like pacman
+        if (result == 0 && parts_a.release && parts_b.release) {
+            result = rpmvercmp(parts_a.release, parts_b.release);
+        }
+    }
+
+    free(copy_a);
+    free(copy_b);
+    return result;
+}
@@ -0,0 +1,8 @@
+#ifndef VERCMP_H
+#define VERCMP_H
+
+// Compares two package versions of the form [epoch:]version[-release] the
+// way `vercmp` (libalpm) does. Returns <0, 0 or >0 like strcmp.
+int vercmp(const char *a, const char *b);
+
+#endif
@@ -0,0 +1,187 @@
+#include "dep_graph.h"
+#include "vercmp.h"
+#include <string.h>
+#include <glib/gstdio.h>
+
+// Version comparison against libalpm's results, and dependency resolution
+// on a small local database written to a temporary directory.
+
+typedef struct {
+    const char *a;
+    const char *b;
+    int expected;
+} VercmpCase;
+
+static const VercmpCase vercmp_cases[] = {
+    { "1.5.0", "1.5.0", 0 },
+    { "1.5.1", "1.5.0", 1 },
+    { "1.10", "1.9", 1 },
+    { "001", "1", 0 },
+    { "1.5", "1.5.1", -1 },
+    // Releases, and a missing one matching any
+    { "1.5-1", "1.5-2", -1 },
+    { "1.5-2", "1.5.1-1", -1 },
+    { "1.5-10", "1.5-9", 1 },
+    { "1.1-1", "1.1", 0 },
+    { "1.1", "1.1-7", 0 },
+    // Epochs outweigh everything else; no epoch is epoch 0
+    { "1:1.0", "2.0", 1 },
+    { "0:1.0", "1.0", 0 },
+    { "1:1.0", "2:0.1", -1 },
+    { "2.0-1", "1:1.0-1", -1 },
+    // Letters: older than a number and than nothing at all
+    { "1.0a", "1.0", -1 },
+    { "1.0", "1.0a", 1 },
+    { "1.0a", "1.0b", -1 },
+    { "1.0alpha", "1.0beta", -1 },
+    { "1.0a", "1.0.1", -1 },
+    { "1.0rc1", "1.0", -1 },
+};
+
+static void test_vercmp(void) {
+    for (guint i = 0; i < G_N_ELEMENTS(vercmp_cases); i++) {
+        const VercmpCase *test = &vercmp_cases[i];
+        int result = vercmp(test->a, test->b);
+        int sign = (result > 0) - (result < 0);
+        if (sign != test->expected) {
+            g_error("vercmp(%s, %s) = %d, expected %d", test->a, test->b, sign, test->expected);
+        }
+
+        // And the other way round
+        result = vercmp(test->b, test->a);
+        g_assert_cmpint((result > 0) - (result < 0), ==, -test->expected);
+    }
+}
+
+typedef struct {
+    char *root;
+    char *local_dir;
+    GPtrArray *paths;       // Written files and directories, in creation order
+} TestDb;
+
+static void test_db_add(TestDb *db, const char *name, const char *version, const char *relations) {
+    char *entry = g_strdup_printf("%s/%s-%s", db->local_dir, name, version);
+    g_assert_cmpint(g_mkdir(entry, 0755), ==, 0);
+    g_ptr_array_add(db->paths, entry);
+
+    char *desc = g_strdup_printf("%%NAME%%\n%s\n\n%%VERSION%%\n%s\n\n%%DESC%%\nTest package\n\n%s",
+                                 name, version, relations);
+    char *path = g_build_filename(entry, "desc", NULL);
+    g_assert_true(g_file_set_contents(path, desc, -1, NULL));
+    g_ptr_array_add(db->paths, path);
+    g_free(desc);
+}
+
+static void test_db_free(TestDb *db) {
+    for (guint i = db->paths->len; i > 0; i--) g_remove(db->paths->pdata[i - 1]);
+    g_rmdir(db->local_dir);
+    g_rmdir(db->root);
+
+    g_ptr_array_free(db->paths, TRUE);
+    g_free(db->local_dir);
+    g_free(db->root);
+}
+
+// Node the dependency of node written as spec resolves to
+static int resolved_node(const DepGraph *graph, int node, const char *spec, DepEdgeStatus *status) {
+    int count;
+    const int *targets = dep_graph_depends(graph, node, &count);
+    for (int k = 0; k < count; k++) {
+        if (strcmp(dep_graph_depend_spec(graph, node, k), spec) == 0) {
+            *status = dep_graph_depend_status(graph, node, k);
+            return targets[k];
+        }
+    }
+    g_error("%s has no dependency %s", dep_graph_name(graph, node), spec);
+    return -1;
+}
+
+static void assert_resolves(const DepGraph *graph, int node, const char *spec, const char *target,
+                            DepEdgeStatus expected) {
+    DepEdgeStatus status;
+    int resolved = resolved_node(graph, node, spec, &status);
+    g_assert_cmpstr(dep_graph_name(graph, resolved), ==, target);
+    g_assert_cmpint(status, ==, expected);
+}
+
+static void test_resolution(void) {
+    TestDb db;
+    db.root = g_dir_make_tmp("test_dep_graph-XXXXXX", NULL);
+    g_assert_nonnull(db.root);
+    db.local_dir = g_build_filename(db.root, "local", NULL);
+    g_assert_cmpint(g_mkdir(db.local_dir, 0755), ==, 0);
+    db.paths = g_ptr_array_new_with_free_func(g_free);
+
+    test_db_add(&db, "app", "1.0-1",
+                "%DEPENDS%\nfoo>=2\nsh\nbar>=3\nmissing-lib\n\n");
+    test_db_add(&db, "tool", "1.0-1", "%DEPENDS%\nsh>=5\n\n");
+    // Two specs with one provider make one edge, reporting the unmet one
+    test_db_add(&db, "newer", "1.0-1", "%DEPENDS%\nsh\nbash>=6\n\n");
+    test_db_add(&db, "foo-impl", "2.1-1", "%PROVIDES%\nfoo=2.1\n\n");
+    test_db_add(&db, "bash", "5.2.026-1", "%PROVIDES%\nsh\n\n");
+    test_db_add(&db, "bar", "2.0-1", "");
+    test_db_add(&db, "rival", "1.0-1", "%CONFLICTS%\nbash\n\n");
+    // Provides and conflicts with what it provides, as many packages do
+    test_db_add(&db, "self", "1.0-1", "%PROVIDES%\nselfish\n\n%CONFLICTS%\nselfish\n\n");
+
+    DepGraph *graph = dep_graph_build(db.local_dir);
+    g_assert_nonnull(graph);
+    int app = dep_graph_lookup(graph, "app");
+    int tool = dep_graph_lookup(graph, "tool");
+    int newer = dep_graph_lookup(graph, "newer");
+    g_assert_cmpint(app, >=, 0);
+    g_assert_cmpint(tool, >=, 0);
+    g_assert_cmpint(newer, >=, 0);
+
+    // Through a versioned provision, and an unversioned one for an
+    // unversioned dependency
+    assert_resolves(graph, app, "foo>=2", "foo-impl", DEP_EDGE_SATISFIED);
+    assert_resolves(graph, app, "sh", "bash", DEP_EDGE_SATISFIED);
+
+    // Installed, but too old
+    assert_resolves(graph, app, "bar>=3", "bar", DEP_EDGE_VERSION_MISMATCH);
+    // An unversioned provision never satisfies a versioned dependency
+    assert_resolves(graph, tool, "sh>=5", "bash", DEP_EDGE_VERSION_MISMATCH);
+
+    // Nothing provides it: a placeholder node without a package
+    DepEdgeStatus status;
+    int missing = resolved_node(graph, app, "missing-lib", &status);
+    g_assert_cmpint(status, ==, DEP_EDGE_MISSING);
+    g_assert_cmpstr(dep_graph_name(graph, missing), ==, "missing-lib");
+    g_assert_null(dep_graph_package(graph, missing));
+
+    int count;
+    dep_graph_depends(graph, newer, &count);
+    g_assert_cmpint(count, ==, 1);
+    assert_resolves(graph, newer, "bash>=6", "bash", DEP_EDGE_VERSION_MISMATCH);
+
+    // Each dependent once
+    const int *required_by = dep_graph_required_by(graph, dep_graph_lookup(graph, "bash"), &count);
+    g_assert_cmpint(count, ==, 3);
+    int seen = 0;
+    for (int i = 0; i < count; i++) {
+        if (required_by[i] == app) seen |= 1;
+        if (required_by[i] == tool) seen |= 2;
+        if (required_by[i] == newer) seen |= 4;
+    }
+    g_assert_cmpint(seen, ==, 7);
+
+    const int *conflicts = dep_graph_conflicts(graph, dep_graph_lookup(graph, "rival"), &count);
+    g_assert_cmpint(count, ==, 1);
+    g_assert_cmpstr(dep_graph_name(graph, conflicts[0]), ==, "bash");
+
+    dep_graph_conflicts(graph, dep_graph_lookup(graph, "self"), &count);
+    g_assert_cmpint(count, ==, 0);
+    dep_graph_conflicts(graph, app, &count);
+    g_assert_cmpint(count, ==, 0);
+
+    dep_graph_unref(graph);
+    test_db_free(&db);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/vercmp/libalpm_order", test_vercmp);
+    g_test_add_func("/dep_graph/resolution", test_resolution);
+    return g_test_run();
+}